@@ -6,6 +6,8 @@
 
 // Windows header files
 #include <cstdio>
+#include <cwctype>
+#include <intrin.h>
 #include <windows.h>
 #include <tlhelp32.h>
 #include <atlstr.h>
@@ -14,8 +16,16 @@
 #include <ole2.h>
 
 // Generic C++ stuff
-#include <filesystem>
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 // for subclassing
@@ -30,9 +40,6 @@
 #include <dwmapi.h>
 #pragma comment(lib, "dwmapi.lib")
 
-// inipp from https://github.com/mcmtroffaes/inipp
-#include "inipp.h"
-
 // window messages related to menu bar drawing
 enum
 {
@@ -111,6 +118,96 @@ typedef struct tagUAHMEASUREMENUITEM
     UAHMENUITEM umi;
 } UAHMEASUREMENUITEM;
 
+// code paths creating GDI objects and DCs, for the watchdog's accounting
+enum class GdiPath {
+    ThemeObjects,   // brushes and pens of the theme snapshots
+    DpiResources,   // per-DPI fonts and theme data
+    MenuBarSurface,
+    ButtonCache,
+    WindowDC,       // non-client painting
+};
+constexpr int GDI_PATH_COUNT = (int)GdiPath::WindowDC + 1;
+
+// the process's GDI and USER object counts, sampled every few seconds from
+// the subclass proc; see SampleGuiResources
+typedef struct {
+    std::atomic<LONG> created[GDI_PATH_COUNT];
+    std::atomic<LONG> released[GDI_PATH_COUNT];
+    std::atomic<DWORD> gdiObjects;
+    std::atomic<DWORD> userObjects;
+    std::atomic<DWORD> gdiPeak;
+    std::atomic<DWORD> userPeak;
+    std::atomic<DWORD> samples;
+    std::atomic<DWORD> degradations;
+    std::atomic<bool> degraded;     // a budget was crossed, render without caches or owner-draw
+    std::atomic<ULONGLONG> nextSample; // the UI thread that moves it takes the sample
+} gui_watchdog;
+
+static gui_watchdog g_watchdog = {};
+
+void CountGdiCreated(GdiPath path, LONG count = 1) {
+    g_watchdog.created[(int)path].fetch_add(count, std::memory_order_relaxed);
+}
+
+void CountGdiReleased(GdiPath path, LONG count = 1) {
+    g_watchdog.released[(int)path].fetch_add(count, std::memory_order_relaxed);
+}
+
+// GDI objects handed out by a theme, all created by FinishThemeConfig before
+// the theme is published and kept until it is released, so that the paint
+// paths never create or delete any. Published, the maps are never modified
+// again: UI threads share them and readers never take a lock.
+typedef struct {
+    std::unordered_map<COLORREF, HBRUSH> brushes;
+    std::unordered_map<UINT64, HPEN> pens;    // keyed by style, width and color
+
+    // leak accounting
+    LONG live;    // handles currently owned by the cache
+    LONG created; // handles created since the theme was loaded
+    std::atomic<LONG> hits; // requests served without creating a handle
+} gdi_cache;
+
+// window styling rules from the [rules] section: what to do with the windows
+// of a class, per button type (style & BS_TYPEMASK). The built-in classes come
+// first, then those the ini adds; the last row is for every other class.
+constexpr int MAX_RULE_CLASSES = 16;
+constexpr int RULE_CLASS_NAME_LENGTH = 64;
+constexpr int RULE_BUTTON_TYPES = BS_TYPEMASK + 1;
+constexpr int OTHER_RULE_SLOT = MAX_RULE_CLASSES;
+
+enum RuleAction : BYTE {
+    RULE_SUBCLASS  = 0x01, // subclass the window when it is created
+    RULE_DARKMODE  = 0x02, // dark DWM frame, top-level windows only
+    RULE_WSTR      = 0x04, // SetWindowTheme(L"wstr", L"wstr")
+    RULE_OWNERDRAW = 0x08, // turn push buttons without an image into BS_OWNERDRAW
+    RULE_LAZY      = 0x10, // leave the rest of the setup until the window is first shown
+};
+
+typedef struct {
+    int classCount;
+    WCHAR classes[MAX_RULE_CLASSES][RULE_CLASS_NAME_LENGTH];
+    BYTE actions[MAX_RULE_CLASSES + 1][RULE_BUTTON_TYPES];
+} rule_table;
+
+// class atoms seen so far and what we found for their class name, so that
+// GetClassName is called once per atom rather than once per window. One name
+// can have several atoms, e.g. Button registered by both comctl32 versions or
+// classes of other activation contexts, each gets its own entry. Open
+// addressing without removal; once full, new atoms are just looked up by name
+// every time.
+constexpr UINT ATOM_CACHE_SIZE = 512; // power of two
+
+typedef struct {
+    std::atomic<DWORD> entries[ATOM_CACHE_SIZE]; // atom << 16 | (value + 1), 0 for a free entry
+} atom_cache;
+
+// GDI and USER object counts above which rendering falls back to plain fills,
+// from the [watchdog] section; the system refuses more than 10000 of either
+typedef struct {
+    UINT gdi_budget;
+    UINT user_budget;
+} watchdog_cfg;
+
 // theme config struct
 typedef struct {
     COLORREF menubar_textcolor;
@@ -120,492 +217,3780 @@ typedef struct {
     COLORREF menubaritem_bgcolor_hot;
     COLORREF menubaritem_bgcolor_selected;
 
+    // title bar and window border, CLR_INVALID leaves them to the system
+    COLORREF caption_color;
+    COLORREF caption_textcolor;
+    COLORREF border_color;
+
     HBRUSH menubar_bgbrush;
     HBRUSH menubaritem_bgbrush;
     HBRUSH menubaritem_bgbrush_hot;
     HBRUSH menubaritem_bgbrush_selected;
+
+    rule_table rules;
+    watchdog_cfg watchdog;
+
+    // bumped every time a theme is loaded, lets windows tell stale renders apart
+    UINT version;
+
+    mutable gdi_cache gdi;
+    mutable atom_cache ruleSlots;  // row of the rule table per class atom
 } theme_cfg;
 
-// global variables
-static HTHEME g_menuTheme = nullptr;
-HHOOK g_hook = nullptr;
+// color keys of the theme config as they appear in the ini, with the default
+// palette used for any key the ini doesn't set (or when there is no ini)
+typedef struct {
+    std::string_view name;
+    COLORREF theme_cfg::* color;
+    COLORREF defaultColor;
+} theme_key;
+
+static constexpr theme_key g_themeKeys[] = {
+    { "menubar_textcolor",            &theme_cfg::menubar_textcolor,            RGB(200, 200, 200) },
+    { "menubar_textcolor_disabled",   &theme_cfg::menubar_textcolor_disabled,   RGB(160, 160, 160) },
+    { "menubar_bgcolor",              &theme_cfg::menubar_bgcolor,              RGB(48, 48, 48) },
+    { "menubaritem_bgcolor",          &theme_cfg::menubaritem_bgcolor,          RGB(48, 48, 48) },
+    { "menubaritem_bgcolor_hot",      &theme_cfg::menubaritem_bgcolor_hot,      RGB(62, 62, 62) },
+    { "menubaritem_bgcolor_selected", &theme_cfg::menubaritem_bgcolor_selected, RGB(62, 62, 62) },
+    { "caption_color",                &theme_cfg::caption_color,                CLR_INVALID },
+    { "caption_textcolor",            &theme_cfg::caption_textcolor,            CLR_INVALID },
+    { "border_color",                 &theme_cfg::border_color,                 CLR_INVALID },
+};
+constexpr int THEME_KEY_COUNT = ARRAYSIZE(g_themeKeys);
 
-bool IsWndClass(HWND hWnd, const TCHAR* classname) {
-    TCHAR buf[512];
-    GetClassName(hWnd, buf, 512);
-    return _wcsicmp(classname, buf) == 0;
-}
+// parsed theme as stored in the binary cache next to the ini; later startups
+// read this instead of parsing the ini again as long as the ini is unchanged
+typedef struct {
+    DWORD magic;
+    DWORD version;          // THEME_CACHE_VERSION, bump on any layout change
+    DWORD size;             // sizeof(theme_cache)
+    DWORD checksum;         // FNV-1a of everything after this field
+    ULONGLONG sourceSize;   // size and write time of the ini this was parsed from
+    FILETIME sourceWriteTime;
+    COLORREF colors[THEME_KEY_COUNT];
+    rule_table rules;
+    watchdog_cfg watchdog;
+} theme_cache;
+
+constexpr DWORD THEME_CACHE_MAGIC = 0x4D444555; // "UEDM"
+constexpr DWORD THEME_CACHE_VERSION = 5;
+
+static constexpr struct {
+    std::string_view name;
+    UINT watchdog_cfg::* value;
+    UINT defaultValue;
+} g_watchdogKeys[] = {
+    { "gdi_budget",  &watchdog_cfg::gdi_budget,  8000 },
+    { "user_budget", &watchdog_cfg::user_budget, 8000 },
+};
 
-bool IsUnityWndClass(HWND hWnd) {
-    return IsWndClass(hWnd, L"UnityContainerWndClass");
-}
+// button types as written in rules, indexed by style & BS_TYPEMASK
+static constexpr std::string_view g_ruleButtonTypes[RULE_BUTTON_TYPES] = {
+    "pushbutton", "defpushbutton", "checkbox", "autocheckbox", "radiobutton", "3state", "auto3state", "groupbox",
+    "userbutton", "autoradiobutton", "pushbox", "ownerdraw", "splitbutton", "defsplitbutton", "commandlink", "defcommandlink",
+};
 
-void GetAllWindowsByProcessID(DWORD dwProcessID, std::vector<HWND>& vhWnds) {
-    HWND hCurWnd = nullptr;
-    do
-    {
-        hCurWnd = FindWindowEx(nullptr, hCurWnd, nullptr, nullptr);
-        if (hCurWnd != nullptr)
-        {
-            DWORD processID = 0;
-            GetWindowThreadProcessId(hCurWnd, &processID);
-            if (processID == dwProcessID)
-            {
-                vhWnds.push_back(hCurWnd);
-            }
-        }
-    } while (hCurWnd != nullptr);
-}
+static constexpr struct {
+    std::string_view name;
+    BYTE action;
+} g_ruleActionNames[] = {
+    { "none",      0 },
+    { "subclass",  RULE_SUBCLASS },
+    { "darkmode",  RULE_DARKMODE },
+    { "wstr",      RULE_WSTR },
+    { "ownerdraw", RULE_OWNERDRAW },
+    { "lazy",      RULE_LAZY },
+};
 
-const theme_cfg* LoadThemeConfig() {
-    static BOOL config_loaded = FALSE;
-    static theme_cfg _cfg;
+// what the dll does without an ini; rules in the ini are applied on top
+constexpr std::string_view g_defaultRules =
+    "[rules]\n"
+    "UnityContainerWndClass = subclass, darkmode\n"
+    "\"#32770\" = subclass, darkmode\n"
+    "Button = subclass, darkmode, lazy\n"
+    "Button:pushbutton = subclass, darkmode, ownerdraw, lazy\n"
+    "Button:checkbox = subclass, darkmode, wstr, lazy\n"
+    "Button:autocheckbox = subclass, darkmode, wstr, lazy\n"
+    "Button:groupbox = subclass, darkmode, wstr, lazy\n"
+    "Button:autoradiobutton = subclass, darkmode, wstr, lazy\n"
+    "tooltips_class32 = subclass, darkmode, wstr, lazy\n"
+    "ComboBox = subclass, darkmode, wstr, lazy\n"
+    "SysListView32 = subclass, darkmode, lazy\n"
+    "SysTreeView32 = subclass, darkmode, lazy\n";
+
+// problems found while parsing the ini, 1-based line and column
+typedef struct {
+    int line;
+    int column;
+    const char* message;
+} theme_parse_error;
 
-    if (config_loaded) return &_cfg;
-    config_loaded = TRUE;
+typedef struct {
+    int errorCount;
+    theme_parse_error errors[8]; // the first few only
+} theme_parse_result;
 
-    HMODULE hm = nullptr;
-    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCTSTR)LoadThemeConfig, &hm);
-    WCHAR path[MAX_PATH];
-    GetModuleFileNameW(hm, path, MAX_PATH);
-    CStringW inifn(path);
-    inifn.Append(L".ini");
+// global variables
+static HMODULE g_module = nullptr; // hooks on other threads have to name the dll
+static std::atomic<bool> g_detaching = false; // unloading or handing off, no new windows are attached
+static std::atomic<bool> g_handedOff = false; // the process-wide dark mode now belongs to the new instance
+static std::atomic<bool> g_attachNew = false; // set once no other instance has the windows, see TakeOverInstance
+
+// how deep the calling thread is in our window procedure and hooks; the dll
+// can't be unloaded from within them
+thread_local int t_callDepth = 0;
+
+struct call_depth {
+    call_depth() { t_callDepth++; }
+    ~call_depth() { t_callDepth--; }
+};
 
-    if (!std::filesystem::exists(inifn.GetString())) {
-        std::ofstream configFile;
-        configFile.open(inifn.GetString());
-        configFile << "menubar_textcolor = 200,200,200" << std::endl;
-        configFile << "menubar_textcolor_disabled = 160,160,160" << std::endl;
-        configFile << "menubar_bgcolor = 48,48,48" << std::endl;
-        configFile << "menubaritem_bgcolor = 48,48,48" << std::endl;
-        configFile << "menubaritem_bgcolor_hot = 62,62,62" << std::endl;
-        configFile << "menubaritem_bgcolor_selected = 62,62,62" << std::endl;
-        configFile.close();
-    }
-
-    inipp::Ini<char> ini;
-    std::ifstream is(inifn.GetString());
-    ini.parse(is);
-    is.close();
-    std::ostringstream oss;
-    ini.generate(oss);
-
-#define _PARSE_COLOR(x) \
-    { \
-        int r, g, b; \
-        char comma; \
-        std::stringstream ss(ini.sections[""][#x]); \
-        ss >> r >> comma >> g >> comma >> b; \
-        _cfg.x = RGB(r, g, b); \
-    }
-
-    _PARSE_COLOR(menubar_textcolor)
-    _PARSE_COLOR(menubar_textcolor_disabled)
-    _PARSE_COLOR(menubar_bgcolor)
-    _PARSE_COLOR(menubaritem_bgcolor)
-    _PARSE_COLOR(menubaritem_bgcolor_hot)
-    _PARSE_COLOR(menubaritem_bgcolor_selected)
-
-    _cfg.menubar_bgbrush = CreateSolidBrush(_cfg.menubar_bgcolor);
-    _cfg.menubaritem_bgbrush = CreateSolidBrush(_cfg.menubaritem_bgcolor);
-    _cfg.menubaritem_bgbrush_hot = CreateSolidBrush(_cfg.menubaritem_bgcolor_hot);
-    _cfg.menubaritem_bgbrush_selected = CreateSolidBrush(_cfg.menubaritem_bgcolor_selected);
-
-    return &_cfg;
-}
+// kind of the windows we theme, decided once when the window is subclassed
+enum class WndKind
+{
+    Other,
+    Unity,      // UnityContainerWndClass
+    Dialog,     // #32770
+    Button,
+    Tooltip,    // tooltips_class32
+    ComboBox,
+    ListView,   // SysListView32
+    TreeView    // SysTreeView32
+};
+constexpr int WND_KIND_COUNT = (int)WndKind::TreeView + 1;
 
-// https://stackoverflow.com/questions/39261826/change-the-color-of-the-title-bar-caption-of-a-win32-application
-// https://gist.github.com/rounk-ctrl/b04e5622e30e0d62956870d5c22b7017
-// https://github.com/microsoft/WindowsAppSDK/issues/41
-// https://gist.github.com/ericoporto/1745f4b912e22f9eabfce2c7166d979b
-void EnableDarkMode(HWND hWnd) {
+// menu bar labels keyed by item position, filled on the first draw of each
+// item and dropped when the menu changes; hits and misses are counted in
+// the stats, see StatCounter
+typedef struct {
+    HMENU hmenu;
+    std::vector<std::pair<bool, std::wstring>> labels; // (cached, text)
+} menu_label_cache;
 
-    // apply dark mode to the window
-    {
-        const BOOL USE_DARK_MODE = true;
+// what a menu bar item currently looks like in the off-screen surface
+typedef struct {
+    RECT rc;        // in surface coordinates
+    UINT itemState; // ODS_* bits that change the look of the item
+    bool rendered;
+} menu_item_visual;
 
-        DwmSetWindowAttribute(hWnd,
-            DWMWA_USE_IMMERSIVE_DARK_MODE,
-            &USE_DARK_MODE,
-            sizeof(USE_DARK_MODE));
-    }
+// off-screen copy of the whole menu bar for one bar size and DPI; items are
+// rendered into it only when their visual state changes and every paint is a blit
+typedef struct {
+    HDC hdc;
+    HBITMAP bitmap;
+    HGDIOBJ oldBitmap;
+    POINT origin;   // bar position in window coordinates
+    SIZE size;
+    UINT dpi;
+    UINT themeVersion;
+    std::vector<menu_item_visual> items;
+} menu_bar_surface;
+
+// non-client geometry of a menu bar window in window coordinates, computed on
+// the first non-client paint and kept until the window is resized, its frame
+// or DPI changes or its menu is updated
+typedef struct {
+    bool valid;
+    bool hasMenuBar;
+    RECT menuBar;       // the bar itself, drawn on WM_UAHDRAWMENU
+    RECT bottomLine;    // line the system draws between the bar and the client area
+    UINT dpi;
+} nc_geometry;
+
+// looks an owner-drawn push button can have, in order of precedence
+enum class ButtonVisual {
+    Normal,
+    Hot,
+    Pressed,
+    Focused,
+    Disabled
+};
+constexpr int BUTTON_VISUAL_COUNT = (int)ButtonVisual::Disabled + 1;
 
-    // apply dark mode to the context menus
-    {
-        using fnSetPreferredAppMode = PreferredAppMode(WINAPI*)(PreferredAppMode appMode);
-        fnSetPreferredAppMode SetPreferredAppMode;
+// owner-drawn push button rendered into an off-screen strip with one cell per
+// visual; a cell is rendered the first time its visual is drawn and blitted
+// after that, until the button size, DPI, text, font or theme changes
+typedef struct {
+    bool textValid;
+    std::wstring text;
+    bool fontValid;
+    HFONT font;         // WM_GETFONT result, owned by the dialog
+    HDC hdc;
+    HBITMAP bitmap;
+    HGDIOBJ oldBitmap;
+    SIZE size;          // of one cell
+    UINT dpi;
+    UINT themeVersion;
+    bool rendered[BUTTON_VISUAL_COUNT];
+    bool hot;           // the mouse is over the button, see OnButtonMouseMove
+} button_cache;
+
+// theme resources that depend on the DPI, built the first time a window at
+// that DPI draws and shared by every window bound to the same DPI
+typedef struct {
+    UINT dpi;           // 0 for an unused set
+    HTHEME menuTheme;   // "Menu" theme data, opened on first use
+    HFONT messageFont;  // for buttons whose dialog did not set a font
+    int borderWidth;    // owner-drawn button border, in pixels, up to MAX_BUTTON_BORDER_WIDTH
+    ULONGLONG lastUse;
+} dpi_resources;
+
+// 1 pixel per 96 DPI; the pens for every width are created with the theme
+constexpr int MAX_BUTTON_BORDER_WIDTH = 5;
+
+// setups rarely span more than a couple of scale factors; when a set for
+// another DPI is needed the least recently used one is rebuilt
+constexpr int MAX_DPI_RESOURCE_SETS = 4;
+
+// windows queued by a re-theme job, see StartRetheme
+typedef struct {
+    HWND hwnd;
+    HWND root;
+} retheme_entry;
+
+typedef struct {
+    std::vector<retheme_entry> queue;
+    size_t next;
+    UINT_PTR timer;
+    LARGE_INTEGER start;
+    ULONG slices;
+    ULONG redraws;
+} retheme_job;
+
+struct wnd_state;
+struct ui_thread;
+
+// handles one message for the windows of one kind
+typedef LRESULT(*msg_handler)(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+// handler per message, indexed by the message id; every message we handle is
+// below WM_USER, anything above is passed on without a lookup
+constexpr UINT DISPATCH_MESSAGE_COUNT = WM_USER;
+typedef std::array<msg_handler, DISPATCH_MESSAGE_COUNT> dispatch_table;
+
+// per-window state, passed to the subclass proc through dwRefData
+typedef struct wnd_state {
+    WndKind kind;
+    BYTE ruleActions;               // RuleAction bits matched when the window was created
+    HWND hwnd;
+    ui_thread* thread;              // the thread owning the window
+    size_t registryIndex;           // position in thread->windows
+    const dispatch_table* dispatch; // handlers of kind, chosen when subclassing
+    bool pending;                   // attached lazily and not shown yet, see CompleteAttach
+    BYTE buttonType;                // style & BS_TYPEMASK at creation, put back on unload
+    UINT colorsVersion;             // theme version of the control colors last set, 0 for none
+    menu_label_cache menuLabels;
+    menu_bar_surface menuBar;
+    nc_geometry ncGeometry;
+    button_cache button;
+    UINT dpi;                   // DPI the window is bound to, 0 until its first draw
+    dpi_resources* resources;   // set for dpi, unless the slot was rebuilt for another DPI
+} wnd_state;
+
+// what we keep per editor UI thread: its hooks, the windows it owns and the
+// resources they are drawn with. A slot is claimed for the thread when it is
+// hooked and freed when it exits. Claiming and freeing slots and the hook
+// handles are guarded by g_uiThreadsLock, threadId is only set once both
+// hooks are in place; the rest only the thread itself ever touches.
+typedef struct ui_thread {
+    std::atomic<DWORD> threadId;    // 0 for a free slot
+    HHOOK cbtHook;
+    HHOOK msgHook;                  // WH_GETMESSAGE, for our tagged WM_NULLs
+    bool initialized;
+    bool cachesReleased;            // render caches dropped while the watchdog is degraded
+    std::vector<wnd_state*> windows;    // every window we subclassed, in no particular order
+    dpi_resources dpiResources[MAX_DPI_RESOURCE_SETS];
+    ULONGLONG dpiResourcesClock;
+    retheme_job retheme;
+} ui_thread;
+
+// the editor has a handful of UI threads at most
+constexpr int MAX_UI_THREADS = 16;
+static ui_thread g_uiThreads[MAX_UI_THREADS];
+static SRWLOCK g_uiThreadsLock = SRWLOCK_INIT;
+thread_local ui_thread* t_uiThread = nullptr;
+
+struct ui_threads_lock {
+    ui_threads_lock() { AcquireSRWLockExclusive(&g_uiThreadsLock); }
+    ~ui_threads_lock() { ReleaseSRWLockExclusive(&g_uiThreadsLock); }
+};
+
+// window classes we theme
+typedef struct {
+    const TCHAR* name;
+    WndKind kind;
+} wnd_class;
+
+static constexpr wnd_class g_wndClasses[] = {
+    { L"UnityContainerWndClass", WndKind::Unity },
+    { L"#32770",                 WndKind::Dialog },
+    { L"Button",                 WndKind::Button },
+    { L"tooltips_class32",       WndKind::Tooltip },
+    { L"ComboBox",               WndKind::ComboBox },
+    { L"SysListView32",          WndKind::ListView },
+    { L"SysTreeView32",          WndKind::TreeView },
+};
 
-        static HMODULE hUxtheme = nullptr;
+// WndKind per class atom
+static atom_cache g_wndKindAtoms;
 
-        if (!hUxtheme) {
-            hUxtheme = LoadLibraryExW(L"uxtheme.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
+bool LookupAtom(const atom_cache& cache, ATOM atom, int& value) {
+    for (UINT i = 0; i < ATOM_CACHE_SIZE; i++) {
+        const DWORD entry = cache.entries[(atom + i) & (ATOM_CACHE_SIZE - 1)].load(std::memory_order_acquire);
+        if (!entry) return false;
+        if ((ATOM)(entry >> 16) == atom) {
+            value = (int)(entry & 0xFFFF) - 1;
+            return true;
         }
+    }
+    return false;
+}
 
-        if (hUxtheme) {
-            // #135 is the ordinal for SetPreferredAppMode private API
-            // which is available in uxtheme.dll since Windows 10 1903+
-            SetPreferredAppMode = (fnSetPreferredAppMode)GetProcAddress(hUxtheme, MAKEINTRESOURCEA(135));
-            SetPreferredAppMode(PreferredAppMode::ForceDark);
-		}
+// several threads may add the same atom at once, they all store the same value
+void InsertAtom(atom_cache& cache, ATOM atom, int value) {
+    const DWORD entry = ((DWORD)atom << 16) | (WORD)(value + 1);
+    for (UINT i = 0; i < ATOM_CACHE_SIZE; i++) {
+        DWORD expected = 0;
+        std::atomic<DWORD>& slot = cache.entries[(atom + i) & (ATOM_CACHE_SIZE - 1)];
+        if (slot.compare_exchange_strong(expected, entry, std::memory_order_release) || (ATOM)(expected >> 16) == atom) return;
     }
 }
 
-LRESULT CALLBACK CallWndSubClassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
+// hWnd's class name without the "<version>!" prefix side-by-side classes of
+// activation contexts carry
+const WCHAR* GetBaseClassName(HWND hWnd, WCHAR (&buf)[256]) {
+    if (!GetClassName(hWnd, buf, ARRAYSIZE(buf))) buf[0] = 0;
+    const WCHAR* bang = wcschr(buf, L'!');
+    return bang ? bang + 1 : buf;
+}
 
-LRESULT CALLBACK CBTProc(int nCode, WPARAM wParam, LPARAM lParam) {
-    switch (nCode) {
-        case HCBT_CREATEWND:
-        {
-            HWND hWnd = (HWND)wParam;
-            if (IsUnityWndClass(hWnd) ||
-                IsWndClass(hWnd, L"#32770") ||
-                IsWndClass(hWnd, L"Button") ||
-                IsWndClass(hWnd, L"tooltips_class32") ||
-                IsWndClass(hWnd, L"ComboBox") ||
-                IsWndClass(hWnd, L"SysListView32") ||
-                IsWndClass(hWnd, L"SysTreeView32")) {
-
-                EnableDarkMode(hWnd);
-                SetWindowSubclass(hWnd, CallWndSubClassProc, 0, 0);
-            }
+WndKind GetWndKind(HWND hWnd) {
+    const ATOM atom = (ATOM)GetClassLongPtr(hWnd, GCW_ATOM);
+    int kind = 0;
+    if (atom && LookupAtom(g_wndKindAtoms, atom, kind)) return (WndKind)kind;
+
+    // first window of this class
+    WCHAR buf[256];
+    const WCHAR* name = GetBaseClassName(hWnd, buf);
+    kind = (int)WndKind::Other;
+    for (const wnd_class& cls : g_wndClasses) {
+        if (_wcsicmp(cls.name, name) == 0) {
+            kind = (int)cls.kind;
             break;
         }
-        case HCBT_DESTROYWND:
-        {
-            HWND hWnd = (HWND)wParam;
-            if (IsUnityWndClass(hWnd) ||
-                IsWndClass(hWnd, L"#32770") ||
-                IsWndClass(hWnd, L"Button") ||
-                IsWndClass(hWnd, L"tooltips_class32") ||
-                IsWndClass(hWnd, L"ComboBox") ||
-                IsWndClass(hWnd, L"SysListView32") ||
-                IsWndClass(hWnd, L"SysTreeView32")) {
-
-                RemoveWindowSubclass(hWnd, CallWndSubClassProc, 0);
-            }
+    }
+    if (atom) InsertAtom(g_wndKindAtoms, atom, kind);
+    return (WndKind)kind;
+}
+
+// row of the rule table for hWnd's class, found the same way as in GetWndKind
+int GetRuleSlot(HWND hWnd, const theme_cfg* cfg) {
+    const ATOM atom = (ATOM)GetClassLongPtr(hWnd, GCW_ATOM);
+    int slot = 0;
+    if (atom && LookupAtom(cfg->ruleSlots, atom, slot)) return slot;
+
+    WCHAR buf[256];
+    const WCHAR* name = GetBaseClassName(hWnd, buf);
+    slot = OTHER_RULE_SLOT;
+    for (int i = 0; i < cfg->rules.classCount; i++) {
+        if (_wcsicmp(cfg->rules.classes[i], name) == 0) {
+            slot = i;
             break;
         }
-        default:
-            break;
     }
-    return 0;
+    if (atom) InsertAtom(cfg->ruleSlots, atom, slot);
+    return slot;
 }
 
-void UAHDrawMenuNCBottomLine(HWND hWnd) {
-    MENUBARINFO mbi = { sizeof(mbi) };
+// RuleAction bits for hWnd, a single table lookup once its class is known
+BYTE GetRuleActions(HWND hWnd, const theme_cfg* cfg) {
+    const DWORD style = (DWORD)GetWindowLongPtr(hWnd, GWL_STYLE);
+    return cfg->rules.actions[GetRuleSlot(hWnd, cfg)][style & BS_TYPEMASK];
+}
 
-    if (!GetMenuBarInfo(hWnd, OBJID_MENU, 0, &mbi))
-    {
-        return;
+// windows owning a menu bar we draw ourselves
+bool HasMenuBar(WndKind kind) {
+    return kind == WndKind::Unity || kind == WndKind::Dialog;
+}
+
+constexpr UINT64 PenKey(int style, int width, COLORREF color) {
+    return ((UINT64)(style & 0xFFFF) << 48) | ((UINT64)(width & 0xFFFF) << 32) | color;
+}
+
+// only while the theme is being built, see FinishThemeConfig
+HBRUSH AddCachedBrush(theme_cfg& cfg, COLORREF color) {
+    gdi_cache& gdi = cfg.gdi;
+    auto it = gdi.brushes.find(color);
+    if (it != gdi.brushes.end()) return it->second;
+
+    HBRUSH brush = CreateSolidBrush(color);
+    if (brush) {
+        gdi.brushes.emplace(color, brush);
+        gdi.live++;
+        gdi.created++;
+        CountGdiCreated(GdiPath::ThemeObjects);
     }
+    return brush;
+}
 
-    RECT rcClient = { 0 };
-    GetClientRect(hWnd, &rcClient);
-    MapWindowPoints(hWnd, nullptr, (POINT*)&rcClient, 2);
+HPEN AddCachedPen(theme_cfg& cfg, int style, int width, COLORREF color) {
+    gdi_cache& gdi = cfg.gdi;
+    const UINT64 key = PenKey(style, width, color);
+    auto it = gdi.pens.find(key);
+    if (it != gdi.pens.end()) return it->second;
+
+    HPEN pen = CreatePen(style, width, color);
+    if (pen) {
+        gdi.pens.emplace(key, pen);
+        gdi.live++;
+        gdi.created++;
+        CountGdiCreated(GdiPath::ThemeObjects);
+    }
+    return pen;
+}
 
-    RECT rcWindow = { 0 };
-    GetWindowRect(hWnd, &rcWindow);
-    OffsetRect(&rcClient, -rcWindow.left, -rcWindow.top);
-    // the rcBar is offset by the window rect
-    RECT rcAnnoyingLine = rcClient;
-    rcAnnoyingLine.bottom = rcAnnoyingLine.top;
-    rcAnnoyingLine.top--;
+// null for an object FinishThemeConfig didn't create; SelectObject then
+// leaves the DC's own in place
+HBRUSH CachedBrush(const theme_cfg* cfg, COLORREF color) {
+    gdi_cache& gdi = cfg->gdi;
+    auto it = gdi.brushes.find(color);
+    if (it == gdi.brushes.end()) return nullptr;
+    gdi.hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
+}
 
-    HDC hdc = GetWindowDC(hWnd);
-    FillRect(hdc, &rcAnnoyingLine, LoadThemeConfig()->menubar_bgbrush);
-    ReleaseDC(hWnd, hdc);
+HPEN CachedPen(const theme_cfg* cfg, int style, int width, COLORREF color) {
+    gdi_cache& gdi = cfg->gdi;
+    auto it = gdi.pens.find(PenKey(style, width, color));
+    if (it == gdi.pens.end()) return nullptr;
+    gdi.hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
 }
 
-// https://stackoverflow.com/questions/16313333/drawing-rounded-and-colored-owner-draw-buttons
-void PaintODTBUTTON(const DRAWITEMSTRUCT& dis) {
-    HWND hwnd = dis.hwndItem;
+void ReleaseGdiCache(gdi_cache& gdi) {
+    for (const auto& [color, brush] : gdi.brushes) {
+        if (DeleteObject(brush)) gdi.live--;
+    }
+    for (const auto& [key, pen] : gdi.pens) {
+        if (DeleteObject(pen)) gdi.live--;
+    }
+    CountGdiReleased(GdiPath::ThemeObjects, (LONG)(gdi.brushes.size() + gdi.pens.size()));
+    gdi.brushes.clear();
+    gdi.pens.clear();
+
+    // anything still live here failed to delete, most likely because it is
+    // still selected into a DC somewhere
+    WCHAR msg[128];
+    swprintf_s(msg, L"UnityEditorDarkMode: gdi cache released, %ld created, %ld hits, %ld leaked\n",
+        gdi.created, gdi.hits.load(), gdi.live);
+    OutputDebugStringW(msg);
+}
 
-    RECT rc;
-    GetClientRect(hwnd, &rc);
+// the current theme is an immutable snapshot swapped in as a whole when the
+// ini changes; readers only ever load the pointer
+static std::atomic<const theme_cfg*> g_theme = nullptr;
+static std::atomic<UINT> g_themeVersion = 0;
 
-    auto hdc = dis.hDC;
-    auto bkcolor = LoadThemeConfig()->menubar_bgcolor;
-    auto brush = CreateSolidBrush(bkcolor);
-    auto pen = CreatePen(PS_SOLID, 1, LoadThemeConfig()->menubar_textcolor);
-    auto oldbrush = SelectObject(hdc, brush);
-    auto oldpen = SelectObject(hdc, pen);
+// number of messages currently being handled with a theme snapshot in hand,
+// a replaced snapshot is only freed once this drops to zero
+static std::atomic<LONG> g_themeReaders = 0;
 
-    SelectObject(hdc, (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0));
-    SetBkColor(hdc, bkcolor);
-    SetTextColor(hdc, LoadThemeConfig()->menubar_textcolor);
+struct theme_reader {
+    theme_reader() { g_themeReaders.fetch_add(1); }
+    ~theme_reader() { g_themeReaders.fetch_sub(1); }
+};
 
-    HBRUSH tmp = CreateSolidBrush(RGB(127, 192, 127));
-    FillRect(hdc, &rc, tmp);
+static HANDLE g_themeWatcherStop = nullptr;
+static HANDLE g_themeWatcher = nullptr;
 
-    Rectangle(hdc, 0, 0, rc.right, rc.bottom);
+CStringW GetThemeConfigPath() {
+    HMODULE hm = nullptr;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCTSTR)GetThemeConfigPath, &hm);
+    WCHAR path[MAX_PATH];
+    GetModuleFileNameW(hm, path, MAX_PATH);
+    CStringW inifn(path);
+    inifn.Append(L".ini");
+    return inifn;
+}
 
-    if (GetFocus() == hwnd)
-    {
-        RECT temp = rc;
-        InflateRect(&temp, -2, -2);
-        DrawFocusRect(hdc, &temp);
+void AddParseError(theme_parse_result& result, int line, int column, const char* message) {
+    if (result.errorCount < (int)ARRAYSIZE(result.errors)) {
+        result.errors[result.errorCount] = { line, column, message };
     }
+    result.errorCount++;
+}
 
-    TCHAR buf[128];
-    GetWindowText(hwnd, buf, 128);
-    DrawText(hdc, buf, -1, &rc, DT_EDITCONTROL | DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+bool IsBlank(char c) {
+    return c == ' ' || c == '\t';
+}
 
-    SelectObject(hdc, oldpen);
-    SelectObject(hdc, oldbrush);
-    DeleteObject(brush);
-    DeleteObject(pen);
+std::string_view TrimBlanks(std::string_view sv) {
+    while (!sv.empty() && IsBlank(sv.front())) sv.remove_prefix(1);
+    while (!sv.empty() && IsBlank(sv.back())) sv.remove_suffix(1);
+    return sv;
 }
 
-LRESULT CALLBACK CallWndSubClassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData) {
-    switch (uMsg) {
-        case WM_CTLCOLORDLG:
-        {
-            return (INT_PTR)LoadThemeConfig()->menubar_bgcolor;
+int FindThemeKey(std::string_view name) {
+    for (int i = 0; i < THEME_KEY_COUNT; i++) {
+        if (g_themeKeys[i].name == name) return i;
+    }
+    return -1;
+}
+
+bool EqualsIgnoreCase(const WCHAR* a, std::string_view b) {
+    for (char c : b) {
+        if (towlower(*a++) != towlower((WCHAR)(BYTE)c)) return false;
+    }
+    return *a == 0;
+}
+
+// finds or adds the row of a class, -1 when the table is full
+int FindRuleClass(rule_table& rules, std::string_view name) {
+    for (int i = 0; i < rules.classCount; i++) {
+        if (EqualsIgnoreCase(rules.classes[i], name)) return i;
+    }
+    if (rules.classCount == MAX_RULE_CLASSES) return -1;
+
+    WCHAR* dst = rules.classes[rules.classCount];
+    for (size_t i = 0; i < name.size(); i++) dst[i] = (WCHAR)(BYTE)name[i];
+    return rules.classCount++;
+}
+
+// parses "class[:buttontype] = action, action..." or the same with the class
+// name in double quotes into rules, replacing the
+// actions of the class (or of one of its button types); on failure returns
+// the error and sets at to where it was found
+const char* ParseRule(std::string_view key, std::string_view value, rule_table& rules, const char*& at) {
+    // names starting with '#' would read as comments, those are written in quotes
+    const size_t colon = key.find(':', key.starts_with('"') ? key.find('"', 1) : 0);
+    std::string_view className = TrimBlanks(key.substr(0, colon));
+    at = key.data();
+    if (className.starts_with('"')) {
+        if (className.size() < 2 || !className.ends_with('"')) return "expected '\"'";
+        className = className.substr(1, className.size() - 2);
+    }
+    if (className.empty()) return "missing class name";
+    if (className.size() >= RULE_CLASS_NAME_LENGTH) return "class name too long";
+    for (char c : className) {
+        if ((BYTE)c >= 0x80) return "class names must be ASCII";
+    }
+
+    int type = -1;
+    if (colon != std::string_view::npos) {
+        const std::string_view typeName = TrimBlanks(key.substr(colon + 1));
+        at = typeName.data();
+        for (int i = 0; i < RULE_BUTTON_TYPES; i++) {
+            if (g_ruleButtonTypes[i] == typeName) type = i;
         }
-        case WM_CTLCOLOREDIT:
-        {
-            HDC hdcStatic = (HDC)wParam;
-            SetTextColor(hdcStatic, LoadThemeConfig()->menubar_textcolor);
-            SetBkColor(hdcStatic, LoadThemeConfig()->menubar_bgcolor);
-            return (INT_PTR)LoadThemeConfig()->menubar_bgbrush;
+        if (type < 0) return "unknown button type";
+    }
+
+    at = value.data();
+    if (value.empty()) return "missing value";
+
+    BYTE actions = 0;
+    for (std::string_view rest = value;;) {
+        const size_t comma = rest.find(',');
+        const std::string_view name = TrimBlanks(rest.substr(0, comma));
+        at = name.data();
+
+        bool known = false;
+        for (const auto& action : g_ruleActionNames) {
+            if (action.name == name) {
+                actions |= action.action;
+                known = true;
+            }
         }
-        case WM_CTLCOLORLISTBOX:
-        {
-            if (IsWndClass(hWnd, L"ComboBox")) {
-                COMBOBOXINFO info;
-                info.cbSize = sizeof(info);
-                SendMessage(hWnd, CB_GETCOMBOBOXINFO, 0, (LPARAM)&info);
-
-                if ((HWND)lParam == info.hwndList)
-                {
-                    HDC dc = (HDC)wParam;
-                    SetBkMode(dc, OPAQUE);
-                    SetTextColor(dc, LoadThemeConfig()->menubar_textcolor);
-                    SetBkColor(dc, LoadThemeConfig()->menubar_bgcolor);
-                    return (LRESULT)LoadThemeConfig()->menubar_bgbrush;
-                }
+        if (!known) return "unknown action";
+
+        if (comma == std::string_view::npos) break;
+        rest.remove_prefix(comma + 1);
+    }
+
+    at = key.data();
+    const int slot = FindRuleClass(rules, className);
+    if (slot < 0) return "too many rule classes";
+
+    if (type < 0) {
+        memset(rules.actions[slot], actions, RULE_BUTTON_TYPES);
+    }
+    else {
+        rules.actions[slot][type] = actions;
+    }
+    return nullptr;
+}
+
+// parses "r,g,b" or "#rrggbb"; on failure returns the error and sets offset
+// to the position in value where it was found
+const char* ParseColor(std::string_view value, COLORREF& color, size_t& offset) {
+    const char* begin = value.data();
+    const char* end = begin + value.size();
+
+    if (value.front() == '#') {
+        unsigned rgb = 0;
+        auto [ptr, ec] = std::from_chars(begin + 1, end, rgb, 16);
+        offset = ptr - begin;
+        if (ec != std::errc() || ptr != end || value.size() != 7) return "expected #rrggbb";
+
+        color = RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+        return nullptr;
+    }
+
+    int rgb[3] = { 0 };
+    const char* p = begin;
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) {
+            while (p < end && IsBlank(*p)) p++;
+            if (p == end || *p != ',') {
+                offset = p - begin;
+                return "expected ','";
             }
-            break;
+            p++;
+            while (p < end && IsBlank(*p)) p++;
         }
-        case WM_CTLCOLORSCROLLBAR:
-        {
-            HDC hdc = reinterpret_cast<HDC>(wParam);
-            SetTextColor(hdc, LoadThemeConfig()->menubar_textcolor);
-            SetBkColor(hdc, LoadThemeConfig()->menubar_bgcolor);
-            return reinterpret_cast<LRESULT>(LoadThemeConfig()->menubar_bgbrush);
+
+        auto [ptr, ec] = std::from_chars(p, end, rgb[i]);
+        if (ec != std::errc()) {
+            offset = p - begin;
+            return "expected a number";
         }
-        case WM_CTLCOLORSTATIC:
-        {
-            HDC hdc = reinterpret_cast<HDC>(wParam);
-            SetTextColor(hdc, LoadThemeConfig()->menubar_textcolor);
-            SetBkColor(hdc, LoadThemeConfig()->menubar_bgcolor);
-            return reinterpret_cast<LRESULT>(LoadThemeConfig()->menubar_bgbrush);
+        if (rgb[i] < 0 || rgb[i] > 255) {
+            offset = p - begin;
+            return "color component out of range 0-255";
         }
-        case WM_DRAWITEM:
-        {
-            const DRAWITEMSTRUCT& dis = *(DRAWITEMSTRUCT*)lParam;
-            if (dis.CtlType == ODT_BUTTON) {
-                if (dis.itemAction) {
-                    PaintODTBUTTON(dis);
-                    if (dis.itemState & ODS_FOCUS) {
-                        DrawFocusRect(dis.hDC, &dis.rcItem);
-                    }
-                }
-                return TRUE;
+        p = ptr;
+    }
+    if (p != end) {
+        offset = p - begin;
+        return "unexpected characters after color";
+    }
+
+    color = RGB(rgb[0], rgb[1], rgb[2]);
+    return nullptr;
+}
+
+// parses "key = value" lines into cfg without allocating; a value is a color
+// or the name of another key. The [rules] section holds window styling rules,
+// see ParseRule, [watchdog] the object budgets and any other section is skipped. Keys that are missing or
+// fail to parse keep whatever cfg held before.
+theme_parse_result ParseThemeConfig(std::string_view text, theme_cfg& cfg) {
+    theme_parse_result result = { 0 };
+
+    // references to other keys are resolved once the whole file has been read
+    struct {
+        int target;
+        int line;
+        int column;
+    } refs[THEME_KEY_COUNT];
+    for (auto& ref : refs) ref.target = -1;
+
+    if (text.starts_with("\xEF\xBB\xBF")) text.remove_prefix(3);
+
+    enum class Section { Global, Rules, Watchdog, Other } section = Section::Global;
+    int line = 0;
+    while (!text.empty()) {
+        line++;
+        const size_t eol = text.find('\n');
+        std::string_view raw = text.substr(0, eol);
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+        if (!raw.empty() && raw.back() == '\r') raw.remove_suffix(1);
+
+        const auto column = [&raw](std::string_view at, size_t offset = 0) {
+            return (int)(at.data() - raw.data() + offset) + 1;
+        };
+
+        const std::string_view content = TrimBlanks(raw);
+        if (content.empty() || content.front() == ';' || content.front() == '#') continue;
+
+        if (content.front() == '[') {
+            if (content.back() != ']') {
+                AddParseError(result, line, column(content, content.size()), "expected ']'");
+                continue;
             }
-            break;
+            const std::string_view name = TrimBlanks(content.substr(1, content.size() - 2));
+            section = name.empty() ? Section::Global :
+                name == "rules" ? Section::Rules :
+                name == "watchdog" ? Section::Watchdog : Section::Other;
+            continue;
         }
-        case WM_ERASEBKGND:
-        {
-            DWORD style = GetWindowLongPtr(hWnd, GWL_STYLE);
-            switch (LOWORD(style)) {
-                case BS_GROUPBOX: // 0x7
-                    break;
-                default:
-                {
-                    RECT rc;
-                    GetClientRect(hWnd, &rc);
-                    FillRect(reinterpret_cast<HDC>(wParam), &rc, LoadThemeConfig()->menubar_bgbrush);
-                    return TRUE;
-                }
-            }
-            break;
+        if (section == Section::Other) continue;
+
+        const size_t eq = content.find('=');
+        if (eq == std::string_view::npos) {
+            AddParseError(result, line, column(content), "expected 'key = value'");
+            continue;
         }
-        case WM_NCACTIVATE:
-        {
-            if (IsUnityWndClass(hWnd) || IsWndClass(hWnd, L"#32770")) {
-                LRESULT lr = DefSubclassProc(hWnd, uMsg, wParam, lParam);
-                UAHDrawMenuNCBottomLine(hWnd);
-                return lr;
+
+        const std::string_view key = TrimBlanks(content.substr(0, eq));
+        const std::string_view value = TrimBlanks(content.substr(eq + 1));
+        if (section == Section::Rules) {
+            const char* at = nullptr;
+            if (const char* message = ParseRule(key, value, cfg.rules, at)) {
+                AddParseError(result, line, column(std::string_view(at, 0)), message);
             }
-            break;
+            continue;
         }
-        case WM_NCCREATE:
-        {
-            EnableDarkMode(hWnd);
-            if (IsWndClass(hWnd, L"tooltips_class32")) {
-                SetWindowTheme(hWnd, L"wstr", L"wstr");
-            }
-            else if (IsWndClass(hWnd, L"ComboBox")) {
-                SetWindowTheme(hWnd, L"wstr", L"wstr");
+        if (section == Section::Watchdog) {
+            const auto it = std::find_if(std::begin(g_watchdogKeys), std::end(g_watchdogKeys),
+                [&key](const auto& k) { return k.name == key; });
+            if (it == std::end(g_watchdogKeys)) {
+                AddParseError(result, line, column(content), "unknown key");
+                continue;
             }
-            else if (IsWndClass(hWnd, L"Button")) {
-                DWORD style = GetWindowLongPtr(hWnd, GWL_STYLE);
-                switch(LOWORD(style)) {
-                    case BS_AUTOCHECKBOX:    // 0x3
-                    case BS_AUTORADIOBUTTON: // 0x9
-                    case BS_CHECKBOX:        // 0x2
-                    case BS_GROUPBOX:        // 0x7
-                        SetWindowTheme(hWnd, L"wstr", L"wstr");
-                        break;
-                    case BS_LEFT: // 0x100
-                    case BS_PUSHBUTTON: // 0x0
-                        style = style | BS_OWNERDRAW;
-                        //style = WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON;
-                        SetWindowLongPtr(hWnd, GWL_STYLE, style);
-                        break;
-                }
+            UINT number = 0;
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+            if (value.empty() || ec != std::errc() || ptr != value.data() + value.size()) {
+                AddParseError(result, line, column(value, ptr - value.data()), "expected a number");
+                continue;
             }
-            break;
+            cfg.watchdog.*it->value = number;
+            continue;
         }
-        case WM_NCPAINT:
-        {
-            if (IsUnityWndClass(hWnd) || IsWndClass(hWnd, L"#32770")) {
-                LRESULT lr = DefSubclassProc(hWnd, uMsg, wParam, lParam);
-                UAHDrawMenuNCBottomLine(hWnd);
-                return lr;
-            }
-            break;
+
+        const int index = FindThemeKey(key);
+        if (index < 0) {
+            AddParseError(result, line, column(content), "unknown key");
+            continue;
         }
-        case WM_PAINT:
-        {
-            if (IsWndClass(hWnd, L"tooltips_class32")) {
-                SendMessage(hWnd, TTM_SETTIPBKCOLOR, LoadThemeConfig()->menubar_bgcolor, 0);
-                SendMessage(hWnd, TTM_SETTIPTEXTCOLOR, LoadThemeConfig()->menubar_textcolor, 0);
-            }
-            else if (IsWndClass(hWnd, L"SysTreeView32")) { // left pane of config dialog
-                TreeView_SetBkColor(hWnd, LoadThemeConfig()->menubar_bgcolor);
-                TreeView_SetTextColor(hWnd, LoadThemeConfig()->menubar_textcolor);
-            }
-            else if (IsWndClass(hWnd, L"SysListView32")) { // left pane of FX dialog
-                ListView_SetBkColor(hWnd, LoadThemeConfig()->menubar_bgcolor);
-                ListView_SetTextBkColor(hWnd, LoadThemeConfig()->menubar_bgcolor);
-                ListView_SetTextColor(hWnd, LoadThemeConfig()->menubar_textcolor);
-            }
-            break;
+        if (value.empty()) {
+            AddParseError(result, line, column(content, eq + 1), "missing value");
+            continue;
         }
-        case WM_STYLECHANGING:
-        case WM_STYLECHANGED:
-        {
-            if (IsUnityWndClass(hWnd)) {
-                // prevent propagation to prevent menu bar from going back to the standard one...?!? FIXME
-                return true;
+
+        if (value.front() == '#' || (value.front() >= '0' && value.front() <= '9')) {
+            COLORREF color = 0;
+            size_t offset = 0;
+            if (const char* message = ParseColor(value, color, offset)) {
+                AddParseError(result, line, column(value, offset), message);
+                continue;
             }
-            break;
+            cfg.*g_themeKeys[index].color = color;
+            refs[index].target = -1;
         }
-        case WM_THEMECHANGED:
-        {
-            if (IsUnityWndClass(hWnd) || IsWndClass(hWnd, L"#32770")) {
-                if (g_menuTheme) {
-                    CloseThemeData(g_menuTheme);
-                    g_menuTheme = nullptr;
-                }
+        else {
+            const int target = FindThemeKey(value);
+            if (target < 0) {
+                AddParseError(result, line, column(value), "unknown color name");
+                continue;
             }
-            break;
+            refs[index] = { target, line, column(value) };
         }
-        // https://stackoverflow.com/questions/77985210/how-to-set-menu-bar-color-in-win32
-        case WM_UAHDRAWMENU:
-        {
-            if (IsUnityWndClass(hWnd) || IsWndClass(hWnd, L"#32770")) {
-                UAHMENU* pUDM = (UAHMENU*)lParam;
-                RECT rc = { 0 };
-                {
-                    MENUBARINFO mbi = { sizeof(mbi) };
-                    GetMenuBarInfo(hWnd, OBJID_MENU, 0, &mbi);
-
-                    RECT rcWindow;
-                    GetWindowRect(hWnd, &rcWindow);
-                    // the rcBar is offset by the window rect
-                    rc = mbi.rcBar;
-                    OffsetRect(&rc, -rcWindow.left, -rcWindow.top);
-                }
-                FillRect(pUDM->hdc, &rc, LoadThemeConfig()->menubar_bgbrush);
-                return true;
-            }
-            break;
+    }
+
+    for (int i = 0; i < THEME_KEY_COUNT; i++) {
+        int target = refs[i].target;
+        for (int hops = 0; target >= 0 && refs[target].target >= 0 && hops < THEME_KEY_COUNT; hops++) {
+            target = refs[target].target;
         }
-        case WM_UAHDRAWMENUITEM:
-        {
-            if (IsUnityWndClass(hWnd) || IsWndClass(hWnd, L"#32770")) {
-                UAHDRAWMENUITEM* pUDMI = (UAHDRAWMENUITEM*)lParam;
-
-                const HBRUSH* pbrBackground = &LoadThemeConfig()->menubaritem_bgbrush;
-                // get the menu item string
-                wchar_t menuString[256] = { 0 };
-                MENUITEMINFO mii = { sizeof(mii), MIIM_STRING };
-                {
-                    mii.dwTypeData = menuString;
-                    mii.cch = (sizeof(menuString) / 2) - 1;
-
-                    GetMenuItemInfo(pUDMI->um.hmenu, pUDMI->umi.iPosition, TRUE, &mii);
-                }
-                // get the item state for drawing
-                DWORD dwFlags = DT_CENTER | DT_SINGLELINE | DT_VCENTER;
-                int iTextStateID = 0;
+        if (target < 0) continue;
 
-                if ((pUDMI->dis.itemState & ODS_INACTIVE) | (pUDMI->dis.itemState & ODS_DEFAULT)) {
-                    // normal display
-                    iTextStateID = MPI_NORMAL;
-                }
-                if (pUDMI->dis.itemState & ODS_HOTLIGHT) {
-                    // hot tracking
-                    iTextStateID = MPI_HOT;
-                    pbrBackground = &LoadThemeConfig()->menubaritem_bgbrush_hot;
-                }
-                if (pUDMI->dis.itemState & ODS_SELECTED) {
-                    // clicked -- MENU_POPUPITEM has no state for this, though MENU_BARITEM does
-                    iTextStateID = MPI_HOT;
-                    pbrBackground = &LoadThemeConfig()->menubaritem_bgbrush_selected;
-                }
-                if ((pUDMI->dis.itemState & ODS_GRAYED) || (pUDMI->dis.itemState & ODS_DISABLED)) {
-                    // disabled / grey text
-                    iTextStateID = MPI_DISABLED;
-                }
-                if (pUDMI->dis.itemState & ODS_NOACCEL) {
-                    dwFlags |= DT_HIDEPREFIX;
-                }
+        if (refs[target].target >= 0) {
+            AddParseError(result, refs[i].line, refs[i].column, "circular color reference");
+            continue;
+        }
+        cfg.*g_themeKeys[i].color = cfg.*g_themeKeys[target].color;
+    }
 
-                if (!g_menuTheme) {
-                    g_menuTheme = OpenThemeData(hWnd, L"Menu");
-                }
+    return result;
+}
 
-                DTTOPTS opts = { sizeof(opts), DTT_TEXTCOLOR, iTextStateID != MPI_DISABLED ? LoadThemeConfig()->menubar_textcolor : LoadThemeConfig()->menubar_textcolor_disabled };
-                FillRect(pUDMI->um.hdc, &pUDMI->dis.rcItem, *pbrBackground);
-                DrawThemeTextEx(g_menuTheme, pUDMI->um.hdc, MENU_BARITEM, MBI_NORMAL, menuString, mii.cch, dwFlags, &pUDMI->dis.rcItem, &opts);
-                return true;
-            }
-            break;
-        }
-        case WM_UAHMEASUREMENUITEM:
-        {
-            if (!IsUnityWndClass(hWnd) && !IsWndClass(hWnd, L"#32770")) {
-
-                //UAHMEASUREMENUITEM* pMmi = (UAHMEASUREMENUITEM*)lParam;
-                // allow the default window procedure to handle the message
-                // since we don't really care about changing the width
-                //*lr = DefWindowProc(hWnd, message, wParam, lParam);
-                LRESULT lr = DefSubclassProc(hWnd, uMsg, wParam, lParam);
-                // but we can modify it here to make it 1/3rd wider for example
-                //pMmi->mis.itemWidth = (pMmi->mis.itemWidth * 4) / 3;
-                return lr;
+// maps the ini read-only and parses it in place
+theme_parse_result ParseThemeConfigFile(const CStringW& inifn, theme_cfg& cfg) {
+    theme_parse_result result = { 0 };
+
+    HANDLE file = CreateFileW(inifn.GetString(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return result;
+
+    // empty files can't be mapped, and there is nothing to parse in them anyway
+    LARGE_INTEGER size = { 0 };
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < (1 << 20)) {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            const char* view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (view) {
+                result = ParseThemeConfig(std::string_view(view, (size_t)size.QuadPart), cfg);
+                UnmapViewOfFile(view);
             }
-            break;
+            CloseHandle(mapping);
         }
+    }
+
+    CloseHandle(file);
+    return result;
+}
+
+void ReportThemeParseErrors(const CStringW& inifn, const theme_parse_result& result) {
+    const int count = std::min(result.errorCount, (int)ARRAYSIZE(result.errors));
+    for (int i = 0; i < count; i++) {
+        const theme_parse_error& error = result.errors[i];
+        WCHAR msg[MAX_PATH + 128];
+        swprintf_s(msg, L"%s(%d,%d): error: %S\n", inifn.GetString(), error.line, error.column, error.message);
+        OutputDebugStringW(msg);
+    }
+    if (result.errorCount > count) {
+        WCHAR msg[MAX_PATH + 64];
+        swprintf_s(msg, L"%s: %d more errors\n", inifn.GetString(), result.errorCount - count);
+        OutputDebugStringW(msg);
+    }
+}
+
+DWORD ThemeCacheChecksum(const theme_cache& cache) {
+    constexpr size_t begin = offsetof(theme_cache, checksum) + sizeof(theme_cache::checksum);
+
+    DWORD hash = 2166136261u;
+    for (size_t i = begin; i < sizeof(cache); i++) {
+        hash = (hash ^ ((const BYTE*)&cache)[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// written by this build of the dll and not damaged since
+bool IsThemeCacheIntact(const theme_cache& cache) {
+    return cache.magic == THEME_CACHE_MAGIC &&
+        cache.version == THEME_CACHE_VERSION &&
+        cache.size == sizeof(theme_cache) &&
+        cache.checksum == ThemeCacheChecksum(cache);
+}
+
+bool IsThemeCacheValid(const theme_cache& cache, const WIN32_FILE_ATTRIBUTE_DATA& source) {
+    const ULONGLONG sourceSize = ((ULONGLONG)source.nFileSizeHigh << 32) | source.nFileSizeLow;
+
+    return IsThemeCacheIntact(cache) &&
+        cache.sourceSize == sourceSize &&
+        CompareFileTime(&cache.sourceWriteTime, &source.ftLastWriteTime) == 0;
+}
+
+theme_cache MakeThemeCache(const theme_cfg& cfg, const WIN32_FILE_ATTRIBUTE_DATA& source) {
+    theme_cache cache = { 0 };
+    cache.magic = THEME_CACHE_MAGIC;
+    cache.version = THEME_CACHE_VERSION;
+    cache.size = sizeof(theme_cache);
+    cache.sourceSize = ((ULONGLONG)source.nFileSizeHigh << 32) | source.nFileSizeLow;
+    cache.sourceWriteTime = source.ftLastWriteTime;
+    for (int i = 0; i < THEME_KEY_COUNT; i++) {
+        cache.colors[i] = cfg.*g_themeKeys[i].color;
+    }
+    memcpy(&cache.rules, &cfg.rules, sizeof(rule_table));
+    cache.watchdog = cfg.watchdog;
+    cache.checksum = ThemeCacheChecksum(cache);
+    return cache;
+}
+
+// the cache is a dot file next to the ini so that Unity doesn't import it
+// when the dll lives in the project's Assets folder
+CStringW GetThemeCachePath(const CStringW& inifn) {
+    std::wstring path = inifn.GetString();
+    const size_t name = path.find_last_of(L'\\') + 1;
+    path.insert(name, L".");
+    path.append(L".cache");
+    return CStringW(path.c_str());
+}
+
+bool ReadThemeCache(const CStringW& cachefn, theme_cache& cache) {
+    HANDLE file = CreateFileW(cachefn.GetString(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    DWORD read = 0;
+    const bool ok = ReadFile(file, &cache, sizeof(cache), &read, nullptr) && read == sizeof(cache);
+    CloseHandle(file);
+    return ok;
+}
+
+// written to a temporary file first so that concurrent editors never see a
+// partially written cache
+void WriteThemeCache(const CStringW& cachefn, const theme_cache& cache) {
+    WCHAR tmpfn[MAX_PATH + 32];
+    swprintf_s(tmpfn, L"%s.%lu.tmp", cachefn.GetString(), GetCurrentProcessId());
+
+    HANDLE file = CreateFileW(tmpfn, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    DWORD written = 0;
+    const bool ok = WriteFile(file, &cache, sizeof(cache), &written, nullptr) && written == sizeof(cache);
+    CloseHandle(file);
+
+    if (!ok || !MoveFileExW(tmpfn, cachefn.GetString(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tmpfn);
+    }
+}
+
+// the parsed theme, shared by the editors of this session that load the same
+// ini: an editor that finds no theme matching the ini there parses it and
+// publishes the result, the others copy the theme out instead of parsing.
+// Any editor may publish, so the theme outlives whichever did it first.
+// Updates are guarded by a seqlock, seq is odd while an editor copies and
+// every update moves it on, which is also how the others notice updates;
+// an editor claims the odd seq with a compare-exchange, so writes from two
+// editors never mix.
+typedef struct {
+    DWORD magic;
+    DWORD version;              // SHARED_THEME_VERSION, also part of the section name
+    DWORD size;                 // sizeof(shared_theme)
+    std::atomic<ULONG> seq;     // 0 until the first publish
+    std::atomic<ULONGLONG> parseDeadline; // GetTickCount64 by which the editor parsing the ini publishes, 0 if none is
+    theme_cache theme;          // validated like the cache file
+} shared_theme;
+
+constexpr DWORD SHARED_THEME_MAGIC = 0x48444555; // "UEDH"
+constexpr DWORD SHARED_THEME_VERSION = 2;
+
+// how long an editor parsing the ini has to publish it before the others
+// stop waiting and parse it themselves, and how often they look for updates
+constexpr DWORD SHARED_THEME_WAIT_MS = 250;
+constexpr DWORD SHARED_THEME_POLL_MS = 1000;
+
+static std::atomic<shared_theme*> g_sharedTheme = nullptr;
+static HANDLE g_sharedThemeMapping = nullptr;
+static std::atomic<ULONG> g_sharedThemeSeq = 0; // seq of the last theme copied out or published
+
+// editors using another copy of the dll (and ini) get a section of their own
+void GetSharedThemeName(const CStringW& inifn, WCHAR (&name)[64]) {
+    DWORD hash = 2166136261u;
+    for (const WCHAR* p = inifn.GetString(); *p; p++) {
+        hash = (hash ^ towlower(*p)) * 16777619u;
+    }
+    swprintf_s(name, L"Local\\UnityEditorDarkMode.Theme.%lu.%08lx", SHARED_THEME_VERSION, hash);
+}
+
+// the first theme build maps the section, the watcher may be building one
+// at the same time
+void OpenSharedTheme(const CStringW& inifn) {
+    if (g_sharedTheme.load(std::memory_order_acquire)) return;
+
+    WCHAR name[64];
+    GetSharedThemeName(inifn, name);
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(shared_theme), name);
+    if (!mapping) return;
+
+    shared_theme* shared = (shared_theme*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(shared_theme));
+    shared_theme* expected = nullptr;
+    if (!shared || !g_sharedTheme.compare_exchange_strong(expected, shared, std::memory_order_acq_rel)) {
+        if (shared) UnmapViewOfFile(shared);
+        CloseHandle(mapping);
+        return;
+    }
+    g_sharedThemeMapping = mapping;
+}
+
+void CloseSharedTheme() {
+    if (shared_theme* shared = g_sharedTheme.exchange(nullptr)) {
+        UnmapViewOfFile(shared);
+    }
+    if (g_sharedThemeMapping) {
+        CloseHandle(g_sharedThemeMapping);
+        g_sharedThemeMapping = nullptr;
+    }
+}
+
+// true when another editor published a theme since we last copied one
+bool SharedThemeChanged() {
+    const shared_theme* shared = g_sharedTheme.load(std::memory_order_acquire);
+    if (!shared) return false;
+    const ULONG seq = shared->seq.load(std::memory_order_acquire);
+    return seq && !(seq & 1) && seq != g_sharedThemeSeq.load();
+}
+
+bool ReadSharedTheme(theme_cache& cache, ULONG& seq) {
+    const shared_theme* shared = g_sharedTheme.load(std::memory_order_acquire);
+    if (!shared) return false;
+
+    for (int attempt = 0; attempt < 64; attempt++) {
+        seq = shared->seq.load(std::memory_order_acquire);
+        if (!seq) return false;
+        if (seq & 1) {
+            YieldProcessor();
+            continue;
+        }
+        const bool valid = shared->magic == SHARED_THEME_MAGIC && shared->version == SHARED_THEME_VERSION &&
+            shared->size == sizeof(shared_theme);
+        memcpy(&cache, (const void*)&shared->theme, sizeof(cache));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared->seq.load(std::memory_order_relaxed) == seq) return valid;
+    }
+    return false;
+}
+
+// claims parsing the ini for us; false while another editor is at it, a
+// claim past its deadline belongs to an editor that is gone or stuck and
+// is taken over
+bool ClaimSharedThemeParse(ULONGLONG& deadline) {
+    shared_theme* shared = g_sharedTheme.load(std::memory_order_acquire);
+    if (!shared) return true;
+
+    const ULONGLONG now = GetTickCount64();
+    ULONGLONG current = shared->parseDeadline.load(std::memory_order_acquire);
+    while (!current || current <= now) {
+        if (shared->parseDeadline.compare_exchange_weak(current, now + SHARED_THEME_WAIT_MS, std::memory_order_acq_rel)) {
+            deadline = now + SHARED_THEME_WAIT_MS;
+            return true;
+        }
+    }
+    deadline = current;
+    return false;
+}
+
+void ReleaseSharedThemeParse(ULONGLONG deadline) {
+    if (shared_theme* shared = g_sharedTheme.load(std::memory_order_acquire)) {
+        shared->parseDeadline.compare_exchange_strong(deadline, 0, std::memory_order_acq_rel);
+    }
+}
+
+// the theme from another editor if it matches the ini. One that is parsing
+// it is given until its deadline to publish; when that passes, or when
+// nobody is parsing, the claim is ours and we parse the ini ourselves.
+bool GetSharedTheme(const WIN32_FILE_ATTRIBUTE_DATA& source, theme_cache& cache, ULONGLONG& claim) {
+    claim = 0;
+    for (;;) {
+        ULONG seq = 0;
+        if (ReadSharedTheme(cache, seq) && IsThemeCacheValid(cache, source)) {
+            g_sharedThemeSeq = seq;
+            return true;
+        }
+        ULONGLONG deadline = 0;
+        if (ClaimSharedThemeParse(deadline)) {
+            claim = deadline;
+            return false;
+        }
+        Sleep(5);
+    }
+}
+
+// publishes cache and gives up our claim; if another editor is publishing
+// at the same moment we leave it to them, should theirs be for an older ini
+// the watcher sees their update and we publish again
+void WriteSharedTheme(const theme_cache& cache, ULONGLONG claim) {
+    shared_theme* shared = g_sharedTheme.load(std::memory_order_acquire);
+    if (!shared) return;
+
+    ULONG seq = shared->seq.load(std::memory_order_acquire);
+    if (!(seq & 1) && shared->seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel)) {
+        std::atomic_thread_fence(std::memory_order_release);
+        shared->magic = SHARED_THEME_MAGIC;
+        shared->version = SHARED_THEME_VERSION;
+        shared->size = sizeof(shared_theme);
+        memcpy(&shared->theme, &cache, sizeof(cache));
+        shared->seq.store(seq + 2, std::memory_order_release);
+        g_sharedThemeSeq = seq + 2;
+    }
+    if (claim) ReleaseSharedThemeParse(claim);
+}
+
+void ApplyThemeCache(theme_cfg& cfg, const theme_cache& cache) {
+    for (int i = 0; i < THEME_KEY_COUNT; i++) {
+        cfg.*g_themeKeys[i].color = cache.colors[i];
+    }
+    memcpy(&cfg.rules, &cache.rules, sizeof(rule_table));
+    cfg.watchdog = cache.watchdog;
+}
+
+// every GDI object the paint paths ask for is created here, so that the
+// snapshot is never modified once it has been published
+void FinishThemeConfig(theme_cfg& cfg) {
+    cfg.menubar_bgbrush = AddCachedBrush(cfg, cfg.menubar_bgcolor);
+    cfg.menubaritem_bgbrush = AddCachedBrush(cfg, cfg.menubaritem_bgcolor);
+    cfg.menubaritem_bgbrush_hot = AddCachedBrush(cfg, cfg.menubaritem_bgcolor_hot);
+    cfg.menubaritem_bgbrush_selected = AddCachedBrush(cfg, cfg.menubaritem_bgcolor_selected);
+    // button borders, see RenderButton
+    for (int width = 1; width <= MAX_BUTTON_BORDER_WIDTH; width++) {
+        AddCachedPen(cfg, PS_SOLID, width, cfg.menubar_textcolor);
+        AddCachedPen(cfg, PS_SOLID, width, cfg.menubar_textcolor_disabled);
+    }
+    cfg.version = ++g_themeVersion;
+}
+
+// the compiled-in palette, budgets and rules the ini is applied on top of
+void SetDefaultThemeConfig(theme_cfg& cfg) {
+    for (const theme_key& key : g_themeKeys) {
+        cfg.*key.color = key.defaultColor;
+    }
+    for (const auto& key : g_watchdogKeys) {
+        cfg.watchdog.*key.value = key.defaultValue;
+    }
+    ParseThemeConfig(g_defaultRules, cfg);
+}
+
+theme_cfg* BuildThemeConfig(const CStringW& inifn) {
+    theme_cfg* cfg = new theme_cfg{};
+    theme_cfg& _cfg = *cfg;
+    SetDefaultThemeConfig(_cfg);
+
+    // without an ini the compiled-in defaults are all there is
+    WIN32_FILE_ATTRIBUTE_DATA source = { 0 };
+    if (GetFileAttributesExW(inifn.GetString(), GetFileExInfoStandard, &source)) {
+        OpenSharedTheme(inifn);
+        const CStringW cachefn = GetThemeCachePath(inifn);
+        theme_cache cache;
+        ULONGLONG claim = 0;
+
+        if (GetSharedTheme(source, cache, claim)) {
+            ApplyThemeCache(_cfg, cache);
+        }
+        else {
+            if (ReadThemeCache(cachefn, cache) && IsThemeCacheValid(cache, source)) {
+                ApplyThemeCache(_cfg, cache);
+            }
+            else {
+                const theme_parse_result result = ParseThemeConfigFile(inifn, _cfg);
+                ReportThemeParseErrors(inifn, result);
+                cache = MakeThemeCache(_cfg, source);
+
+                // keep reporting the errors on every startup until they're fixed
+                if (result.errorCount == 0) {
+                    WriteThemeCache(cachefn, cache);
+                }
+            }
+            WriteSharedTheme(cache, claim);
+        }
+    }
+
+    FinishThemeConfig(_cfg);
+    return cfg;
+}
+
+// the theme handed over by the instance we replace, see TakeOverInstance
+theme_cfg* BuildThemeConfig(const theme_cache& cache) {
+    theme_cfg* cfg = new theme_cfg{};
+    ApplyThemeCache(*cfg, cache);
+    FinishThemeConfig(*cfg);
+    return cfg;
+}
+
+void FreeThemeConfig(const theme_cfg* cfg) {
+    ReleaseGdiCache(cfg->gdi);
+    delete cfg;
+}
+
+const theme_cfg* LoadThemeConfig() {
+    const theme_cfg* cfg = g_theme.load(std::memory_order_acquire);
+    if (cfg) return cfg;
+
+    theme_cfg* loaded = BuildThemeConfig(GetThemeConfigPath());
+    if (!g_theme.compare_exchange_strong(cfg, loaded)) {
+        // somebody else got there first
+        FreeThemeConfig(loaded);
+        return cfg;
+    }
+    return loaded;
+}
+
+// replaced snapshots are kept for THEME_RETIRE_MS: the brushes a WM_CTLCOLOR*
+// handler returns are used by the control after the handler is done, until
+// it paints again with the new theme's, which the retheme asks for right
+// away. Only the theme watcher publishes, so only it touches the list, and
+// unload after the watcher has stopped.
+constexpr ULONGLONG THEME_RETIRE_MS = 5000;
+
+typedef struct {
+    const theme_cfg* cfg;
+    ULONGLONG retired;  // GetTickCount64 when it was replaced
+} retired_theme;
+
+static std::vector<retired_theme> g_retiredThemes;
+
+// frees the snapshots whose grace period is over; a message still being
+// handled with one in hand holds them all back until the next call
+void FreeRetiredThemes() {
+    const ULONGLONG now = GetTickCount64();
+    if (g_retiredThemes.empty() || now - g_retiredThemes.front().retired < THEME_RETIRE_MS) return;
+    if (g_themeReaders.load() != 0) return;
+
+    std::erase_if(g_retiredThemes, [now](const retired_theme& old) {
+        if (now - old.retired < THEME_RETIRE_MS) return false;
+        FreeThemeConfig(old.cfg);
+        return true;
+    });
+}
+
+// how long the watcher may sleep before FreeRetiredThemes has work; never
+// 0, the work may have to wait for a reader
+DWORD RetiredThemesDueIn() {
+    if (g_retiredThemes.empty()) return INFINITE;
+    const ULONGLONG age = GetTickCount64() - g_retiredThemes.front().retired;
+    return age >= THEME_RETIRE_MS ? 1 : (DWORD)(THEME_RETIRE_MS - age);
+}
+
+// swaps in a new snapshot, the old one is retired
+void PublishThemeConfig(const theme_cfg* cfg) {
+    const theme_cfg* old = g_theme.exchange(cfg);
+    if (old) g_retiredThemes.push_back({ old, GetTickCount64() });
+    FreeRetiredThemes();
+}
+
+// how long unloading waits for the messages still being handled with a
+// snapshot in hand; a thread killed inside one never lets go
+constexpr DWORD THEME_READERS_TIMEOUT_MS = 100;
+
+bool WaitForThemeReaders(DWORD timeoutMs) {
+    const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    while (g_themeReaders.load() != 0) {
+        if (GetTickCount64() >= deadline) return false;
+        Sleep(1);
+    }
+    return true;
+}
+
+// drops every snapshot; they are leaked rather than freed under a reader,
+// and at process exit they simply go with the process
+void ReleaseThemeConfig(bool processExit) {
+    const theme_cfg* cfg = g_theme.exchange(nullptr);
+    if (processExit) return;
+
+    if (!WaitForThemeReaders(THEME_READERS_TIMEOUT_MS)) {
+        OutputDebugStringW(L"UnityEditorDarkMode: a theme snapshot is still in use, leaking it\n");
+        g_retiredThemes.clear();
+        return;
+    }
+    for (const retired_theme& old : g_retiredThemes) FreeThemeConfig(old.cfg);
+    g_retiredThemes.clear();
+    if (cfg) FreeThemeConfig(cfg);
+}
+
+// posted to every UI thread as WM_NULL once a new theme has been published
+constexpr WPARAM RETHEME_MESSAGE_TAG = 0x55454452;
+
+// our WM_NULLs carry the module handle, during a hot-swap two copies of the
+// dll hook the same threads and must not act on each other's messages
+BOOL PostThreadTag(DWORD threadId, WPARAM tag) {
+    return PostThreadMessage(threadId, WM_NULL, tag, (LPARAM)g_module);
+}
+
+// threads that may yet become UI threads are looked at this often, see
+// ScanThreadCandidates
+constexpr DWORD UI_THREAD_SCAN_MS = 5000;
+
+void PostRetheme();
+void ScanThreadCandidates();
+
+FILETIME GetLastWriteTime(const CStringW& fn) {
+    WIN32_FILE_ATTRIBUTE_DATA data = { 0 };
+    GetFileAttributesExW(fn.GetString(), GetFileExInfoStandard, &data);
+    return data.ftLastWriteTime;
+}
+
+// reloads the theme whenever the ini next to the dll is written to; holds a
+// reference on the dll for as long as it runs
+DWORD WINAPI ThemeWatcherProc(LPVOID lpParam) {
+    const CStringW inifn = GetThemeConfigPath();
+    std::wstring dir = inifn.GetString();
+    dir.resize(dir.find_last_of(L'\\') + 1);
+
+    HANDLE change = FindFirstChangeNotificationW(dir.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (change != INVALID_HANDLE_VALUE) {
+        FILETIME lastWrite = GetLastWriteTime(inifn);
+        const HANDLE handles[] = { g_themeWatcherStop, change };
+        ULONGLONG nextScan = GetTickCount64() + UI_THREAD_SCAN_MS;
+
+        for (;;) {
+            // editors sharing the theme with us also look out for its updates
+            const DWORD timeout = std::min(g_sharedTheme.load() ? SHARED_THEME_POLL_MS : UI_THREAD_SCAN_MS, RetiredThemesDueIn());
+            const DWORD wait = WaitForMultipleObjects(2, handles, FALSE, timeout);
+            FreeRetiredThemes();
+            const ULONGLONG now = GetTickCount64();
+            if (now >= nextScan) {
+                nextScan = now + UI_THREAD_SCAN_MS;
+                ScanThreadCandidates();
+            }
+
+            if (wait == WAIT_TIMEOUT) {
+                if (!SharedThemeChanged()) continue;
+                lastWrite = GetLastWriteTime(inifn);
+            }
+            else if (wait == WAIT_OBJECT_0 + 1) {
+                // editors tend to save in several steps, let them finish
+                Sleep(100);
+                FindNextChangeNotification(change);
+
+                const FILETIME ft = GetLastWriteTime(inifn);
+                if (CompareFileTime(&ft, &lastWrite) == 0) continue;
+                lastWrite = ft;
+            }
+            else {
+                break;
+            }
+
+            PublishThemeConfig(BuildThemeConfig(inifn));
+            PostRetheme();
+        }
+        FindCloseChangeNotification(change);
+    }
+
+    FreeLibraryAndExitThread((HMODULE)lpParam, 0);
+    return 0;
+}
+
+void StartThemeWatcher() {
+    HMODULE self = nullptr;
+    if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCTSTR)ThemeWatcherProc, &self)) return;
+
+    g_themeWatcherStop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    g_themeWatcher = g_themeWatcherStop ? CreateThread(nullptr, 0, ThemeWatcherProc, self, 0, nullptr) : nullptr;
+    if (!g_themeWatcher) {
+        FreeLibrary(self);
+    }
+}
+
+// how long the watcher gets to let go of the dll, it may be in the middle of
+// parsing the ini or hooking a thread
+constexpr DWORD THEME_WATCHER_STOP_MS = 1000;
+
+// waits for the watcher to let go of the dll, so that it neither publishes
+// a theme nor hooks a thread once we are on our way out; false if it didn't
+// in time, it is then left running as if nothing had been asked of it
+bool StopThemeWatcher() {
+    if (!g_themeWatcher) return true;
+
+    SetEvent(g_themeWatcherStop);
+    if (WaitForSingleObject(g_themeWatcher, THEME_WATCHER_STOP_MS) != WAIT_OBJECT_0) {
+        ResetEvent(g_themeWatcherStop);
+        OutputDebugStringW(L"UnityEditorDarkMode: the theme watcher didn't stop\n");
+        return false;
+    }
+    CloseHandle(g_themeWatcher);
+    g_themeWatcher = nullptr;
+    return true;
+}
+
+using fnSetPreferredAppMode = PreferredAppMode(WINAPI*)(PreferredAppMode appMode);
+using fnFlushMenuThemes = void(WINAPI*)();
+using fnRtlGetVersion = LONG(WINAPI*)(RTL_OSVERSIONINFOW* info);
+using fnOpenThemeDataForDpi = HTHEME(WINAPI*)(HWND hwnd, LPCWSTR pszClassList, UINT dpi);
+
+// what the running OS supports, probed once; the private uxtheme entry
+// points are null and DWM attributes 0 where unavailable
+typedef struct {
+    DWORD build;
+
+    // uxtheme ordinals, process wide
+    fnSetPreferredAppMode SetPreferredAppMode; // #135, Windows 10 1903+
+    fnFlushMenuThemes FlushMenuThemes;         // #136, Windows 10 1903+
+
+    // per-DPI theme data, the system DPI one is used where this is missing;
+    // everything else per-DPI is Windows 10 1607 like GetDpiForWindow
+    fnOpenThemeDataForDpi OpenThemeDataForDpi; // Windows 10 1703+
+
+    // DWM window attributes, per window
+    DWORD darkModeAttribute; // 20 since Windows 10 20H1, 19 on earlier builds
+    bool frameColors;        // DWMWA_CAPTION_COLOR / BORDER_COLOR / TEXT_COLOR, Windows 11
+} os_caps;
+
+os_caps ProbeOsCaps() {
+    os_caps caps = { 0 };
+
+    // GetVersionEx lies to applications without a matching manifest
+    if (HMODULE hNtdll = GetModuleHandleW(L"ntdll.dll")) {
+        auto RtlGetVersion = (fnRtlGetVersion)GetProcAddress(hNtdll, "RtlGetVersion");
+        RTL_OSVERSIONINFOW info = { sizeof(info) };
+        if (RtlGetVersion && RtlGetVersion(&info) == 0) {
+            caps.build = info.dwBuildNumber;
+        }
+    }
+
+    if (caps.build >= 18362) {
+        if (HMODULE hUxtheme = LoadLibraryExW(L"uxtheme.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32)) {
+            caps.SetPreferredAppMode = (fnSetPreferredAppMode)GetProcAddress(hUxtheme, MAKEINTRESOURCEA(135));
+            caps.FlushMenuThemes = (fnFlushMenuThemes)GetProcAddress(hUxtheme, MAKEINTRESOURCEA(136));
+        }
+    }
+    if (HMODULE hUxtheme = GetModuleHandleW(L"uxtheme.dll")) {
+        caps.OpenThemeDataForDpi = (fnOpenThemeDataForDpi)GetProcAddress(hUxtheme, "OpenThemeDataForDpi");
+    }
+
+    if (caps.build >= 18985) {
+        caps.darkModeAttribute = DWMWA_USE_IMMERSIVE_DARK_MODE;
+    }
+    else if (caps.build >= 17763) {
+        caps.darkModeAttribute = DWMWA_USE_IMMERSIVE_DARK_MODE - 1;
+    }
+    caps.frameColors = caps.build >= 22000;
+
+    WCHAR msg[256];
+    swprintf_s(msg, L"UnityEditorDarkMode: build %lu, SetPreferredAppMode %s, FlushMenuThemes %s, dark mode attribute %lu, frame colors %s, per-DPI theme data %s\n",
+        caps.build, caps.SetPreferredAppMode ? L"yes" : L"no", caps.FlushMenuThemes ? L"yes" : L"no",
+        caps.darkModeAttribute, caps.frameColors ? L"yes" : L"no", caps.OpenThemeDataForDpi ? L"yes" : L"no");
+    OutputDebugStringW(msg);
+    return caps;
+}
+
+const os_caps& GetOsCaps() {
+    static const os_caps caps = ProbeOsCaps();
+    return caps;
+}
+
+// apply dark mode to the context menus, this is process wide so it only
+// needs to happen once
+void EnableProcessDarkMode() {
+    const os_caps& caps = GetOsCaps();
+    if (caps.SetPreferredAppMode) {
+        caps.SetPreferredAppMode(PreferredAppMode::ForceDark);
+    }
+    if (caps.FlushMenuThemes) {
+        caps.FlushMenuThemes();
+    }
+}
+
+// undoes EnableProcessDarkMode when the dll goes away
+void DisableProcessDarkMode() {
+    const os_caps& caps = GetOsCaps();
+    if (caps.SetPreferredAppMode) {
+        caps.SetPreferredAppMode(PreferredAppMode::Default);
+    }
+    if (caps.FlushMenuThemes) {
+        caps.FlushMenuThemes();
+    }
+}
+
+// https://stackoverflow.com/questions/39261826/change-the-color-of-the-title-bar-caption-of-a-win32-application
+// https://gist.github.com/rounk-ctrl/b04e5622e30e0d62956870d5c22b7017
+// https://github.com/microsoft/WindowsAppSDK/issues/41
+// https://gist.github.com/ericoporto/1745f4b912e22f9eabfce2c7166d979b
+void EnableDarkMode(HWND hWnd) {
+    // child windows have no frame for DWM to draw
+    if (GetWindowLongPtr(hWnd, GWL_STYLE) & WS_CHILD) return;
+
+    const os_caps& caps = GetOsCaps();
+
+    // apply dark mode to the window
+    if (caps.darkModeAttribute) {
+        const BOOL USE_DARK_MODE = true;
+
+        DwmSetWindowAttribute(hWnd,
+            caps.darkModeAttribute,
+            &USE_DARK_MODE,
+            sizeof(USE_DARK_MODE));
+    }
+
+    // frame colors; those the theme leaves unset go back to the system's,
+    // in case an earlier theme had set them
+    if (caps.frameColors) {
+        theme_reader reader;
+        const theme_cfg* cfg = LoadThemeConfig();
+        const struct {
+            DWORD attribute;
+            COLORREF color;
+        } colors[] = {
+            { DWMWA_CAPTION_COLOR, cfg->caption_color },
+            { DWMWA_TEXT_COLOR, cfg->caption_textcolor },
+            { DWMWA_BORDER_COLOR, cfg->border_color },
+        };
+        for (const auto& c : colors) {
+            const COLORREF color = c.color != CLR_INVALID ? c.color : DWMWA_COLOR_DEFAULT;
+            DwmSetWindowAttribute(hWnd, c.attribute, &color, sizeof(color));
+        }
+    }
+}
+
+// gives the frame its system look back when the dll goes away
+void DisableDarkMode(HWND hWnd) {
+    if (GetWindowLongPtr(hWnd, GWL_STYLE) & WS_CHILD) return;
+
+    const os_caps& caps = GetOsCaps();
+    if (caps.darkModeAttribute) {
+        const BOOL USE_DARK_MODE = false;
+        DwmSetWindowAttribute(hWnd, caps.darkModeAttribute, &USE_DARK_MODE, sizeof(USE_DARK_MODE));
+    }
+    if (caps.frameColors) {
+        const COLORREF color = DWMWA_COLOR_DEFAULT;
+        for (DWORD attribute : { DWMWA_CAPTION_COLOR, DWMWA_TEXT_COLOR, DWMWA_BORDER_COLOR }) {
+            DwmSetWindowAttribute(hWnd, attribute, &color, sizeof(color));
+        }
+    }
+}
+
+// instrumentation of CallWndSubClassProc and CBTProc: per-thread counters and
+// latency histograms in TSC cycles, broken down by window kind and message.
+// Every call is counted, one in STATS_SAMPLE_INTERVAL per thread is timed:
+// two __rdtsc around it, two more around each DefSubclassProc it makes, which
+// alone would cost more than the rest. Calls that aren't timed pay a handful
+// of adds into memory only the calling thread writes to, so that on average
+// a message costs under 100 cycles, counter reads included, which
+// tests/bench_instrumentation.cpp checks.
+//
+// Only the time spent in our own code is counted, time spent in the original
+// window procedure (DefSubclassProc) is taken out.
+
+// messages we keep separate counters for, everything else lands in slot 0
+constexpr UINT g_statMessages[] = {
+    0,
+    WM_PAINT, WM_ERASEBKGND, WM_DRAWITEM, WM_STYLECHANGING, WM_STYLECHANGED,
+    WM_NCCREATE, WM_NCDESTROY, WM_NCPAINT, WM_NCACTIVATE, WM_INITMENU,
+    WM_CTLCOLOREDIT, WM_CTLCOLORLISTBOX, WM_CTLCOLORDLG, WM_CTLCOLORSCROLLBAR, WM_CTLCOLORSTATIC,
+    WM_THEMECHANGED, WM_UAHDRAWMENU, WM_UAHDRAWMENUITEM, WM_UAHINITMENU, WM_UAHMEASUREMENUITEM,
+};
+constexpr int MSG_SLOT_COUNT = ARRAYSIZE(g_statMessages);
+
+constexpr auto g_statMessageSlots = [] {
+    std::array<BYTE, 0x400> slots = {};
+    for (int i = 1; i < MSG_SLOT_COUNT; i++) slots[g_statMessages[i]] = (BYTE)i;
+    return slots;
+}();
+
+// CBTProc codes we count: other, HCBT_CREATEWND, HCBT_DESTROYWND
+constexpr int CBT_SLOT_COUNT = 3;
+
+// bucket i holds calls that took [2^(i+6), 2^(i+7)) cycles, the first and
+// last buckets are open ended
+constexpr int LATENCY_BUCKETS = 16;
+
+typedef struct {
+    ULONGLONG count;    // every call
+    ULONGLONG timed;    // the calls sampled into cycles and histogram
+    ULONGLONG cycles;
+    ULONGLONG histogram[LATENCY_BUCKETS];
+} msg_stats;
+
+// events counted next to the latencies, append only
+enum class StatCounter {
+    ControlColorsApplied,       // windows that got their control colors set
+    ControlColorMessagesSaved,  // color setters not sent because the colors were current
+    NcGeometryHits,             // non-client paints using the cached menu bar geometry
+    NcGeometryMisses,           // non-client paints that had to query it
+    ButtonCacheHits,            // owner-drawn buttons drawn from their cache
+    ButtonRenders,              // owner-drawn button visuals rendered
+    DpiResourceSetsBuilt,       // per-DPI resource sets built, including rebuilds of evicted ones
+    AttachesDeferred,           // windows attached lazily, see RULE_LAZY
+    AttachesAvoided,            // lazily attached windows destroyed without ever being shown
+    MenuLabelHits,              // menu bar items drawn with their cached label
+    MenuLabelMisses,            // menu bar labels read with GetMenuItemInfo
+};
+constexpr int STAT_COUNTER_COUNT = (int)StatCounter::MenuLabelMisses + 1;
+
+typedef struct {
+    DWORD threadId;
+    msg_stats subclass[WND_KIND_COUNT][MSG_SLOT_COUNT];
+    msg_stats cbt[CBT_SLOT_COUNT];
+    ULONGLONG counters[STAT_COUNTER_COUNT];
+} thread_stats;
+
+// snapshot returned by UnityEditorDarkMode_GetStats, summed over all threads;
+// bump STATS_VERSION whenever the layout changes
+typedef struct {
+    DWORD size;     // sizeof(dm_stats), set by the caller
+    DWORD version;
+    DWORD threads;  // threads with a block now, those gone are still in the sums
+    UINT messages[MSG_SLOT_COUNT]; // message of each slot, 0 for "other"
+    msg_stats subclass[WND_KIND_COUNT][MSG_SLOT_COUNT];
+    msg_stats cbt[CBT_SLOT_COUNT];
+    ULONGLONG counters[STAT_COUNTER_COUNT]; // indexed by StatCounter
+} dm_stats;
+
+constexpr DWORD STATS_VERSION = 8;
+
+// a UI thread claims the block of its ui_thread slot the first time it
+// records anything, other threads record nothing; blocks are only ever
+// written by their owner, readers may see slightly stale counts. A thread
+// that gives its slot back adds its counts to g_exitedThreadStats and frees
+// its block, under the lock so that GetStats counts them exactly once.
+static thread_stats g_threadStats[MAX_UI_THREADS];
+static std::atomic<DWORD> g_threadStatsOwners[MAX_UI_THREADS];
+static thread_stats g_exitedThreadStats;
+static SRWLOCK g_threadStatsLock = SRWLOCK_INIT;
+thread_local thread_stats* t_threadStats = nullptr;
+
+// one call in STATS_SAMPLE_INTERVAL is timed, per thread; a power of two
+constexpr DWORD STATS_SAMPLE_INTERVAL = 16;
+thread_local DWORD t_statsCalls = 0;
+
+// timed subclass calls of this thread still running, and the cycles spent in
+// DefSubclassProc meanwhile, see CallDefSubclassProc
+thread_local DWORD t_timedSubclassCalls = 0;
+thread_local ULONGLONG t_defSubclassCycles = 0;
+
+bool SampleCall() {
+    return (++t_statsCalls & (STATS_SAMPLE_INTERVAL - 1)) == 0;
+}
+
+// optional live feed of every timed call for external tools, in a named
+// shared memory section "Local\UnityEditorDarkMode.Stats.<pid>"; enabled by
+// setting the UNITYEDITORDARKMODE_STATS_RING environment variable
+typedef struct {
+    std::atomic<ULONGLONG> seq; // index + 1 once the entry is complete
+    ULONGLONG tsc;
+    ULONGLONG cycles;
+    DWORD threadId;
+    UINT msg;       // message, or CBT code for CBTProc
+    DWORD kind;     // WndKind, or ~0 for CBTProc
+    DWORD reserved;
+} stats_ring_entry;
+
+constexpr DWORD STATS_RING_CAPACITY = 4096; // power of two
+
+typedef struct {
+    DWORD magic;    // "UEDS"
+    DWORD version;
+    DWORD capacity;
+    DWORD entrySize;
+    std::atomic<ULONGLONG> head;
+    stats_ring_entry entries[STATS_RING_CAPACITY];
+} stats_ring;
+
+static std::atomic<stats_ring*> g_statsRing = nullptr;
+static HANDLE g_statsRingMapping = nullptr;
+
+ui_thread* GetUiThread();
+
+// null for threads without a ui_thread slot
+thread_stats* GetThreadStats() {
+    if (t_threadStats) return t_threadStats;
+
+    const ui_thread* thread = GetUiThread();
+    if (!thread) return nullptr;
+
+    const size_t slot = thread - g_uiThreads;
+    const DWORD threadId = GetCurrentThreadId();
+    DWORD owner = 0;
+    if (g_threadStatsOwners[slot].compare_exchange_strong(owner, threadId)) {
+        g_threadStats[slot].threadId = threadId;
+        t_threadStats = &g_threadStats[slot];
+    }
+    return t_threadStats;
+}
+
+void AddMsgStats(msg_stats& sum, const msg_stats& stats) {
+    sum.count += stats.count;
+    sum.timed += stats.timed;
+    sum.cycles += stats.cycles;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) sum.histogram[b] += stats.histogram[b];
+}
+
+void AddThreadStats(thread_stats& sum, const thread_stats& stats) {
+    for (int k = 0; k < WND_KIND_COUNT; k++) {
+        for (int m = 0; m < MSG_SLOT_COUNT; m++) AddMsgStats(sum.subclass[k][m], stats.subclass[k][m]);
+    }
+    for (int c = 0; c < CBT_SLOT_COUNT; c++) AddMsgStats(sum.cbt[c], stats.cbt[c]);
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) sum.counters[c] += stats.counters[c];
+}
+
+void ReleaseThreadStatsBlock(thread_stats& stats) {
+    AcquireSRWLockExclusive(&g_threadStatsLock);
+    AddThreadStats(g_exitedThreadStats, stats);
+    memset(&stats, 0, sizeof(stats));
+    g_threadStatsOwners[&stats - g_threadStats].store(0);
+    ReleaseSRWLockExclusive(&g_threadStatsLock);
+}
+
+// when the thread gives its ui_thread slot back, after anything it may still count
+void ReleaseThreadStats() {
+    thread_stats* stats = t_threadStats;
+    if (!stats) return;
+    t_threadStats = nullptr;
+    ReleaseThreadStatsBlock(*stats);
+}
+
+void CountStat(StatCounter counter, ULONGLONG n = 1) {
+    if (thread_stats* stats = GetThreadStats()) {
+        stats->counters[(int)counter] += n;
+    }
+}
+
+void RecordLatency(msg_stats& stats, ULONGLONG cycles) {
+    const int bucket = std::clamp((int)std::bit_width(cycles) - 7, 0, LATENCY_BUCKETS - 1);
+    stats.timed++;
+    stats.cycles += cycles;
+    stats.histogram[bucket]++;
+}
+
+void RecordToStatsRing(UINT msg, DWORD kind, ULONGLONG start, ULONGLONG cycles) {
+    stats_ring* ring = g_statsRing.load(std::memory_order_acquire);
+    if (!ring) return;
+
+    const ULONGLONG index = ring->head.fetch_add(1, std::memory_order_relaxed);
+    stats_ring_entry& entry = ring->entries[index & (STATS_RING_CAPACITY - 1)];
+    entry.seq.store(0, std::memory_order_relaxed);
+    entry.tsc = start;
+    entry.cycles = cycles;
+    entry.threadId = GetCurrentThreadId();
+    entry.msg = msg;
+    entry.kind = kind;
+    entry.seq.store(index + 1, std::memory_order_release);
+}
+
+// counts one CallWndSubClassProc invocation, and if sampled times it minus
+// the DefSubclassProc calls it made
+struct subclass_timer {
+    WndKind kind;
+    UINT msg;
+    msg_stats* stats = nullptr;
+    bool timed;
+    ULONGLONG start = 0;
+    ULONGLONG defCycles = 0;
+
+    subclass_timer(WndKind kind, UINT msg) : kind(kind), msg(msg), timed(SampleCall()) {
+        if (thread_stats* thread = GetThreadStats()) {
+            const int slot = msg < g_statMessageSlots.size() ? g_statMessageSlots[msg] : 0;
+            stats = &thread->subclass[(int)kind][slot];
+            stats->count++;
+        }
+        if (timed) {
+            t_timedSubclassCalls++;
+            defCycles = t_defSubclassCycles;
+            start = __rdtsc();
+        }
+    }
+    ~subclass_timer() {
+        if (!timed) return;
+        const ULONGLONG cycles = __rdtsc() - start - (t_defSubclassCycles - defCycles);
+        t_timedSubclassCalls--;
+        if (stats) RecordLatency(*stats, cycles);
+        RecordToStatsRing(msg, (DWORD)kind, start, cycles);
+    }
+};
+
+struct cbt_timer {
+    int code;
+    msg_stats* stats = nullptr;
+    bool timed;
+    ULONGLONG start = 0;
+
+    cbt_timer(int code) : code(code), timed(SampleCall()) {
+        if (thread_stats* thread = GetThreadStats()) {
+            stats = &thread->cbt[code == HCBT_CREATEWND ? 1 : code == HCBT_DESTROYWND ? 2 : 0];
+            stats->count++;
+        }
+        if (timed) start = __rdtsc();
+    }
+    ~cbt_timer() {
+        if (!timed) return;
+        const ULONGLONG cycles = __rdtsc() - start;
+        if (stats) RecordLatency(*stats, cycles);
+        RecordToStatsRing(code, ~0u, start, cycles);
+    }
+};
+
+// DefSubclassProc, with the time it takes (nested calls into our subclass
+// proc included) kept out of the numbers of a timed caller
+LRESULT CallDefSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (!t_timedSubclassCalls) return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+
+    const ULONGLONG before = t_defSubclassCycles;
+    const ULONGLONG start = __rdtsc();
+    LRESULT lr = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+    t_defSubclassCycles = before + (__rdtsc() - start);
+    return lr;
+}
+
+void OpenStatsRing() {
+    if (!GetEnvironmentVariableW(L"UNITYEDITORDARKMODE_STATS_RING", nullptr, 0)) return;
+
+    WCHAR name[64];
+    swprintf_s(name, L"Local\\UnityEditorDarkMode.Stats.%lu", GetCurrentProcessId());
+    g_statsRingMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(stats_ring), name);
+    if (!g_statsRingMapping) return;
+
+    stats_ring* ring = (stats_ring*)MapViewOfFile(g_statsRingMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(stats_ring));
+    if (!ring) {
+        CloseHandle(g_statsRingMapping);
+        g_statsRingMapping = nullptr;
+        return;
+    }
+
+    // fresh sections are zero filled
+    ring->magic = 0x53444555; // "UEDS"
+    ring->version = STATS_VERSION;
+    ring->capacity = STATS_RING_CAPACITY;
+    ring->entrySize = sizeof(stats_ring_entry);
+    g_statsRing.store(ring, std::memory_order_release);
+}
+
+void CloseStatsRing() {
+    if (stats_ring* ring = g_statsRing.exchange(nullptr)) {
+        UnmapViewOfFile(ring);
+    }
+    if (g_statsRingMapping) {
+        CloseHandle(g_statsRingMapping);
+        g_statsRingMapping = nullptr;
+    }
+}
+
+extern "C" BOOL WINAPI UnityEditorDarkMode_GetStats(dm_stats* out) {
+    if (!out || out->size != sizeof(dm_stats)) return FALSE;
+
+    memset(out, 0, sizeof(dm_stats));
+    out->size = sizeof(dm_stats);
+    out->version = STATS_VERSION;
+    memcpy(out->messages, g_statMessages, sizeof(g_statMessages));
+
+    const auto add = [out](const thread_stats& stats) {
+        for (int k = 0; k < WND_KIND_COUNT; k++) {
+            for (int m = 0; m < MSG_SLOT_COUNT; m++) AddMsgStats(out->subclass[k][m], stats.subclass[k][m]);
+        }
+        for (int c = 0; c < CBT_SLOT_COUNT; c++) AddMsgStats(out->cbt[c], stats.cbt[c]);
+        for (int c = 0; c < STAT_COUNTER_COUNT; c++) out->counters[c] += stats.counters[c];
+    };
+
+    AcquireSRWLockShared(&g_threadStatsLock);
+    for (int i = 0; i < MAX_UI_THREADS; i++) {
+        if (!g_threadStatsOwners[i].load()) continue;
+        out->threads++;
+        add(g_threadStats[i]);
+    }
+    add(g_exitedThreadStats);
+    ReleaseSRWLockShared(&g_threadStatsLock);
+    return TRUE;
+}
+
+// message trace: when UNITYEDITORDARKMODE_TRACE names a file, every message
+// reaching CallWndSubClassProc is appended to it as a trace_record, so that a
+// session can be replayed offline, see tests/bench_replay.cpp. Records are
+// buffered per thread and written in blocks, at the latest TRACE_FLUSH_MS
+// after the first record of a block; the file is opened for appending, so
+// blocks from different threads never interleave. Buffers are listed in
+// g_traceBuffers, closing the trace writes those of threads that are gone
+// without a THREAD_DETACH, as on process exit.
+typedef struct {
+    DWORD magic;        // "UEDT"
+    DWORD version;
+    DWORD recordSize;   // sizeof(trace_record)
+    DWORD reserved;
+    ULONGLONG startTsc; // __rdtsc and QueryPerformanceCounter taken together,
+    LONGLONG startQpc;  // to convert record timestamps to time
+    LONGLONG qpcFrequency;
+} trace_header;
+
+typedef struct {
+    ULONGLONG tsc;  // __rdtsc on entry
+    DWORD hwnd;     // window handles only use their low 32 bits
+    WORD msg;       // all window messages fit in 16 bits
+    BYTE kind;      // WndKind
+    BYTE buttonType; // style & BS_TYPEMASK of buttons
+    DWORD wParam;   // low 32 bits
+    DWORD detail;   // see TraceDetail
+} trace_record;
+
+constexpr DWORD TRACE_VERSION = 2;
+constexpr UINT TRACE_BUFFER_RECORDS = 4096;
+constexpr ULONGLONG TRACE_FLUSH_MS = 1000;
+
+typedef struct {
+    trace_record records[TRACE_BUFFER_RECORDS];
+    UINT count;
+    ULONGLONG flushBy;  // GetTickCount64 by which the records are written
+} trace_buffer;
+
+static std::atomic<HANDLE> g_traceFile = nullptr;
+static std::atomic<trace_buffer*> g_traceBuffers[MAX_UI_THREADS];
+thread_local trace_buffer* t_traceBuffer = nullptr;
+
+void FlushTraceBuffer(trace_buffer& buffer) {
+    HANDLE file = g_traceFile.load(std::memory_order_acquire);
+    if (file && buffer.count) {
+        DWORD written = 0;
+        WriteFile(file, buffer.records, buffer.count * sizeof(trace_record), &written, nullptr);
+    }
+    buffer.count = 0;
+}
+
+// null when every slot is taken, the thread isn't traced then
+trace_buffer* GetTraceBuffer() {
+    if (t_traceBuffer) return t_traceBuffer;
+
+    trace_buffer* buffer = new trace_buffer;
+    buffer->count = 0;
+    for (auto& slot : g_traceBuffers) {
+        trace_buffer* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, buffer)) {
+            t_traceBuffer = buffer;
+            return buffer;
+        }
+    }
+    delete buffer;
+    return nullptr;
+}
+
+// a buffer taken out of g_traceBuffers is written and freed by whoever took it
+void FreeTraceBuffer(trace_buffer* buffer) {
+    FlushTraceBuffer(*buffer);
+    delete buffer;
+}
+
+void ReleaseTraceBuffer() {
+    trace_buffer* buffer = t_traceBuffer;
+    if (!buffer) return;
+
+    t_traceBuffer = nullptr;
+    for (auto& slot : g_traceBuffers) {
+        trace_buffer* expected = buffer;
+        if (slot.compare_exchange_strong(expected, nullptr)) {
+            FreeTraceBuffer(buffer);
+            break;
+        }
+    }
+}
+
+// what matters of lParam: a value for messages where it is one, what a
+// replay needs of the structure it points to for some others, 0 otherwise;
+// pointers mean nothing outside the process
+DWORD TraceDetail(UINT uMsg, LPARAM lParam) {
+    switch (uMsg) {
+        case WM_DRAWITEM:
+        {
+            const DRAWITEMSTRUCT& dis = *(const DRAWITEMSTRUCT*)lParam;
+            return (dis.CtlType << 24) | ((dis.itemAction & 0xFF) << 16) | (dis.itemState & 0xFFFF);
+        }
+        case WM_UAHDRAWMENUITEM:
+        {
+            const UAHDRAWMENUITEM& udmi = *(const UAHDRAWMENUITEM*)lParam;
+            return (udmi.umi.iPosition << 16) | (udmi.dis.itemState & 0xFFFF);
+        }
+        case WM_WINDOWPOSCHANGING:
+        case WM_WINDOWPOSCHANGED:
+            return ((const WINDOWPOS*)lParam)->flags;
+        case WM_STYLECHANGING:
+        case WM_STYLECHANGED:
+            return ((const STYLESTRUCT*)lParam)->styleNew;
+        case WM_SETTEXT:
+            return lParam ? (DWORD)wcslen((const WCHAR*)lParam) : 0;
+        case WM_MOVE:
+        case WM_SIZE:
+        case WM_ACTIVATE:
+        case WM_SHOWWINDOW:
+        case WM_SETCURSOR:
+        case WM_SETFONT:
+        case WM_NCHITTEST:
+        case WM_NCACTIVATE:
+        case WM_NCMOUSEMOVE:
+        case WM_NCLBUTTONDOWN:
+        case WM_NCLBUTTONUP:
+        case WM_KEYDOWN:
+        case WM_KEYUP:
+        case WM_CHAR:
+        case WM_SYSKEYDOWN:
+        case WM_SYSKEYUP:
+        case WM_COMMAND:
+        case WM_CTLCOLORMSGBOX:
+        case WM_CTLCOLOREDIT:
+        case WM_CTLCOLORLISTBOX:
+        case WM_CTLCOLORBTN:
+        case WM_CTLCOLORDLG:
+        case WM_CTLCOLORSCROLLBAR:
+        case WM_CTLCOLORSTATIC:
+        case WM_MOUSEMOVE:
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+        case WM_LBUTTONDBLCLK:
+        case WM_RBUTTONDOWN:
+        case WM_RBUTTONUP:
+        case WM_MOUSEWHEEL:
+        case WM_MOUSEHOVER:
+            return (DWORD)lParam;
+        default:
+            return 0;
+    }
+}
+
+void TraceMessage(HWND hWnd, const wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (!g_traceFile.load(std::memory_order_relaxed)) return;
+
+    trace_buffer* buffer = GetTraceBuffer();
+    if (!buffer) return;
+
+    const ULONGLONG now = GetTickCount64();
+    if (buffer->count == 0) buffer->flushBy = now + TRACE_FLUSH_MS;
+
+    // counted once complete, a buffer may be written by another thread when
+    // this one is gone
+    buffer->records[buffer->count] = {
+        __rdtsc(), (DWORD)(ULONG_PTR)hWnd, (WORD)uMsg, (BYTE)state->kind,
+        state->kind == WndKind::Button ? state->buttonType : (BYTE)0, (DWORD)wParam, TraceDetail(uMsg, lParam)
+    };
+    buffer->count++;
+    if (buffer->count == TRACE_BUFFER_RECORDS || now >= buffer->flushBy) {
+        FlushTraceBuffer(*buffer);
+    }
+}
+
+void OpenMessageTrace() {
+    WCHAR path[MAX_PATH];
+    const DWORD len = GetEnvironmentVariableW(L"UNITYEDITORDARKMODE_TRACE", path, MAX_PATH);
+    if (!len || len >= MAX_PATH) return;
+
+    HANDLE file = CreateFileW(path, FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    trace_header header = { 0x54444555, TRACE_VERSION, sizeof(trace_record) }; // "UEDT"
+    LARGE_INTEGER qpc, freq;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&qpc);
+    header.startTsc = __rdtsc();
+    header.startQpc = qpc.QuadPart;
+    header.qpcFrequency = freq.QuadPart;
+
+    DWORD written = 0;
+    WriteFile(file, &header, sizeof(header), &written, nullptr);
+    g_traceFile.store(file, std::memory_order_release);
+}
+
+void CloseMessageTrace() {
+    ReleaseTraceBuffer();
+    for (auto& slot : g_traceBuffers) {
+        if (trace_buffer* buffer = slot.exchange(nullptr)) FreeTraceBuffer(buffer);
+    }
+    if (HANDLE file = g_traceFile.exchange(nullptr)) {
+        CloseHandle(file);
+    }
+}
+
+LRESULT CALLBACK CallWndSubClassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
+void ReleaseMenuBarSurface(menu_bar_surface& surface);
+void ReleaseButtonCache(button_cache& cache);
+const dispatch_table* GetDispatchTable(WndKind kind);
+const dispatch_table* GetPendingDispatchTable();
+
+ui_thread* FindUiThread(DWORD threadId) {
+    for (ui_thread& thread : g_uiThreads) {
+        if (thread.threadId.load(std::memory_order_acquire) == threadId) return &thread;
+    }
+    return nullptr;
+}
+
+// the calling thread's slot, null for threads we haven't hooked
+ui_thread* GetUiThread() {
+    if (!t_uiThread) {
+        t_uiThread = FindUiThread(GetCurrentThreadId());
+    }
+    return t_uiThread;
+}
+
+// the new window's state, null if it was attached already or can't be
+wnd_state* AttachWindow(HWND hWnd, WndKind kind, BYTE ruleActions) {
+    ui_thread* thread = GetUiThread();
+    if (!thread) return nullptr;
+
+    DWORD_PTR refData = 0;
+    if (GetWindowSubclass(hWnd, CallWndSubClassProc, 0, &refData)) return nullptr;
+
+    // lazy windows only see the messages that tell us they are about to be
+    // shown until then
+    const bool lazy = ruleActions & RULE_LAZY;
+    const BYTE buttonType = (BYTE)(GetWindowLongPtr(hWnd, GWL_STYLE) & BS_TYPEMASK);
+    wnd_state* state = new wnd_state{ kind, ruleActions, hWnd, thread, thread->windows.size(),
+        lazy ? GetPendingDispatchTable() : GetDispatchTable(kind), lazy, buttonType };
+    if (!SetWindowSubclass(hWnd, CallWndSubClassProc, 0, (DWORD_PTR)state)) {
+        delete state;
+        return nullptr;
+    }
+    thread->windows.push_back(state);
+    if (lazy) CountStat(StatCounter::AttachesDeferred);
+    return state;
+}
+
+void ReleaseWindowState(wnd_state* state) {
+    ReleaseMenuBarSurface(state->menuBar);
+    ReleaseButtonCache(state->button);
+    delete state;
+}
+
+void DetachWindow(HWND hWnd) {
+    DWORD_PTR refData = 0;
+    if (!GetWindowSubclass(hWnd, CallWndSubClassProc, 0, &refData)) return;
+
+    RemoveWindowSubclass(hWnd, CallWndSubClassProc, 0);
+
+    wnd_state* state = (wnd_state*)refData;
+    std::vector<wnd_state*>& windows = state->thread->windows;
+    wnd_state* last = windows.back();
+    windows[state->registryIndex] = last;
+    last->registryIndex = state->registryIndex;
+    windows.pop_back();
+
+    if (state->pending) CountStat(StatCounter::AttachesAvoided);
+    ReleaseWindowState(state);
+}
+
+LRESULT CALLBACK CBTProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    call_depth depth;
+    cbt_timer timer(nCode);
+
+    switch (nCode) {
+        case HCBT_CREATEWND:
+        {
+            HWND hWnd = (HWND)wParam;
+            if (g_detaching || !g_attachNew) break;
+
+            theme_reader reader;
+            const BYTE actions = GetRuleActions(hWnd, LoadThemeConfig());
+            if (actions & RULE_SUBCLASS) {
+                if ((actions & (RULE_DARKMODE | RULE_LAZY)) == RULE_DARKMODE) EnableDarkMode(hWnd);
+                AttachWindow(hWnd, GetWndKind(hWnd), actions);
+            }
+            break;
+        }
+        case HCBT_DESTROYWND:
+        {
+            // the subclass (if any) tells us whether this is one of ours,
+            // no need to look at the class name again
+            DetachWindow((HWND)wParam);
+            break;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
+void ReleaseDpiResources(dpi_resources& set) {
+    if (set.menuTheme) {
+        CloseThemeData(set.menuTheme);
+        CountGdiReleased(GdiPath::DpiResources);
+    }
+    if (set.messageFont) {
+        DeleteObject(set.messageFont);
+        CountGdiReleased(GdiPath::DpiResources);
+    }
+    set = dpi_resources{};
+}
+
+void BuildDpiResources(dpi_resources& set, UINT dpi) {
+    set.dpi = dpi;
+    set.borderWidth = std::clamp(MulDiv(1, dpi, USER_DEFAULT_SCREEN_DPI), 1, MAX_BUTTON_BORDER_WIDTH);
+
+    NONCLIENTMETRICS ncm = { sizeof(ncm) };
+    if (SystemParametersInfoForDpi(SPI_GETNONCLIENTMETRICS, sizeof(ncm), &ncm, 0, dpi)) {
+        set.messageFont = CreateFontIndirect(&ncm.lfMessageFont);
+    }
+    if (set.messageFont) CountGdiCreated(GdiPath::DpiResources);
+    CountStat(StatCounter::DpiResourceSetsBuilt);
+}
+
+// the thread's set for dpi, built on first use
+dpi_resources& GetDpiResources(ui_thread& thread, UINT dpi) {
+    dpi_resources* lru = &thread.dpiResources[0];
+    for (dpi_resources& set : thread.dpiResources) {
+        if (set.dpi == dpi) {
+            set.lastUse = ++thread.dpiResourcesClock;
+            return set;
+        }
+        if (set.lastUse < lru->lastUse) lru = &set;
+    }
+
+    ReleaseDpiResources(*lru);
+    BuildDpiResources(*lru, dpi);
+    lru->lastUse = ++thread.dpiResourcesClock;
+    return *lru;
+}
+
+// binds the window to the set of its DPI, e.g. after it moved to another monitor
+void BindDpiResources(wnd_state* state, UINT dpi) {
+    state->dpi = dpi;
+    state->resources = &GetDpiResources(*state->thread, dpi);
+}
+
+dpi_resources& GetWindowDpiResources(HWND hWnd, wnd_state* state) {
+    if (!state->dpi) {
+        BindDpiResources(state, GetDpiForWindow(hWnd));
+    }
+    else if (state->resources->dpi != state->dpi) {
+        BindDpiResources(state, state->dpi);
+    }
+    else {
+        state->resources->lastUse = ++state->thread->dpiResourcesClock;
+    }
+    return *state->resources;
+}
+
+HTHEME GetMenuTheme(dpi_resources& set, HWND hWnd) {
+    if (!set.menuTheme) {
+        const os_caps& caps = GetOsCaps();
+        set.menuTheme = caps.OpenThemeDataForDpi ? caps.OpenThemeDataForDpi(hWnd, L"Menu", set.dpi) : OpenThemeData(hWnd, L"Menu");
+        if (set.menuTheme) CountGdiCreated(GdiPath::DpiResources);
+    }
+    return set.menuTheme;
+}
+
+// theme data handles are stale after a system theme change, the rest is kept
+void CloseMenuThemes(ui_thread& thread) {
+    for (dpi_resources& set : thread.dpiResources) {
+        if (set.menuTheme) {
+            CloseThemeData(set.menuTheme);
+            CountGdiReleased(GdiPath::DpiResources);
+            set.menuTheme = nullptr;
+        }
+    }
+}
+
+void InvalidateNcGeometry(nc_geometry& geometry) {
+    geometry.valid = false;
+}
+
+const nc_geometry& GetNcGeometry(HWND hWnd, nc_geometry& geometry) {
+    if (geometry.valid) {
+        CountStat(StatCounter::NcGeometryHits);
+        return geometry;
+    }
+    CountStat(StatCounter::NcGeometryMisses);
+
+    geometry = { true };
+    geometry.dpi = GetDpiForWindow(hWnd);
+
+    MENUBARINFO mbi = { sizeof(mbi) };
+    if (!GetMenuBarInfo(hWnd, OBJID_MENU, 0, &mbi))
+    {
+        return geometry;
+    }
+    geometry.hasMenuBar = true;
+
+    RECT rcWindow = { 0 };
+    GetWindowRect(hWnd, &rcWindow);
+    // the rcBar is offset by the window rect
+    geometry.menuBar = mbi.rcBar;
+    OffsetRect(&geometry.menuBar, -rcWindow.left, -rcWindow.top);
+
+    RECT rcClient = { 0 };
+    GetClientRect(hWnd, &rcClient);
+    MapWindowPoints(hWnd, nullptr, (POINT*)&rcClient, 2);
+    OffsetRect(&rcClient, -rcWindow.left, -rcWindow.top);
+
+    geometry.bottomLine = rcClient;
+    geometry.bottomLine.bottom = geometry.bottomLine.top;
+    geometry.bottomLine.top--;
+    return geometry;
+}
+
+void UAHDrawMenuNCBottomLine(HWND hWnd, nc_geometry& geometry) {
+    const nc_geometry& nc = GetNcGeometry(hWnd, geometry);
+    if (!nc.hasMenuBar) return;
+
+    HDC hdc = GetWindowDC(hWnd);
+    if (!hdc) return;
+    CountGdiCreated(GdiPath::WindowDC);
+    FillRect(hdc, &nc.bottomLine, LoadThemeConfig()->menubar_bgbrush);
+    if (ReleaseDC(hWnd, hdc)) CountGdiReleased(GdiPath::WindowDC);
+}
+
+void InvalidateMenuLabels(menu_label_cache& cache) {
+    cache.hmenu = nullptr;
+    cache.labels.clear();
+}
+
+const std::wstring& GetMenuBarLabel(menu_label_cache& cache, HMENU hmenu, int iPosition) {
+    static const std::wstring empty;
+    if (iPosition < 0) return empty;
+
+    if (cache.hmenu != hmenu) {
+        InvalidateMenuLabels(cache);
+        cache.hmenu = hmenu;
+    }
+    if ((size_t)iPosition >= cache.labels.size()) {
+        cache.labels.resize(iPosition + 1);
+    }
+
+    auto& [cached, label] = cache.labels[iPosition];
+    if (cached) {
+        CountStat(StatCounter::MenuLabelHits);
+        return label;
+    }
+    CountStat(StatCounter::MenuLabelMisses);
+
+    wchar_t menuString[256] = { 0 };
+    MENUITEMINFO mii = { sizeof(mii), MIIM_STRING };
+    mii.dwTypeData = menuString;
+    mii.cch = (sizeof(menuString) / 2) - 1;
+
+    if (GetMenuItemInfo(hmenu, iPosition, TRUE, &mii)) {
+        label.assign(menuString, mii.cch);
+    }
+    cached = true;
+    return label;
+}
+
+void ReleaseMenuBarSurface(menu_bar_surface& surface) {
+    if (surface.hdc) {
+        SelectObject(surface.hdc, surface.oldBitmap);
+        DeleteDC(surface.hdc);
+        CountGdiReleased(GdiPath::MenuBarSurface);
+    }
+    if (surface.bitmap) {
+        DeleteObject(surface.bitmap);
+        CountGdiReleased(GdiPath::MenuBarSurface);
+    }
+    surface = menu_bar_surface{};
+}
+
+// forget what the items look like so the next draw of each renders it again;
+// the bar is cleared as well, or items that are gone would stay on it
+void InvalidateMenuBarItems(menu_bar_surface& surface) {
+    surface.items.clear();
+    if (surface.hdc) {
+        RECT rc = { 0, 0, surface.size.cx, surface.size.cy };
+        FillRect(surface.hdc, &rc, LoadThemeConfig()->menubar_bgbrush);
+    }
+}
+
+// decides whether the item has to be rendered into the surface again and
+// records its new look; no GDI involved
+bool UpdateMenuItemVisual(menu_bar_surface& surface, int iPosition, const RECT& rc, UINT itemState) {
+    constexpr UINT visualStates = ODS_HOTLIGHT | ODS_SELECTED | ODS_GRAYED | ODS_DISABLED | ODS_NOACCEL | ODS_INACTIVE | ODS_DEFAULT;
+    itemState &= visualStates;
+
+    if ((size_t)iPosition >= surface.items.size()) {
+        surface.items.resize(iPosition + 1);
+    }
+
+    menu_item_visual& item = surface.items[iPosition];
+    if (item.rendered && item.itemState == itemState && EqualRect(&item.rc, &rc)) {
+        return false;
+    }
+    item = { rc, itemState, true };
+    return true;
+}
+
+// (re)creates the surface when the bar size or DPI changed; returns false
+// if it can't be used, in which case we draw straight to the window
+bool PrepareMenuBarSurface(menu_bar_surface& surface, HDC hdcTarget, const RECT& rcBar, UINT dpi) {
+    const SIZE size = { rcBar.right - rcBar.left, rcBar.bottom - rcBar.top };
+    surface.origin = { rcBar.left, rcBar.top };
+
+    const theme_cfg* cfg = LoadThemeConfig();
+    if (surface.hdc && surface.size.cx == size.cx && surface.size.cy == size.cy && surface.dpi == dpi &&
+        surface.themeVersion == cfg->version) {
+        return true;
+    }
+
+    const POINT origin = surface.origin;
+    ReleaseMenuBarSurface(surface);
+    surface.origin = origin;
+    if (size.cx <= 0 || size.cy <= 0) return false;
+
+    surface.hdc = CreateCompatibleDC(hdcTarget);
+    surface.bitmap = CreateCompatibleBitmap(hdcTarget, size.cx, size.cy);
+    CountGdiCreated(GdiPath::MenuBarSurface, (surface.hdc ? 1 : 0) + (surface.bitmap ? 1 : 0));
+    if (!surface.hdc || !surface.bitmap) {
+        ReleaseMenuBarSurface(surface);
+        return false;
+    }
+    surface.oldBitmap = SelectObject(surface.hdc, surface.bitmap);
+    surface.size = size;
+    surface.dpi = dpi;
+    surface.themeVersion = cfg->version;
+
+    RECT rc = { 0, 0, size.cx, size.cy };
+    FillRect(surface.hdc, &rc, cfg->menubar_bgbrush);
+    return true;
+}
+
+void RenderMenuBarItem(HWND hWnd, dpi_resources& resources, HDC hdc, RECT rc, UINT itemState, const std::wstring& menuString) {
+    const HBRUSH* pbrBackground = &LoadThemeConfig()->menubaritem_bgbrush;
+    // get the item state for drawing
+    DWORD dwFlags = DT_CENTER | DT_SINGLELINE | DT_VCENTER;
+    int iTextStateID = 0;
+
+    if ((itemState & ODS_INACTIVE) | (itemState & ODS_DEFAULT)) {
+        // normal display
+        iTextStateID = MPI_NORMAL;
+    }
+    if (itemState & ODS_HOTLIGHT) {
+        // hot tracking
+        iTextStateID = MPI_HOT;
+        pbrBackground = &LoadThemeConfig()->menubaritem_bgbrush_hot;
+    }
+    if (itemState & ODS_SELECTED) {
+        // clicked -- MENU_POPUPITEM has no state for this, though MENU_BARITEM does
+        iTextStateID = MPI_HOT;
+        pbrBackground = &LoadThemeConfig()->menubaritem_bgbrush_selected;
+    }
+    if ((itemState & ODS_GRAYED) || (itemState & ODS_DISABLED)) {
+        // disabled / grey text
+        iTextStateID = MPI_DISABLED;
+    }
+    if (itemState & ODS_NOACCEL) {
+        dwFlags |= DT_HIDEPREFIX;
+    }
+
+
+    DTTOPTS opts = { sizeof(opts), DTT_TEXTCOLOR, iTextStateID != MPI_DISABLED ? LoadThemeConfig()->menubar_textcolor : LoadThemeConfig()->menubar_textcolor_disabled };
+    FillRect(hdc, &rc, *pbrBackground);
+    DrawThemeTextEx(GetMenuTheme(resources, hWnd), hdc, MENU_BARITEM, MBI_NORMAL, menuString.c_str(), (int)menuString.size(), dwFlags, &rc, &opts);
+}
+
+void DrawMenuBarItem(HWND hWnd, wnd_state* state, const UAHDRAWMENUITEM& udmi) {
+    const std::wstring& menuString = GetMenuBarLabel(state->menuLabels, udmi.um.hmenu, udmi.umi.iPosition);
+    dpi_resources& resources = GetWindowDpiResources(hWnd, state);
+    menu_bar_surface& surface = state->menuBar;
+
+    const RECT& rcItem = udmi.dis.rcItem;
+    RECT rc = rcItem;
+    OffsetRect(&rc, -surface.origin.x, -surface.origin.y);
+
+    if (!surface.hdc || udmi.umi.iPosition < 0 ||
+        rc.left < 0 || rc.top < 0 || rc.right > surface.size.cx || rc.bottom > surface.size.cy) {
+        RenderMenuBarItem(hWnd, resources, udmi.um.hdc, rcItem, udmi.dis.itemState, menuString);
+        return;
+    }
+
+    if (UpdateMenuItemVisual(surface, udmi.umi.iPosition, rc, udmi.dis.itemState)) {
+        RenderMenuBarItem(hWnd, resources, surface.hdc, rc, udmi.dis.itemState, menuString);
+    }
+    BitBlt(udmi.um.hdc, rcItem.left, rcItem.top, rc.right - rc.left, rc.bottom - rc.top, surface.hdc, rc.left, rc.top, SRCCOPY);
+}
+
+void ReleaseButtonCache(button_cache& cache) {
+    if (cache.hdc) {
+        SelectObject(cache.hdc, cache.oldBitmap);
+        DeleteDC(cache.hdc);
+        CountGdiReleased(GdiPath::ButtonCache);
+    }
+    if (cache.bitmap) {
+        DeleteObject(cache.bitmap);
+        CountGdiReleased(GdiPath::ButtonCache);
+    }
+    cache.hdc = nullptr;
+    cache.bitmap = nullptr;
+    cache.oldBitmap = nullptr;
+    cache.size = {};
+    std::fill(std::begin(cache.rendered), std::end(cache.rendered), false);
+}
+
+void InvalidateButtonText(button_cache& cache) {
+    cache.textValid = false;
+    std::fill(std::begin(cache.rendered), std::end(cache.rendered), false);
+}
+
+void InvalidateButtonFont(button_cache& cache) {
+    cache.fontValid = false;
+    std::fill(std::begin(cache.rendered), std::end(cache.rendered), false);
+}
+
+ButtonVisual GetButtonVisual(UINT itemState) {
+    if (itemState & (ODS_DISABLED | ODS_GRAYED)) return ButtonVisual::Disabled;
+    if (itemState & ODS_SELECTED) return ButtonVisual::Pressed;
+    if (itemState & ODS_FOCUS) return ButtonVisual::Focused;
+    if (itemState & ODS_HOTLIGHT) return ButtonVisual::Hot;
+    return ButtonVisual::Normal;
+}
+
+// https://stackoverflow.com/questions/16313333/drawing-rounded-and-colored-owner-draw-buttons
+void RenderButton(HDC hdc, const RECT& rc, ButtonVisual visual, const button_cache& cache, const dpi_resources& resources, const theme_cfg* cfg) {
+    auto bkcolor = cfg->menubar_bgcolor;
+    auto brush = cfg->menubar_bgbrush;
+    auto textcolor = cfg->menubar_textcolor;
+    if (visual == ButtonVisual::Hot) {
+        bkcolor = cfg->menubaritem_bgcolor_hot;
+        brush = cfg->menubaritem_bgbrush_hot;
+    }
+    else if (visual == ButtonVisual::Pressed) {
+        bkcolor = cfg->menubaritem_bgcolor_selected;
+        brush = cfg->menubaritem_bgbrush_selected;
+    }
+    else if (visual == ButtonVisual::Disabled) {
+        textcolor = cfg->menubar_textcolor_disabled;
+    }
+    auto pen = CachedPen(cfg, PS_SOLID, resources.borderWidth, textcolor);
+    auto oldbrush = SelectObject(hdc, brush);
+    auto oldpen = SelectObject(hdc, pen);
+    auto oldfont = SelectObject(hdc, cache.font ? cache.font : resources.messageFont);
+
+    SetBkColor(hdc, bkcolor);
+    SetTextColor(hdc, textcolor);
+
+    // fills the whole cell with the background brush and draws the border
+    Rectangle(hdc, rc.left, rc.top, rc.right, rc.bottom);
+
+    if (visual == ButtonVisual::Focused)
+    {
+        RECT temp = rc;
+        InflateRect(&temp, -2, -2);
+        DrawFocusRect(hdc, &temp);
+    }
+
+    RECT rcText = rc;
+    DrawText(hdc, cache.text.c_str(), (int)cache.text.size(), &rcText, DT_EDITCONTROL | DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+
+    SelectObject(hdc, oldfont);
+    SelectObject(hdc, oldpen);
+    SelectObject(hdc, oldbrush);
+}
+
+// (re)creates the strip when the button size, DPI or theme changed; returns
+// false if it can't be used, in which case we draw straight to the button
+bool PrepareButtonCache(button_cache& cache, HDC hdcTarget, SIZE size, UINT dpi, const theme_cfg* cfg) {
+    if (cache.hdc && cache.size.cx == size.cx && cache.size.cy == size.cy && cache.dpi == dpi &&
+        cache.themeVersion == cfg->version) {
+        return true;
+    }
+
+    ReleaseButtonCache(cache);
+    if (size.cx <= 0 || size.cy <= 0) return false;
+
+    cache.hdc = CreateCompatibleDC(hdcTarget);
+    cache.bitmap = CreateCompatibleBitmap(hdcTarget, size.cx * BUTTON_VISUAL_COUNT, size.cy);
+    CountGdiCreated(GdiPath::ButtonCache, (cache.hdc ? 1 : 0) + (cache.bitmap ? 1 : 0));
+    if (!cache.hdc || !cache.bitmap) {
+        ReleaseButtonCache(cache);
+        return false;
+    }
+    cache.oldBitmap = SelectObject(cache.hdc, cache.bitmap);
+    cache.size = size;
+    cache.dpi = dpi;
+    cache.themeVersion = cfg->version;
+    return true;
+}
+
+void PaintODTBUTTON(const DRAWITEMSTRUCT& dis) {
+    HWND hwnd = dis.hwndItem;
+    const RECT& rc = dis.rcItem;
+    auto cfg = LoadThemeConfig();
+
+    // the button's own state, which carries its cache
+    DWORD_PTR refData = 0;
+    wnd_state* state = GetWindowSubclass(hwnd, CallWndSubClassProc, 0, &refData) ? (wnd_state*)refData : nullptr;
+    button_cache local = {};
+    button_cache& cache = state ? state->button : local;
+
+    // owner-drawn buttons are never given ODS_HOTLIGHT, we track it ourselves
+    const ButtonVisual visual = GetButtonVisual(cache.hot ? dis.itemState | ODS_HOTLIGHT : dis.itemState);
+
+    if (!cache.textValid) {
+        TCHAR buf[128];
+        const int length = GetWindowText(hwnd, buf, 128);
+        cache.text.assign(buf, length);
+        cache.textValid = true;
+    }
+    if (!cache.fontValid) {
+        cache.font = (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0);
+        cache.fontValid = true;
+    }
+
+    const dpi_resources& resources = state ? GetWindowDpiResources(hwnd, state) : GetDpiResources(*GetUiThread(), GetDpiForWindow(hwnd));
+    const SIZE size = { rc.right - rc.left, rc.bottom - rc.top };
+    if (!state || g_watchdog.degraded || !PrepareButtonCache(cache, dis.hDC, size, resources.dpi, cfg)) {
+        CountStat(StatCounter::ButtonRenders);
+        RenderButton(dis.hDC, rc, visual, cache, resources, cfg);
+        return;
+    }
+
+    const int cell = (int)visual * size.cx;
+    if (cache.rendered[(int)visual]) {
+        CountStat(StatCounter::ButtonCacheHits);
+    }
+    else {
+        CountStat(StatCounter::ButtonRenders);
+        RenderButton(cache.hdc, { cell, 0, cell + size.cx, size.cy }, visual, cache, resources, cfg);
+        cache.rendered[(int)visual] = true;
+    }
+    BitBlt(dis.hDC, rc.left, rc.top, size.cx, size.cy, cache.hdc, cell, 0, SRCCOPY);
+}
+
+// window theme and owner-draw style changes, normally applied on WM_NCCREATE
+void ApplyWindowStyle(HWND hWnd, BYTE ruleActions) {
+    if (ruleActions & RULE_WSTR) {
+        SetWindowTheme(hWnd, L"wstr", L"wstr");
+    }
+    // buttons created while short on objects keep the system look for good
+    if ((ruleActions & RULE_OWNERDRAW) && !g_watchdog.degraded) {
+        // we only draw text, buttons showing an image keep their look
+        DWORD style = GetWindowLongPtr(hWnd, GWL_STYLE);
+        if (!(style & (BS_BITMAP | BS_ICON))) {
+            style = (style & ~BS_TYPEMASK) | BS_OWNERDRAW;
+            SetWindowLongPtr(hWnd, GWL_STYLE, style);
+        }
+    }
+}
+
+// undoes ApplyWindowStyle when the dll goes away, nobody would draw an
+// owner-drawn button after that
+void RestoreWindowStyle(HWND hWnd, const wnd_state* state) {
+    if ((state->ruleActions & RULE_WSTR) && !state->pending) {
+        SetWindowTheme(hWnd, nullptr, nullptr);
+    }
+    if (state->ruleActions & RULE_OWNERDRAW) {
+        DWORD style = GetWindowLongPtr(hWnd, GWL_STYLE);
+        if ((style & BS_TYPEMASK) == BS_OWNERDRAW) {
+            style = (style & ~BS_TYPEMASK) | state->buttonType;
+            SetWindowLongPtr(hWnd, GWL_STYLE, style);
+            InvalidateRect(hWnd, nullptr, TRUE);
+        }
+    }
+}
+
+LRESULT OnCtlColorDlg(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    return (INT_PTR)LoadThemeConfig()->menubar_bgcolor;
+}
+
+LRESULT OnCtlColor(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    HDC hdc = reinterpret_cast<HDC>(wParam);
+    SetTextColor(hdc, LoadThemeConfig()->menubar_textcolor);
+    SetBkColor(hdc, LoadThemeConfig()->menubar_bgcolor);
+    return reinterpret_cast<LRESULT>(LoadThemeConfig()->menubar_bgbrush);
+}
+
+LRESULT OnComboBoxCtlColorListBox(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    COMBOBOXINFO info;
+    info.cbSize = sizeof(info);
+    SendMessage(hWnd, CB_GETCOMBOBOXINFO, 0, (LPARAM)&info);
+
+    if ((HWND)lParam == info.hwndList)
+    {
+        HDC dc = (HDC)wParam;
+        SetBkMode(dc, OPAQUE);
+        SetTextColor(dc, LoadThemeConfig()->menubar_textcolor);
+        SetBkColor(dc, LoadThemeConfig()->menubar_bgcolor);
+        return (LRESULT)LoadThemeConfig()->menubar_bgbrush;
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnDrawItem(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    const DRAWITEMSTRUCT& dis = *(DRAWITEMSTRUCT*)lParam;
+    if (dis.CtlType == ODT_BUTTON) {
+        if (dis.itemAction) {
+            PaintODTBUTTON(dis);
+            if (dis.itemState & ODS_FOCUS) {
+                DrawFocusRect(dis.hDC, &dis.rcItem);
+            }
+        }
+        return TRUE;
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnButtonSetText(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    InvalidateButtonText(state->button);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnButtonSetFont(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    InvalidateButtonFont(state->button);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+// the first move over an owner-drawn button makes it hot until WM_MOUSELEAVE
+LRESULT OnButtonMouseMove(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (!state->button.hot && (GetWindowLongPtr(hWnd, GWL_STYLE) & BS_TYPEMASK) == BS_OWNERDRAW) {
+        TRACKMOUSEEVENT tme = { sizeof(tme), TME_LEAVE, hWnd, 0 };
+        if (TrackMouseEvent(&tme)) {
+            state->button.hot = true;
+            InvalidateRect(hWnd, nullptr, FALSE);
+        }
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnButtonMouseLeave(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (state->button.hot) {
+        state->button.hot = false;
+        InvalidateRect(hWnd, nullptr, FALSE);
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+// top-level windows get the new DPI, their children have to ask for it
+LRESULT OnDpiChanged(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    BindDpiResources(state, uMsg == WM_DPICHANGED ? LOWORD(wParam) : GetDpiForWindow(hWnd));
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnEraseBkgnd(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    DWORD style = GetWindowLongPtr(hWnd, GWL_STYLE);
+    switch (LOWORD(style)) {
+        case BS_GROUPBOX: // 0x7
+            break;
+        default:
+        {
+            RECT rc;
+            GetClientRect(hWnd, &rc);
+            FillRect(reinterpret_cast<HDC>(wParam), &rc, LoadThemeConfig()->menubar_bgbrush);
+            return TRUE;
+        }
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnNcCreate(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (state->ruleActions & RULE_DARKMODE) EnableDarkMode(hWnd);
+    ApplyWindowStyle(hWnd, state->ruleActions);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnNcDestroy(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    // windows destroyed without going through our CBT hook
+    DetachWindow(hWnd);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+// whether a message to a lazily attached window means it is about to be seen
+bool IsFirstShow(UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    switch (uMsg) {
+        case WM_SHOWWINDOW:
+            return wParam != FALSE;
+        case WM_WINDOWPOSCHANGING:
+            return (((const WINDOWPOS*)lParam)->flags & SWP_SHOWWINDOW) != 0;
+        default:
+            // windows created visible get no WM_SHOWWINDOW, their first paint is it
+            return true;
+    }
+}
+
+// what CBTProc and WM_NCCREATE left out for a lazy window
+void CompleteAttach(HWND hWnd, wnd_state* state) {
+    state->pending = false;
+    state->dispatch = GetDispatchTable(state->kind);
+    if (state->ruleActions & RULE_DARKMODE) EnableDarkMode(hWnd);
+    ApplyWindowStyle(hWnd, state->ruleActions & ~RULE_OWNERDRAW);
+}
+
+LRESULT OnPendingNcCreate(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    // the owner-draw style is a single style write and has to be in place
+    // before the button first measures or draws itself
+    ApplyWindowStyle(hWnd, state->ruleActions & RULE_OWNERDRAW);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnPendingShow(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (!IsFirstShow(uMsg, wParam, lParam)) {
+        return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+    }
+    CompleteAttach(hWnd, state);
+
+    // the message itself already goes to the handlers of the window's kind
+    const msg_handler handler = (*state->dispatch)[uMsg];
+    return handler ? handler(hWnd, state, uMsg, wParam, lParam) : CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+// number of color setters SetControlColors sends for a kind
+constexpr int ControlColorSetters(WndKind kind) {
+    return kind == WndKind::ListView ? 3 : kind == WndKind::Tooltip || kind == WndKind::TreeView ? 2 : 0;
+}
+
+// sets the colors kept by tooltips, tree views and list views
+void SetControlColors(HWND hWnd, WndKind kind, const theme_cfg* cfg) {
+    switch (kind) {
+        case WndKind::Tooltip:
+            SendMessage(hWnd, TTM_SETTIPBKCOLOR, cfg->menubar_bgcolor, 0);
+            SendMessage(hWnd, TTM_SETTIPTEXTCOLOR, cfg->menubar_textcolor, 0);
+            break;
+        case WndKind::TreeView: // left pane of config dialog
+            TreeView_SetBkColor(hWnd, cfg->menubar_bgcolor);
+            TreeView_SetTextColor(hWnd, cfg->menubar_textcolor);
+            break;
+        case WndKind::ListView: // left pane of FX dialog
+            ListView_SetBkColor(hWnd, cfg->menubar_bgcolor);
+            ListView_SetTextBkColor(hWnd, cfg->menubar_bgcolor);
+            ListView_SetTextColor(hWnd, cfg->menubar_textcolor);
+            break;
         default:
             break;
     }
+}
+
+// the setters invalidate the control, so they are only sent on the first paint
+// and again after the theme has changed
+LRESULT OnControlPaint(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    const theme_cfg* cfg = LoadThemeConfig();
+    if (state->colorsVersion != cfg->version) {
+        SetControlColors(hWnd, state->kind, cfg);
+        state->colorsVersion = cfg->version;
+        CountStat(StatCounter::ControlColorsApplied);
+    }
+    else {
+        CountStat(StatCounter::ControlColorMessagesSaved, ControlColorSetters(state->kind));
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnUnityStyleChange(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    // prevent propagation to prevent menu bar from going back to the standard one...?!? FIXME
+    return true;
+}
+
+LRESULT OnMenuBarInitMenu(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    // the application updates its menus right before they are shown
+    InvalidateMenuLabels(state->menuLabels);
+    InvalidateMenuBarItems(state->menuBar);
+    InvalidateNcGeometry(state->ncGeometry);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnMenuBarGeometryChange(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    InvalidateNcGeometry(state->ncGeometry);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnMenuBarDpiChanged(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    BindDpiResources(state, LOWORD(wParam));
+    InvalidateNcGeometry(state->ncGeometry);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnMenuBarWindowPosChanged(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    // moving the window keeps the geometry, which is relative to the window;
+    // SetMenu and DrawMenuBar come through here as frame changes, and
+    // DrawMenuBar is how an application shows a menu it changed in place
+    const WINDOWPOS& pos = *(WINDOWPOS*)lParam;
+    if (pos.flags & SWP_FRAMECHANGED) {
+        InvalidateMenuLabels(state->menuLabels);
+        InvalidateMenuBarItems(state->menuBar);
+    }
+    if (!(pos.flags & SWP_NOSIZE) || (pos.flags & SWP_FRAMECHANGED)) {
+        InvalidateNcGeometry(state->ncGeometry);
+    }
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT OnMenuBarNcPaint(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    LRESULT lr = CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+    UAHDrawMenuNCBottomLine(hWnd, state->ncGeometry);
+    return lr;
+}
+
+LRESULT OnMenuBarThemeChanged(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    CloseMenuThemes(*state->thread);
+    ReleaseMenuBarSurface(state->menuBar);
+    InvalidateNcGeometry(state->ncGeometry);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+// https://stackoverflow.com/questions/77985210/how-to-set-menu-bar-color-in-win32
+LRESULT OnUahDrawMenu(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    UAHMENU* pUDM = (UAHMENU*)lParam;
+    const nc_geometry& nc = GetNcGeometry(hWnd, state->ncGeometry);
+    const RECT& rc = nc.menuBar;
+    if (!g_watchdog.degraded && PrepareMenuBarSurface(state->menuBar, pUDM->hdc, rc, nc.dpi)) {
+        BitBlt(pUDM->hdc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, state->menuBar.hdc, 0, 0, SRCCOPY);
+    }
+    else {
+        FillRect(pUDM->hdc, &rc, LoadThemeConfig()->menubar_bgbrush);
+    }
+    return true;
+}
+
+LRESULT OnUahDrawMenuItem(HWND hWnd, wnd_state* state, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    DrawMenuBarItem(hWnd, state, *(UAHDRAWMENUITEM*)lParam);
+    return true;
+}
+
+typedef struct {
+    UINT msg;
+    msg_handler handler;
+} msg_route;
+
+// handled for every window we subclass
+constexpr msg_route g_commonRoutes[] = {
+    { WM_CTLCOLORDLG, OnCtlColorDlg },
+    { WM_CTLCOLOREDIT, OnCtlColor },
+    { WM_CTLCOLORSCROLLBAR, OnCtlColor },
+    { WM_CTLCOLORSTATIC, OnCtlColor },
+    { WM_DPICHANGED, OnDpiChanged },
+    { WM_DPICHANGED_AFTERPARENT, OnDpiChanged },
+    { WM_DRAWITEM, OnDrawItem },
+    { WM_ERASEBKGND, OnEraseBkgnd },
+    { WM_NCCREATE, OnNcCreate },
+    { WM_NCDESTROY, OnNcDestroy },
+};
+
+// windows owning a menu bar we draw ourselves, see HasMenuBar
+constexpr msg_route g_menuBarRoutes[] = {
+    { WM_DPICHANGED, OnMenuBarDpiChanged },
+    { WM_INITMENU, OnMenuBarInitMenu },
+    { WM_NCACTIVATE, OnMenuBarNcPaint },
+    { WM_NCPAINT, OnMenuBarNcPaint },
+    { WM_SIZE, OnMenuBarGeometryChange },
+    { WM_THEMECHANGED, OnMenuBarThemeChanged },
+    { WM_UAHDRAWMENU, OnUahDrawMenu },
+    { WM_UAHDRAWMENUITEM, OnUahDrawMenuItem },
+    { WM_UAHINITMENU, OnMenuBarInitMenu },
+    { WM_WINDOWPOSCHANGED, OnMenuBarWindowPosChanged },
+};
+
+constexpr msg_route g_unityRoutes[] = {
+    { WM_STYLECHANGING, OnUnityStyleChange },
+    { WM_STYLECHANGED, OnUnityStyleChange },
+};
+
+constexpr msg_route g_buttonRoutes[] = {
+    { WM_SETFONT, OnButtonSetFont },
+    { WM_SETTEXT, OnButtonSetText },
+    { WM_MOUSEMOVE, OnButtonMouseMove },
+    { WM_MOUSELEAVE, OnButtonMouseLeave },
+};
+
+constexpr msg_route g_controlColorRoutes[] = { { WM_PAINT, OnControlPaint } };
+constexpr msg_route g_comboBoxRoutes[] = { { WM_CTLCOLORLISTBOX, OnComboBoxCtlColorListBox } };
+
+// lazily attached windows until they are first shown, see RULE_LAZY
+constexpr msg_route g_pendingRoutes[] = {
+    { WM_ERASEBKGND, OnPendingShow },
+    { WM_NCCREATE, OnPendingNcCreate },
+    { WM_NCDESTROY, OnNcDestroy },
+    { WM_NCPAINT, OnPendingShow },
+    { WM_PAINT, OnPendingShow },
+    { WM_SHOWWINDOW, OnPendingShow },
+    { WM_WINDOWPOSCHANGING, OnPendingShow },
+};
+
+// a route in a later group replaces one for the same message in an earlier group
+constexpr dispatch_table MakeDispatchTable(std::initializer_list<std::span<const msg_route>> groups) {
+    dispatch_table table = {};
+    for (std::span<const msg_route> group : groups) {
+        for (const msg_route& route : group) {
+            table[route.msg] = route.handler;
+        }
+    }
+    return table;
+}
+
+// indexed by WndKind
+constexpr dispatch_table g_dispatchTables[WND_KIND_COUNT] = {
+    MakeDispatchTable({ g_commonRoutes }),                                   // Other
+    MakeDispatchTable({ g_commonRoutes, g_menuBarRoutes, g_unityRoutes }),   // Unity
+    MakeDispatchTable({ g_commonRoutes, g_menuBarRoutes }),                  // Dialog
+    MakeDispatchTable({ g_commonRoutes, g_buttonRoutes }),                   // Button
+    MakeDispatchTable({ g_commonRoutes, g_controlColorRoutes }),             // Tooltip
+    MakeDispatchTable({ g_commonRoutes, g_comboBoxRoutes }),                 // ComboBox
+    MakeDispatchTable({ g_commonRoutes, g_controlColorRoutes }),             // ListView
+    MakeDispatchTable({ g_commonRoutes, g_controlColorRoutes }),             // TreeView
+};
+
+// every kind has to clean up its state
+static_assert(std::all_of(std::begin(g_dispatchTables), std::end(g_dispatchTables),
+    [](const dispatch_table& table) { return table[WM_NCDESTROY] == OnNcDestroy; }));
+
+constexpr dispatch_table g_pendingDispatchTable = MakeDispatchTable({ g_pendingRoutes });
+static_assert(g_pendingDispatchTable[WM_NCDESTROY] == OnNcDestroy);
+
+const dispatch_table* GetDispatchTable(WndKind kind) {
+    return &g_dispatchTables[(int)kind];
+}
+
+const dispatch_table* GetPendingDispatchTable() {
+    return &g_pendingDispatchTable;
+}
+
+// the watchdog looks at the object counts this often, GetGuiResources is a system call
+constexpr ULONGLONG WATCHDOG_INTERVAL_MS = 5000;
+
+// leaves degraded mode once both counts are this far below their budget
+constexpr UINT WATCHDOG_RECOVERY_PERCENT = 90;
+
+// drops the off-screen copies of the thread's windows, they are rebuilt on demand
+void ReleaseRenderCaches(ui_thread& thread) {
+    for (wnd_state* state : thread.windows) {
+        ReleaseMenuBarSurface(state->menuBar);
+        ReleaseButtonCache(state->button);
+    }
+}
+
+// samples the process's object counts at most every WATCHDOG_INTERVAL_MS and
+// switches to plain rendering while either is over its budget, so that a leak
+// somewhere in the editor doesn't leave it unable to draw at all
+void SampleGuiResources() {
+    const ULONGLONG now = GetTickCount64();
+    ULONGLONG next = g_watchdog.nextSample.load(std::memory_order_relaxed);
+    if (now < next) return;
+    if (!g_watchdog.nextSample.compare_exchange_strong(next, now + WATCHDOG_INTERVAL_MS)) return;
+
+    const DWORD gdi = GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS);
+    const DWORD user = GetGuiResources(GetCurrentProcess(), GR_USEROBJECTS);
+    g_watchdog.gdiObjects = gdi;
+    g_watchdog.userObjects = user;
+    g_watchdog.gdiPeak = std::max(g_watchdog.gdiPeak.load(), gdi);
+    g_watchdog.userPeak = std::max(g_watchdog.userPeak.load(), user);
+    g_watchdog.samples++;
+
+    const watchdog_cfg& budget = LoadThemeConfig()->watchdog;
+    if (!g_watchdog.degraded) {
+        if (gdi <= budget.gdi_budget && user <= budget.user_budget) return;
+
+        g_watchdog.degraded = true;
+        g_watchdog.degradations++;
+    }
+    else {
+        if ((ULONGLONG)gdi * 100 > (ULONGLONG)budget.gdi_budget * WATCHDOG_RECOVERY_PERCENT ||
+            (ULONGLONG)user * 100 > (ULONGLONG)budget.user_budget * WATCHDOG_RECOVERY_PERCENT) {
+            return;
+        }
+        g_watchdog.degraded = false;
+    }
+
+    WCHAR msg[160];
+    swprintf_s(msg, L"UnityEditorDarkMode: %lu GDI and %lu USER objects, %s degraded rendering\n",
+        gdi, user, g_watchdog.degraded ? L"entering" : L"leaving");
+    OutputDebugStringW(msg);
+}
+
+// the caches of a thread's windows can only be dropped from that thread, each
+// one does so on its next message after rendering was degraded
+void CheckGuiResources(ui_thread& thread) {
+    SampleGuiResources();
+
+    const bool degraded = g_watchdog.degraded.load(std::memory_order_relaxed);
+    if (degraded && !thread.cachesReleased) {
+        ReleaseRenderCaches(thread);
+    }
+    thread.cachesReleased = degraded;
+}
+
+// snapshot returned by UnityEditorDarkMode_GetWatchdog; bump
+// WATCHDOG_VERSION whenever the layout changes
+typedef struct {
+    DWORD size;     // sizeof(dm_watchdog), set by the caller
+    DWORD version;
+    DWORD gdiObjects;   // last sample
+    DWORD userObjects;
+    DWORD gdiPeak;
+    DWORD userPeak;
+    DWORD gdiBudget;
+    DWORD userBudget;
+    DWORD samples;
+    DWORD degradations;
+    BOOL degraded;
+    LONG created[GDI_PATH_COUNT];   // indexed by GdiPath
+    LONG released[GDI_PATH_COUNT];
+} dm_watchdog;
+
+constexpr DWORD WATCHDOG_VERSION = 1;
+
+extern "C" BOOL WINAPI UnityEditorDarkMode_GetWatchdog(dm_watchdog* out) {
+    if (!out || out->size != sizeof(dm_watchdog)) return FALSE;
+
+    theme_reader reader;
+    const watchdog_cfg& budget = LoadThemeConfig()->watchdog;
+
+    memset(out, 0, sizeof(dm_watchdog));
+    out->size = sizeof(dm_watchdog);
+    out->version = WATCHDOG_VERSION;
+    out->gdiObjects = g_watchdog.gdiObjects;
+    out->userObjects = g_watchdog.userObjects;
+    out->gdiPeak = g_watchdog.gdiPeak;
+    out->userPeak = g_watchdog.userPeak;
+    out->gdiBudget = budget.gdi_budget;
+    out->userBudget = budget.user_budget;
+    out->samples = g_watchdog.samples;
+    out->degradations = g_watchdog.degradations;
+    out->degraded = g_watchdog.degraded;
+    for (int i = 0; i < GDI_PATH_COUNT; i++) {
+        out->created[i] = g_watchdog.created[i];
+        out->released[i] = g_watchdog.released[i];
+    }
+    return TRUE;
+}
+
+LRESULT CALLBACK CallWndSubClassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData) {
+    wnd_state* state = (wnd_state*)dwRefData;
+    call_depth depth;
+    subclass_timer timer(state->kind, uMsg);
+    TraceMessage(hWnd, state, uMsg, wParam, lParam);
+
+    const msg_handler handler = uMsg < DISPATCH_MESSAGE_COUNT ? (*state->dispatch)[uMsg] : nullptr;
+    if (!handler) {
+        return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+    }
+
+    theme_reader reader;
+    CheckGuiResources(*state->thread);
+    return handler(hWnd, state, uMsg, wParam, lParam);
+}
+
+// re-theme after the theme changed while the editor runs: every attached
+// window is queued and handled from a thread timer, which only fires when the
+// UI thread has nothing else to do, in slices of at most RETHEME_SLICE_MS.
+// Windows are grouped by their root and each root gets one redraw for all of
+// its children once the whole group has been handled. Every UI thread runs
+// its own job, see ui_thread.
+constexpr double RETHEME_SLICE_MS = 4.0;
+
+// what WM_NCCREATE and the first paint would have done with the old theme
+void RethemeWindow(HWND hWnd, wnd_state* state, const theme_cfg* cfg) {
+    // pending windows get their frame when they are first shown
+    if ((state->ruleActions & RULE_DARKMODE) && !state->pending) {
+        EnableDarkMode(hWnd);
+    }
+    if (ControlColorSetters(state->kind)) {
+        SetControlColors(hWnd, state->kind, cfg);
+        state->colorsVersion = cfg->version;
+    }
+}
+
+void CALLBACK RethemeTimerProc(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime) {
+    // thread timers fire on the thread that set them
+    ui_thread* thread = GetUiThread();
+    if (!thread) return;
+
+    retheme_job& job = thread->retheme;
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    const LONGLONG deadline = now.QuadPart + (LONGLONG)(freq.QuadPart * RETHEME_SLICE_MS / 1000.0);
+    job.slices++;
+
+    theme_reader reader;
+    const theme_cfg* cfg = LoadThemeConfig();
+    while (job.next < job.queue.size()) {
+        const retheme_entry& entry = job.queue[job.next++];
+
+        // windows destroyed since the job started are no longer subclassed
+        DWORD_PTR refData = 0;
+        if (GetWindowSubclass(entry.hwnd, CallWndSubClassProc, 0, &refData)) {
+            RethemeWindow(entry.hwnd, (wnd_state*)refData, cfg);
+        }
+
+        const bool lastOfRoot = job.next == job.queue.size() || job.queue[job.next].root != entry.root;
+        if (lastOfRoot && IsWindow(entry.root)) {
+            RedrawWindow(entry.root, nullptr, nullptr, RDW_INVALIDATE | RDW_ERASE | RDW_FRAME | RDW_ALLCHILDREN);
+            job.redraws++;
+        }
+
+        QueryPerformanceCounter(&now);
+        if (now.QuadPart >= deadline) break;
+    }
+    if (job.next < job.queue.size()) return;
+
+    KillTimer(nullptr, job.timer);
+    WCHAR msg[160];
+    swprintf_s(msg, L"UnityEditorDarkMode: re-themed %zu windows with %lu redraws in %lu slices, %.3f ms\n",
+        job.queue.size(), job.redraws, job.slices, (now.QuadPart - job.start.QuadPart) * 1000.0 / freq.QuadPart);
+    OutputDebugStringW(msg);
+    job = retheme_job{};
+}
+
+// (re)starts the job from the current set of windows; a theme change while a
+// job runs starts over, the windows already handled are cheap to do again
+void StartRetheme(ui_thread& thread) {
+    retheme_job& job = thread.retheme;
+    job.queue.clear();
+    job.queue.reserve(thread.windows.size());
+    for (const wnd_state* state : thread.windows) {
+        // set up with whatever theme is current once they are shown
+        if (state->pending) continue;
+        job.queue.push_back({ state->hwnd, GetAncestor(state->hwnd, GA_ROOT) });
+    }
+    std::stable_sort(job.queue.begin(), job.queue.end(),
+        [](const retheme_entry& a, const retheme_entry& b) { return a.root < b.root; });
+
+    job.next = 0;
+    job.slices = 0;
+    job.redraws = 0;
+    QueryPerformanceCounter(&job.start);
+    if (!job.timer) {
+        job.timer = SetTimer(nullptr, 0, USER_TIMER_MINIMUM, RethemeTimerProc);
+    }
+    if (!job.timer) {
+        job = retheme_job{};
+    }
+}
+
+void StopRetheme(ui_thread& thread) {
+    if (thread.retheme.timer) {
+        KillTimer(nullptr, thread.retheme.timer);
+    }
+    thread.retheme = retheme_job{};
+}
+
+// asks every UI thread to re-theme its windows, from the theme watcher
+void PostRetheme() {
+    for (const ui_thread& thread : g_uiThreads) {
+        if (const DWORD threadId = thread.threadId.load(std::memory_order_acquire)) {
+            PostThreadTag(threadId, RETHEME_MESSAGE_TAG);
+        }
+    }
+}
+
+// windows of a thread that existed before our hooks were installed
+typedef struct {
+    std::vector<HWND> windows;
+    LARGE_INTEGER deadline;
+    ULONG subclassed;
+    bool timedOut;
+} window_discovery;
+
+// discovery and attaching what it found give up after this long together
+// rather than stall the editor
+constexpr double WINDOW_DISCOVERY_BUDGET_MS = 50.0;
+
+bool IsPastDeadline(window_discovery& discovery) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    discovery.timedOut |= now.QuadPart > discovery.deadline.QuadPart;
+    return discovery.timedOut;
+}
+
+BOOL CALLBACK CollectWindow(HWND hWnd, LPARAM lParam) {
+    window_discovery& discovery = *(window_discovery*)lParam;
+    if (IsPastDeadline(discovery)) return FALSE;
+
+    discovery.windows.push_back(hWnd);
+    return TRUE;
+}
+
+// walks the windows of the calling thread, children included, instead of
+// every top-level window on the desktop; subclassing only works on our own
+// thread's windows, every UI thread looks for its own
+void DiscoverWindows(window_discovery& discovery) {
+    discovery.windows.reserve(1024);
+
+    EnumThreadWindows(GetCurrentThreadId(), CollectWindow, (LPARAM)&discovery);
+
+    // EnumChildWindows walks the whole tree below each top-level window
+    const size_t last = discovery.windows.size();
+    for (size_t i = 0; i < last && !discovery.timedOut; i++) {
+        EnumChildWindows(discovery.windows[i], CollectWindow, (LPARAM)&discovery);
+    }
+}
+
+// catch windows that have been created before we set up the CBTProc hook
+void AttachExistingWindows() {
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    window_discovery discovery = {};
+    discovery.deadline.QuadPart = start.QuadPart + (LONGLONG)(freq.QuadPart * WINDOW_DISCOVERY_BUDGET_MS / 1000.0);
+    DiscoverWindows(discovery);
+
+    theme_reader reader;
+    const theme_cfg* cfg = LoadThemeConfig();
+    for (const HWND& hWnd : discovery.windows) {
+        if (IsPastDeadline(discovery)) break;
+
+        // already created, and possibly shown, nothing to leave for later
+        const BYTE actions = GetRuleActions(hWnd, cfg) & ~RULE_LAZY;
+        if (!(actions & RULE_SUBCLASS)) continue;
+
+        const wnd_state* state = AttachWindow(hWnd, GetWndKind(hWnd), actions);
+        if (!state) continue;
+
+        // these missed CBTProc and WM_NCCREATE, catch up on what they would
+        // have done
+        if (actions & RULE_DARKMODE) EnableDarkMode(hWnd);
+        ApplyWindowStyle(hWnd, actions);
+        RedrawWindow(hWnd, nullptr, nullptr, RDW_INVALIDATE | RDW_ERASE | RDW_FRAME);
+        discovery.subclassed++;
+    }
+
+    QueryPerformanceCounter(&end);
+    WCHAR msg[192];
+    swprintf_s(msg, L"UnityEditorDarkMode: found %zu windows on thread %lu, subclassed %lu in %.3f ms%s\n",
+        discovery.windows.size(), GetCurrentThreadId(), discovery.subclassed,
+        (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart,
+        discovery.timedOut ? L" (time budget exceeded)" : L"");
+    OutputDebugStringW(msg);
+}
+
+constexpr WPARAM INIT_MESSAGE_TAG = 0x55454449; // tags our WM_NULL among the thread's messages
+constexpr WPARAM INIT_PROCESS_MESSAGE_TAG = 0x55454450; // same, for the thread that loaded the dll
+
+LRESULT CALLBACK ThreadMsgProc(int nCode, WPARAM wParam, LPARAM lParam);
+
+void UnhookUiThread(ui_thread& thread) {
+    ui_threads_lock lock;
+    if (thread.cbtHook) {
+        UnhookWindowsHookEx(thread.cbtHook);
+        thread.cbtHook = nullptr;
+    }
+    if (thread.msgHook) {
+        UnhookWindowsHookEx(thread.msgHook);
+        thread.msgHook = nullptr;
+    }
+}
+
+// a thread that exits before its slot is published finds no slot on
+// DLL_THREAD_DETACH, and would keep it for good; one that found its slot
+// gave it back before its handle was signaled. Caller holds g_uiThreadsLock.
+void ReclaimExitedUiThread(ui_thread& thread, HANDLE handle) {
+    if (handle && WaitForSingleObject(handle, 0) != WAIT_OBJECT_0) return;
+
+    // the system removed its hooks with it; the windows of one that was
+    // terminated are gone too, their states are lost, and the counts it
+    // recorded are kept but its stats block freed
+    thread.cbtHook = nullptr;
+    thread.msgHook = nullptr;
+    thread.windows = {};
+    thread.initialized = false;
+    const size_t slot = &thread - g_uiThreads;
+    if (g_threadStatsOwners[slot].load()) ReleaseThreadStatsBlock(g_threadStats[slot]);
+    thread.threadId.store(0, std::memory_order_release);
+}
+
+// claims a slot for threadId and hooks it; the thread picks up its existing
+// windows once it gets INIT_MESSAGE_TAG. The slot is published once both
+// hooks are in place, and reclaimed right away if the thread has exited by
+// then.
+ui_thread* HookUiThread(DWORD threadId) {
+    ui_threads_lock lock;
+    if (ui_thread* thread = FindUiThread(threadId)) return thread;
+
+    ui_thread* thread = FindUiThread(0);
+    if (!thread) return nullptr;
+
+    // held until the slot is published, so that threadId can't be reused
+    HANDLE handle = nullptr;
+    if (threadId != GetCurrentThreadId()) {
+        handle = OpenThread(SYNCHRONIZE, FALSE, threadId);
+        if (!handle) return nullptr;
+    }
+
+    HHOOK cbtHook = SetWindowsHookEx(WH_CBT, CBTProc, g_module, threadId);
+    HHOOK msgHook = SetWindowsHookEx(WH_GETMESSAGE, ThreadMsgProc, g_module, threadId);
+    if (!cbtHook || !msgHook) {
+        // most likely exited in the meantime
+        if (cbtHook) UnhookWindowsHookEx(cbtHook);
+        if (msgHook) UnhookWindowsHookEx(msgHook);
+        if (handle) CloseHandle(handle);
+        return nullptr;
+    }
+    thread->cbtHook = cbtHook;
+    thread->msgHook = msgHook;
+    thread->threadId.store(threadId, std::memory_order_release);
 
-    return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+    if (handle) {
+        ReclaimExitedUiThread(*thread, handle);
+        CloseHandle(handle);
+    }
+    return thread->threadId.load(std::memory_order_relaxed) == threadId ? thread : nullptr;
+}
+
+// threads that may yet become UI threads: those without a top-level window
+// when the dll was loaded and those started since (DLL_THREAD_ATTACH). The
+// editor runs many worker threads, past this many new ones aren't followed.
+constexpr int MAX_THREAD_CANDIDATES = 128;
+static std::atomic<DWORD> g_threadCandidates[MAX_THREAD_CANDIDATES];
+
+void AddThreadCandidate(DWORD threadId) {
+    for (auto& candidate : g_threadCandidates) {
+        DWORD expected = 0;
+        if (candidate.compare_exchange_strong(expected, threadId)) return;
+    }
+}
+
+void RemoveThreadCandidate(DWORD threadId) {
+    for (auto& candidate : g_threadCandidates) {
+        DWORD expected = threadId;
+        if (candidate.compare_exchange_strong(expected, 0)) return;
+    }
+}
+
+// the editor's UI threads own top-level windows; the many threads that only
+// ever make a USER call or two are left alone
+bool HasTopLevelWindow(DWORD threadId) {
+    bool found = false;
+    EnumThreadWindows(threadId, [](HWND hWnd, LPARAM lParam) {
+        *(bool*)lParam = true;
+        return FALSE;
+    }, (LPARAM)&found);
+    return found;
+}
+
+// hooks threadId once it is a UI thread; true when it is ours
+bool HookIfUiThread(DWORD threadId) {
+    if (!HasTopLevelWindow(threadId) || !HookUiThread(threadId)) return false;
+    PostThreadTag(threadId, INIT_MESSAGE_TAG);
+    return true;
+}
+
+// hooks the UI threads of this process that exist when the dll is loaded, the
+// others become candidates; runs once from the init stages
+void HookUiThreads() {
+    if (g_detaching) return;
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) return;
+
+    const DWORD processId = GetCurrentProcessId();
+    THREADENTRY32 te = { sizeof(te) };
+    for (BOOL more = Thread32First(snapshot, &te); more; more = Thread32Next(snapshot, &te)) {
+        if (te.th32OwnerProcessID != processId || FindUiThread(te.th32ThreadID)) continue;
+        if (!HookIfUiThread(te.th32ThreadID)) AddThreadCandidate(te.th32ThreadID);
+    }
+    CloseHandle(snapshot);
+}
+
+// from the theme watcher: hooks candidates that have become UI threads and
+// reclaims the slots of threads that exited before they could see them
+void ScanThreadCandidates() {
+    if (g_detaching) return;
+
+    for (ui_thread& thread : g_uiThreads) {
+        ui_threads_lock lock;
+        const DWORD threadId = thread.threadId.load(std::memory_order_acquire);
+        if (!threadId) continue;
+
+        HANDLE handle = OpenThread(SYNCHRONIZE, FALSE, threadId);
+        ReclaimExitedUiThread(thread, handle);
+        if (handle) CloseHandle(handle);
+    }
+    for (auto& candidate : g_threadCandidates) {
+        const DWORD threadId = candidate.load();
+        if (threadId && HookIfUiThread(threadId)) RemoveThreadCandidate(threadId);
+    }
+}
+
+// what becomes of a thread's windows when its slot is given back
+enum class WindowRelease {
+    Exit,       // the thread is exiting and its windows go with it
+    Unload,     // the dll goes away, the windows get their system look back
+    Handoff,    // another instance of the dll takes them over as they are
+};
+
+// takes us out of the thread's windows, frees what they and the thread used
+// and gives the slot back; only ever called on the thread itself
+void ReleaseUiThread(ui_thread& thread, WindowRelease how) {
+    UnhookUiThread(thread);
+    StopRetheme(thread);
+    for (wnd_state* state : thread.windows) {
+        if (how == WindowRelease::Unload) {
+            RestoreWindowStyle(state->hwnd, state);
+            if ((state->ruleActions & RULE_DARKMODE) && !state->pending) DisableDarkMode(state->hwnd);
+        }
+        RemoveWindowSubclass(state->hwnd, CallWndSubClassProc, 0);
+        ReleaseWindowState(state);
+    }
+    thread.windows = {};
+    for (dpi_resources& set : thread.dpiResources) {
+        ReleaseDpiResources(set);
+    }
+    thread.dpiResourcesClock = 0;
+    thread.initialized = false;
+    thread.cachesReleased = false;
+    ReleaseTraceBuffer();
+    ReleaseThreadStats();
+
+    t_uiThread = nullptr;
+    ui_threads_lock lock;
+    thread.threadId.store(0, std::memory_order_release);
+}
+
+// hot-swap: a new build of the dll loaded next to the running one takes over
+// its theme and windows instead of parsing the ini and discovering every
+// window again. The instance theming the process is recorded in the section
+// "Local\UnityEditorDarkMode.Instance.<pid>". A new one asks it for the theme
+// with UnityEditorDarkMode_Handoff and then, on each UI thread, for that
+// thread's windows with UnityEditorDarkMode_ReleaseThread; the old one can be
+// freed once its UnityEditorDarkMode_Unload returns TRUE.
+constexpr DWORD HANDOFF_VERSION = 1; // bump on any change to the structures below or to RuleAction
+
+typedef struct {
+    DWORD size;         // sizeof(dm_handoff), set by the caller
+    DWORD version;      // HANDOFF_VERSION, set by the caller
+    theme_cache theme;  // checked like the cache file, the other build may lay it out differently
+} dm_handoff;
+
+typedef struct {
+    HWND hwnd;
+    BYTE ruleActions;
+    BYTE buttonType;
+    BYTE pending;
+    BYTE reserved;
+} dm_handoff_window;
+
+typedef struct {
+    DWORD magic;                    // "UEDI"
+    std::atomic<HMODULE> module;    // the instance theming the process
+} instance_record;
+
+using fnHandoff = BOOL(WINAPI*)(dm_handoff* out);
+using fnReleaseThread = BOOL(WINAPI*)(DWORD version, dm_handoff_window* out, UINT* count);
+using fnUnload = BOOL(WINAPI*)();
+
+static instance_record* g_instance = nullptr;
+static HANDLE g_instanceMapping = nullptr;
+static HMODULE g_previousInstance = nullptr; // handing its windows over to us
+
+// records us as the instance theming the process, returns the one we replace
+HMODULE RegisterInstance() {
+    WCHAR name[64];
+    swprintf_s(name, L"Local\\UnityEditorDarkMode.Instance.%lu", GetCurrentProcessId());
+    g_instanceMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(instance_record), name);
+    if (!g_instanceMapping) return nullptr;
+
+    g_instance = (instance_record*)MapViewOfFile(g_instanceMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(instance_record));
+    if (!g_instance) {
+        CloseHandle(g_instanceMapping);
+        g_instanceMapping = nullptr;
+        return nullptr;
+    }
+    g_instance->magic = 0x49444555; // "UEDI"
+    HMODULE previous = g_instance->module.exchange(g_module);
+
+    // an instance that went away without unregistering isn't loaded anymore
+    HMODULE loaded = nullptr;
+    if (!previous || previous == g_module ||
+        !GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)previous, &loaded) ||
+        loaded != previous) {
+        return nullptr;
+    }
+    return previous;
+}
+
+void UnregisterInstance() {
+    if (g_instance) {
+        HMODULE self = g_module;
+        g_instance->module.compare_exchange_strong(self, nullptr);
+        UnmapViewOfFile(g_instance);
+        g_instance = nullptr;
+    }
+    if (g_instanceMapping) {
+        CloseHandle(g_instanceMapping);
+        g_instanceMapping = nullptr;
+    }
+}
+
+// how often the instance we replace is asked to unload, each waits up to
+// its UNLOAD_TIMEOUT_MS for its UI threads
+constexpr int TAKEOVER_UNLOAD_ATTEMPTS = 3;
+
+// asks the instance we replace for its theme, which also stops it from
+// attaching new windows; its windows are taken over thread by thread in
+// AttachThreadWindows. A build that doesn't speak our handoff version is
+// unloaded instead and we start from scratch, or stay inert if it can't be.
+// CBTProc attaches new windows only once this has run: until then the
+// instance we replace still does, and the attach stage picks up the ones on
+// the loading thread.
+void TakeOverInstance() {
+    HMODULE previous = RegisterInstance();
+    if (!previous) {
+        g_attachNew = true;
+        return;
+    }
+
+    const auto handoff = (fnHandoff)GetProcAddress(previous, "UnityEditorDarkMode_Handoff");
+    dm_handoff state = { sizeof(dm_handoff), HANDOFF_VERSION };
+    if (handoff && handoff(&state)) {
+        g_previousInstance = previous;
+        if (IsThemeCacheIntact(state.theme)) {
+            theme_cfg* cfg = BuildThemeConfig(state.theme);
+            const theme_cfg* expected = nullptr;
+            if (!g_theme.compare_exchange_strong(expected, cfg)) FreeThemeConfig(cfg);
+        }
+        g_attachNew = true;
+        return;
+    }
+
+    const auto unload = (fnUnload)GetProcAddress(previous, "UnityEditorDarkMode_Unload");
+    for (int attempt = 0; unload && attempt < TAKEOVER_UNLOAD_ATTEMPTS; attempt++) {
+        if (unload()) {
+            g_attachNew = true;
+            return;
+        }
+    }
+
+    // its windows are still subclassed, two builds drawing the same windows
+    // would fight over them; this one stays out of the way instead
+    OutputDebugStringW(L"UnityEditorDarkMode: the running instance didn't unload, not attaching any windows\n");
+    g_detaching = true;
+}
+
+// takes over the calling thread's windows from the instance we replace;
+// false if it didn't have the thread
+bool AdoptThreadWindows() {
+    const auto release = (fnReleaseThread)GetProcAddress(g_previousInstance, "UnityEditorDarkMode_ReleaseThread");
+    UINT count = 0;
+    if (!release || !release(HANDOFF_VERSION, nullptr, &count)) return false;
+
+    // nothing runs on this thread in between that could attach more windows
+    std::vector<dm_handoff_window> windows(count);
+    if (!release(HANDOFF_VERSION, windows.data(), &count) || count > windows.size()) return false;
+
+    for (UINT i = 0; i < count; i++) {
+        const dm_handoff_window& window = windows[i];
+        if (!IsWindow(window.hwnd)) continue;
+
+        const BYTE actions = window.pending ? window.ruleActions : window.ruleActions & ~RULE_LAZY;
+        if (wnd_state* state = AttachWindow(window.hwnd, GetWndKind(window.hwnd), actions)) {
+            state->buttonType = window.buttonType;
+        }
+    }
+
+    WCHAR msg[128];
+    swprintf_s(msg, L"UnityEditorDarkMode: took over %u windows on thread %lu\n", count, GetCurrentThreadId());
+    OutputDebugStringW(msg);
+    return true;
+}
+
+// the windows a thread has when it is set up
+void AttachThreadWindows() {
+    if (g_detaching) return;
+    if (!g_previousInstance || !AdoptThreadWindows()) {
+        AttachExistingWindows();
+    }
+}
+
+// what is left once no thread uses anything of ours anymore; at process exit
+// whatever is only memory is left to go with the process
+void ReleaseProcessResources(bool processExit) {
+    ReleaseThemeConfig(processExit);
+    CloseSharedTheme();
+    CloseStatsRing();
+    CloseMessageTrace();
+    UnregisterInstance();
+}
+
+extern "C" BOOL WINAPI UnityEditorDarkMode_Handoff(dm_handoff* out) {
+    if (!out || out->size != sizeof(dm_handoff) || out->version != HANDOFF_VERSION) return FALSE;
+    if (!StopThemeWatcher()) return FALSE;
+
+    // the new instance attaches the windows created from now on
+    g_detaching = true;
+    g_handedOff = true;
+
+    theme_reader reader;
+    const theme_cfg* cfg = g_theme.load(std::memory_order_acquire);
+    out->theme = cfg ? MakeThemeCache(*cfg, {}) : theme_cache{};
+    return TRUE;
+}
+
+// hands the calling thread's windows over as they are. With out null, or
+// *count too small, only stores the number of windows in *count; FALSE if
+// the thread isn't one of ours.
+extern "C" BOOL WINAPI UnityEditorDarkMode_ReleaseThread(DWORD version, dm_handoff_window* out, UINT* count) {
+    ui_thread* thread = GetUiThread();
+    if (version != HANDOFF_VERSION || !count || !thread) return FALSE;
+
+    const UINT needed = (UINT)thread->windows.size();
+    if (out && *count >= needed) {
+        for (UINT i = 0; i < needed; i++) {
+            const wnd_state* state = thread->windows[i];
+            out[i] = { state->hwnd, state->ruleActions, state->buttonType, state->pending };
+        }
+        ReleaseUiThread(*thread, WindowRelease::Handoff);
+    }
+    *count = needed;
+    return TRUE;
+}
+
+// how long UnityEditorDarkMode_Unload waits for the other UI threads
+constexpr DWORD UNLOAD_TIMEOUT_MS = 1000;
+
+constexpr WPARAM UNLOAD_MESSAGE_TAG = 0x55454455;
+
+// UI threads that took UNLOAD_MESSAGE_TAG and haven't returned out of
+// ThreadMsgProc yet; their slots are given back before that
+static std::atomic<int> g_unloadingThreads = 0;
+
+bool HasUiThreads() {
+    return std::any_of(std::begin(g_uiThreads), std::end(g_uiThreads),
+        [](const ui_thread& thread) { return thread.threadId.load(std::memory_order_acquire) != 0; }) ||
+        g_unloadingThreads.load(std::memory_order_acquire) != 0;
+}
+
+// takes the dll out of the editor so that it can be freed: every UI thread
+// removes its hooks and subclasses and gives its windows their system look
+// back, then the theme and everything else goes. The dll must not be freed
+// unless this returns TRUE; a thread that didn't get to its message loop in
+// time, or a theme watcher that didn't stop, makes it return FALSE and
+// calling again retries. Called from within a
+// message to one of our windows, e.g. a menu item's script, it returns FALSE
+// right away since freeing the dll would return into it.
+extern "C" BOOL WINAPI UnityEditorDarkMode_Unload() {
+    if (t_callDepth) {
+        OutputDebugStringW(L"UnityEditorDarkMode: can't unload from within one of our windows' messages\n");
+        return FALSE;
+    }
+    if (!StopThemeWatcher()) return FALSE;
+
+    g_detaching = true;
+
+    const DWORD self = GetCurrentThreadId();
+    for (ui_thread& thread : g_uiThreads) {
+        const DWORD threadId = thread.threadId.load(std::memory_order_acquire);
+        if (threadId == self) {
+            ReleaseUiThread(thread, WindowRelease::Unload);
+        }
+        else if (threadId) {
+            PostThreadTag(threadId, UNLOAD_MESSAGE_TAG);
+        }
+    }
+
+    // the other threads may well be sending us messages meanwhile
+    const ULONGLONG deadline = GetTickCount64() + UNLOAD_TIMEOUT_MS;
+    while (HasUiThreads()) {
+        if (GetTickCount64() >= deadline) return FALSE;
+
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, 1, QS_SENDMESSAGE);
+        MSG msg;
+        PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+    }
+
+    if (!g_handedOff) DisableProcessDarkMode();
+    ReleaseProcessResources(false);
+    OutputDebugStringW(L"UnityEditorDarkMode: unloaded\n");
+    return TRUE;
+}
+
+// attach work that doesn't need to happen under the loader lock; it runs in
+// this order from the UI thread's message loop once DllMain has returned
+typedef struct {
+    const char* name;
+    void (*run)();
+} init_stage;
+
+static const init_stage g_initStages[] = {
+    { "probe os capabilities",    [] { GetOsCaps(); } },
+    { "take over running instance", TakeOverInstance },
+    { "enable process dark mode", EnableProcessDarkMode },
+    { "load theme",               [] { LoadThemeConfig(); } },
+    { "attach existing windows",  AttachThreadWindows },
+    { "hook ui threads",          HookUiThreads },
+    { "start theme watcher",      StartThemeWatcher },
+    { "open stats ring",          OpenStatsRing },
+    { "open message trace",       OpenMessageTrace },
+};
+
+void RunInitStages() {
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+
+    for (const init_stage& stage : g_initStages) {
+        // the instance we replace couldn't be unloaded
+        if (g_detaching) break;
+
+        QueryPerformanceCounter(&start);
+        stage.run();
+        QueryPerformanceCounter(&end);
+
+        WCHAR msg[128];
+        swprintf_s(msg, L"UnityEditorDarkMode: %S took %.3f ms\n", stage.name,
+            (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+        OutputDebugStringW(msg);
+    }
+}
+
+// our tagged WM_NULLs: INIT_MESSAGE_TAG once per thread, or
+// INIT_PROCESS_MESSAGE_TAG on the thread that loaded the dll, which also sets
+// up everything process wide; RETHEME_MESSAGE_TAG after every theme change
+// and UNLOAD_MESSAGE_TAG from UnityEditorDarkMode_Unload. True when the
+// thread gave its slot back, see g_unloadingThreads.
+bool OnThreadTag(WPARAM tag) {
+    call_depth depth;
+    ui_thread* thread = GetUiThread();
+    if (!thread) return false;
+
+    const bool init = tag == INIT_MESSAGE_TAG || tag == INIT_PROCESS_MESSAGE_TAG;
+    if (init && !thread->initialized) {
+        // set first so that nothing the stages pump gets here again
+        thread->initialized = true;
+        if (tag == INIT_PROCESS_MESSAGE_TAG) {
+            RunInitStages();
+        }
+        else {
+            AttachThreadWindows();
+        }
+    }
+    else if (tag == RETHEME_MESSAGE_TAG) {
+        StartRetheme(*thread);
+    }
+    else if (tag == UNLOAD_MESSAGE_TAG && t_callDepth == 1) {
+        // a thread in a modal loop under our window procedure is left for
+        // the next UnityEditorDarkMode_Unload
+        g_unloadingThreads++;
+        ReleaseUiThread(*thread, WindowRelease::Unload);
+        return true;
+    }
+    return false;
+}
+
+LRESULT CALLBACK ThreadMsgProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    const MSG* msg = (const MSG*)lParam;
+    bool unloaded = false;
+    if (nCode == HC_ACTION && wParam == PM_REMOVE && msg->hwnd == nullptr && msg->message == WM_NULL &&
+        msg->lParam == (LPARAM)g_module) {
+        unloaded = OnThreadTag(msg->wParam);
+    }
+    const LRESULT result = CallNextHookEx(nullptr, nCode, wParam, lParam);
+
+    // last, past this the thread only returns out of the dll
+    if (unloaded) g_unloadingThreads.fetch_sub(1, std::memory_order_release);
+    return result;
 }
 
 // DLL entry
@@ -613,26 +3998,50 @@ bool APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpRes) {
     switch (reason)
     {
         case DLL_PROCESS_ATTACH: {
-            // enable dark mode for the current process window
-            EnableDarkMode(nullptr);
-
-            // catch windows that have been created before we set up the CBTProc hook
-            std::vector<HWND> windowHandles;
-            GetAllWindowsByProcessID(GetCurrentProcessId(), windowHandles);
-
-            for (const HWND& hWnd : windowHandles) {
-                SetWindowSubclass(hWnd, CallWndSubClassProc, 0, 0);
-                EnableDarkMode(hWnd);
+            g_module = hModule;
+
+            // set up the CBTProc hook to catch new windows, the other UI
+            // threads are hooked from the init stages
+            const DWORD threadId = GetCurrentThreadId();
+            ui_thread* thread = HookUiThread(threadId);
+
+            // everything else waits until the loader lock has been released and
+            // the UI thread gets back to its message loop
+            if (!thread || !thread->msgHook || !PostThreadTag(threadId, INIT_PROCESS_MESSAGE_TAG)) {
+                if (thread) thread->initialized = true;
+                RunInitStages();
             }
-
-            // set up the CBTProc hook to catch new windows
-            g_hook = SetWindowsHookEx(WH_CBT, CBTProc, nullptr, GetCurrentThreadId());
             break;
         }
         case DLL_PROCESS_DETACH: {
-            if (g_hook) {
-                UnhookWindowsHookEx(g_hook);
-                g_hook = nullptr;
+            // UnityEditorDarkMode_Unload has normally done this already; when
+            // the process exits, the windows go away with it
+            g_detaching = true;
+            const DWORD threadId = GetCurrentThreadId();
+            for (ui_thread& thread : g_uiThreads) {
+                if (!lpRes && thread.threadId.load() == threadId) {
+                    ReleaseUiThread(thread, WindowRelease::Unload);
+                }
+                else {
+                    UnhookUiThread(thread);
+                }
+            }
+            ReleaseProcessResources(lpRes != nullptr);
+            if (g_themeWatcherStop) {
+                CloseHandle(g_themeWatcherStop);
+                g_themeWatcherStop = nullptr;
+            }
+            break;
+        }
+        case DLL_THREAD_ATTACH: {
+            if (!g_detaching) AddThreadCandidate(GetCurrentThreadId());
+            break;
+        }
+        case DLL_THREAD_DETACH: {
+            ReleaseTraceBuffer();
+            RemoveThreadCandidate(GetCurrentThreadId());
+            if (ui_thread* thread = FindUiThread(GetCurrentThreadId())) {
+                ReleaseUiThread(*thread, WindowRelease::Exit);
             }
             break;
         }
@@ -640,4 +4049,4 @@ bool APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpRes) {
     }
 
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,152 @@
+// What finding the editor's existing windows costs when the desktop holds
+// tens of thousands of windows of other processes: DiscoverWindows, which
+// walks the calling thread's own windows and their children, next to the
+// FindWindowEx loop over every top-level window with a
+// GetWindowThreadProcessId each that it replaced (BaselineDiscovery, which
+// never saw children either). --quick (what ctest runs) fails unless the
+// load attached every window of the editor and none of the others within
+// WINDOW_DISCOVERY_BUDGET_MS, and discovery made no call per foreign window.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "editor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+namespace {
+
+// the other processes' windows: a thread each, with top-level windows of a
+// few children
+constexpr int FOREIGN_PROCESSES = 40;
+constexpr int FOREIGN_TOP_LEVEL = 250;  // per process
+constexpr int FOREIGN_CHILDREN = 3;     // per top-level window
+
+// the editor's, on the main thread
+constexpr int DIALOGS = 40;
+constexpr int CONTROLS = 15;            // per dialog
+
+// the old GetAllWindowsByProcessID
+void BaselineDiscovery(std::vector<HWND>& windows) {
+    const DWORD processId = GetCurrentProcessId();
+    HWND hWnd = nullptr;
+    while ((hWnd = FindWindowEx(nullptr, hWnd, nullptr, nullptr)) != nullptr) {
+        DWORD windowProcessId = 0;
+        GetWindowThreadProcessId(hWnd, &windowProcessId);
+        if (windowProcessId == processId) windows.push_back(hWnd);
+    }
+}
+
+size_t CreateForeignWindows() {
+    size_t count = 0;
+    for (int p = 0; p < FOREIGN_PROCESSES; p++) {
+        const DWORD processId = GetCurrentProcessId() + 1 + p;
+        const DWORD threadId = 0x40000000 + p;
+        for (int i = 0; i < FOREIGN_TOP_LEVEL; i++) {
+            HWND hWnd = standin::CreateForeignWindow(processId, threadId);
+            for (int j = 0; j < FOREIGN_CHILDREN; j++) standin::CreateForeignWindow(processId, threadId, hWnd);
+            count += 1 + FOREIGN_CHILDREN;
+        }
+    }
+    return count;
+}
+
+std::vector<HWND> CreateEditorWindows() {
+    std::vector<HWND> windows;
+    for (int i = 0; i < DIALOGS; i++) {
+        HWND dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+        windows.push_back(dialog);
+        for (int j = 0; j < CONTROLS; j++) {
+            windows.push_back(standin::CreateWindow(L"Button", dialog, WS_CHILD | BS_PUSHBUTTON));
+        }
+    }
+    return windows;
+}
+
+unsigned long long TotalApiCalls() {
+    unsigned long long calls = 0;
+    for (const auto& [name, count] : standin::ApiCallCounts()) calls += count;
+    return calls;
+}
+
+template <typename Discovery>
+double MsPerDiscovery(int rounds, Discovery discovery) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) discovery();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count() / rounds;
+}
+
+// the load's own report of AttachExistingWindows on this thread
+std::wstring LoadReport() {
+    const std::wstring prefix = L"UnityEditorDarkMode: found ";
+    for (const std::wstring& line : standin::DebugLog()) {
+        if (line.starts_with(prefix)) return line;
+    }
+    return {};
+}
+
+}
+
+int main(int argc, char** argv) {
+    const bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    const int rounds = quick ? 5 : 200;
+
+    // everything exists before the dll is loaded, as when it is injected
+    // into a running editor
+    const size_t foreign = CreateForeignWindows();
+    const std::vector<HWND> editorWindows = CreateEditorWindows();
+    editor::LoadDll();
+    printf("%zu foreign windows, %zu editor windows\n", foreign, editorWindows.size());
+
+    const std::wstring report = LoadReport();
+    printf("load: %ls", report.empty() ? L"no discovery report\n" : report.c_str());
+    bool attached = true;
+    for (HWND hWnd : editorWindows) attached &= editor::WindowState(hWnd) != nullptr;
+
+    std::vector<HWND> baselineWindows;
+    standin::ResetApiCalls();
+    const double baseline = MsPerDiscovery(rounds, [&baselineWindows] {
+        baselineWindows.clear();
+        BaselineDiscovery(baselineWindows);
+    });
+    const unsigned long long baselineCalls = TotalApiCalls() / rounds;
+
+    window_discovery discovery = {};
+    standin::ResetApiCalls();
+    const double current = MsPerDiscovery(rounds, [&discovery] {
+        discovery = {};
+        discovery.deadline.QuadPart = LLONG_MAX;
+        DiscoverWindows(discovery);
+    });
+    const unsigned long long calls = TotalApiCalls() / rounds;
+    const unsigned long long perForeignWindow = standin::ApiCalls("GetWindowThreadProcessId") + standin::ApiCalls("FindWindowEx");
+
+    printf("before   %9.3f ms/discovery %7llu API calls %5zu windows found\n", baseline, baselineCalls, baselineWindows.size());
+    printf("after    %9.3f ms/discovery %7llu API calls %5zu windows found\n", current, calls, discovery.windows.size());
+    printf("speedup  %.2fx\n", baseline / current);
+
+    if (!editor::UnloadDll()) {
+        fprintf(stderr, "unload failed\n");
+        return 1;
+    }
+    if (!attached || report.find(L"found " + std::to_wstring(editorWindows.size()) + L" windows") == std::wstring::npos) {
+        fprintf(stderr, "the load didn't find every window of the editor\n");
+        return 1;
+    }
+    if (report.find(L"time budget exceeded") != std::wstring::npos || current >= WINDOW_DISCOVERY_BUDGET_MS) {
+        fprintf(stderr, "discovery took longer than its budget\n");
+        return 1;
+    }
+    if (std::set<HWND>(discovery.windows.begin(), discovery.windows.end()) != std::set<HWND>(editorWindows.begin(), editorWindows.end())) {
+        fprintf(stderr, "discovery found other windows than the editor's\n");
+        return 1;
+    }
+    // a call for each window of ours at most, none for the others
+    if (perForeignWindow != 0 || calls > 2 * editorWindows.size()) {
+        fprintf(stderr, "discovery made calls per foreign window\n");
+        return 1;
+    }
+    return 0;
+}
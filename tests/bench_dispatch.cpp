@@ -0,0 +1,139 @@
+// Replays a message mix typical of the editor (menu bar paints, control
+// colors, owner-drawn buttons, mouse moves) through the real subclass procs
+// against the stand-in user32 and reports the cost per message and the API
+// calls it took. --baseline adds back what the subclass proc did on every
+// message before the window kind was kept in the per-window state: a
+// GetClassName and a string compare per class it could be, see
+// BaselineClassChecks. --quick runs a short replay and fails unless the
+// dispatch made no class name lookups, which is what ctest runs.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "editor.h"
+#include "session.h"
+
+#include <chrono>
+#include <cstdlib>
+
+namespace {
+
+bool IsWndClass(HWND hWnd, const WCHAR* classname) {
+    WCHAR buf[512];
+    GetClassName(hWnd, buf, 512);
+    return _wcsicmp(classname, buf) == 0;
+}
+
+bool IsUnityWndClass(HWND hWnd) {
+    return IsWndClass(hWnd, L"UnityContainerWndClass");
+}
+
+// the class checks of the switch in the old CallWndSubClassProc, which ran for
+// every message of every window it had subclassed, in the same order
+void BaselineClassChecks(HWND hWnd, UINT uMsg) {
+    switch (uMsg) {
+        case WM_CTLCOLORLISTBOX:
+            IsWndClass(hWnd, L"ComboBox");
+            break;
+        case WM_NCACTIVATE:
+        case WM_NCPAINT:
+        case WM_THEMECHANGED:
+        case WM_UAHDRAWMENU:
+        case WM_UAHDRAWMENUITEM:
+        case WM_UAHMEASUREMENUITEM:
+            if (!IsUnityWndClass(hWnd)) IsWndClass(hWnd, L"#32770");
+            break;
+        case WM_NCCREATE:
+            if (!IsWndClass(hWnd, L"tooltips_class32") && !IsWndClass(hWnd, L"ComboBox")) IsWndClass(hWnd, L"Button");
+            break;
+        case WM_PAINT:
+            if (!IsWndClass(hWnd, L"tooltips_class32") && !IsWndClass(hWnd, L"SysTreeView32")) IsWndClass(hWnd, L"SysListView32");
+            break;
+        case WM_STYLECHANGING:
+        case WM_STYLECHANGED:
+            IsUnityWndClass(hWnd);
+            break;
+        default:
+            break;
+    }
+}
+
+typedef struct {
+    size_t messages;
+    double nsPerMessage;
+    std::vector<std::pair<std::string, unsigned long long>> calls;
+} replay_result;
+
+replay_result Replay(const editor::session& s, int frames, bool baseline) {
+    standin::ResetApiCalls();
+    const auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (const editor::replay_msg& m : s.messages) {
+            if (baseline) BaselineClassChecks(m.hwnd, m.msg);
+            SendMessage(m.hwnd, m.msg, m.wParam, m.lParam);
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    replay_result result;
+    result.messages = s.messages.size() * frames;
+    result.nsPerMessage = std::chrono::duration<double, std::nano>(elapsed).count() / result.messages;
+    result.calls = standin::ApiCallCounts();
+    return result;
+}
+
+void Report(const char* name, const replay_result& r) {
+    printf("%-8s %8zu messages %9.1f ns/message\n", name, r.messages, r.nsPerMessage);
+    for (const auto& [api, calls] : r.calls) {
+        // the replay's own sends are one per message
+        const unsigned long long own = api == "SendMessage" ? r.messages : 0;
+        if (calls > own) printf("    %-28s %8.3f calls/message\n", api.c_str(), (double)(calls - own) / r.messages);
+    }
+}
+
+unsigned long long Calls(const replay_result& r, std::string_view api) {
+    for (const auto& [name, calls] : r.calls) {
+        if (name == api) return calls;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    bool baselineOnly = false;
+    for (int i = 1; i < argc; i++) {
+        quick |= strcmp(argv[i], "--quick") == 0;
+        baselineOnly |= strcmp(argv[i], "--baseline") == 0;
+    }
+    const int frames = quick ? 50 : 20000;
+
+    editor::LoadDll();
+    editor::session s;
+    editor::CreateSession(s);
+    editor::FixComboList(s);
+
+    // warm up the caches the way the first frames of a session would
+    Replay(s, 10, false);
+
+    const replay_result baseline = Replay(s, frames, true);
+    Report("before", baseline);
+    if (baselineOnly) return 0;
+
+    const replay_result current = Replay(s, frames, false);
+    Report("after", current);
+    printf("speedup  %.2fx\n", baseline.nsPerMessage / current.nsPerMessage);
+
+    ReleaseDC(s.unity, s.hdc);
+    if (!editor::UnloadDll()) {
+        fprintf(stderr, "unload failed\n");
+        return 1;
+    }
+
+    // the point of keeping the kind in the window's state: no class lookups
+    // while dispatching, however many messages
+    if (Calls(current, "GetClassName") != 0 || Calls(current, "_wcsicmp") != 0) {
+        fprintf(stderr, "dispatch looked up class names\n");
+        return 1;
+    }
+    return 0;
+}
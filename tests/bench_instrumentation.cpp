@@ -0,0 +1,121 @@
+// What the message instrumentation costs: the subclass_timer and cbt_timer
+// that wrap every call into CallWndSubClassProc and CBTProc, with and without
+// the live stats ring, and the CallDefSubclassProc wrapper. Reported in the
+// same cycles the statistics are kept in, each the best of several rounds
+// with the cost of the empty loop taken out, averaged over timed and untimed
+// calls alike. --quick (what ctest runs) fails if what a message pays
+// without the ring, counter reads and all, is over
+// INSTRUMENTATION_BUDGET_CYCLES, or if the calls weren't all counted and one
+// in STATS_SAMPLE_INTERVAL timed.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "editor.h"
+
+#include <cstdlib>
+
+namespace {
+
+constexpr double INSTRUMENTATION_BUDGET_CYCLES = 100.0;
+
+// keeps the compiler from dropping or merging loop iterations
+volatile UINT g_msg = WM_PAINT;
+
+template <typename Body>
+double CyclesPerCall(int calls, Body body) {
+    double best = 1e300;
+    for (int round = 0; round < 7; round++) {
+        const ULONGLONG start = __rdtsc();
+        for (int i = 0; i < calls; i++) body(g_msg);
+        const ULONGLONG cycles = __rdtsc() - start;
+        best = std::min(best, (double)cycles / calls);
+    }
+    return best;
+}
+
+typedef struct {
+    const char* name;
+    double cycles;
+    bool budgeted;
+} measurement;
+
+// a subclass that does nothing but pass the message on, instrumented the way
+// CallWndSubClassProc is or not at all
+LRESULT CALLBACK PassThrough(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData) {
+    if (!dwRefData) return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+
+    subclass_timer timer(WndKind::Button, uMsg);
+    return CallDefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+msg_stats SubclassStats(UINT msg) {
+    return GetThreadStats()->subclass[(int)WndKind::Button][g_statMessageSlots[msg]];
+}
+
+}
+
+int main(int argc, char** argv) {
+    const bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    const int calls = quick ? 200000 : 5000000;
+
+    editor::LoadDll();
+    HWND hWnd = standin::CreateWindow(L"Static", nullptr, WS_OVERLAPPEDWINDOW);
+
+    const double empty = CyclesPerCall(calls, [](UINT msg) { asm volatile("" : : "r"(msg) : "memory"); });
+    const double counterRead = CyclesPerCall(calls, [](UINT msg) { asm volatile("" : : "r"(__rdtsc() + msg) : "memory"); }) - empty;
+    const double subclassTimer = CyclesPerCall(calls, [](UINT msg) { subclass_timer timer(WndKind::Button, msg); }) - empty;
+    const double cbtTimer = CyclesPerCall(calls, [](UINT msg) { cbt_timer timer((int)msg & 7); }) - empty;
+
+    // a whole subclassed message, timer and DefSubclassProc wrapper, against
+    // the same subclass uninstrumented
+    SetWindowSubclass(hWnd, PassThrough, 1, 0);
+    const double plain = CyclesPerCall(calls / 10, [hWnd](UINT msg) { SendMessage(hWnd, msg, 0, 0); });
+    SetWindowSubclass(hWnd, PassThrough, 1, 1);
+    const msg_stats before = SubclassStats(g_msg);
+    const double wrapped = CyclesPerCall(calls / 10, [hWnd](UINT msg) { SendMessage(hWnd, msg, 0, 0); });
+    const msg_stats after = SubclassStats(g_msg);
+    RemoveWindowSubclass(hWnd, PassThrough, 1);
+    const double subclassedMessage = wrapped - plain;
+
+    const unsigned long long sent = 7ull * (calls / 10);
+    const unsigned long long counted = after.count - before.count;
+    const unsigned long long timed = after.timed - before.timed;
+    printf("%llu messages, %llu counted, %llu timed\n", sent, counted, timed);
+    const bool sampled = counted == sent && timed - sent / STATS_SAMPLE_INTERVAL <= 1;
+
+    // the ring is opt-in, its cost is reported but not budgeted
+    standin::SetEnv(L"UNITYEDITORDARKMODE_STATS_RING", L"1");
+    OpenStatsRing();
+    const double ringTimer = g_statsRing.load() ?
+        CyclesPerCall(calls, [](UINT msg) { subclass_timer timer(WndKind::Button, msg); }) - empty : 0;
+    CloseStatsRing();
+
+    const measurement results[] = {
+        { "__rdtsc", counterRead, false },
+        { "subclass_timer", subclassTimer, false },
+        { "subclass_timer + ring", ringTimer, false },
+        { "subclassed message", subclassedMessage, true },
+        { "CBTProc call", cbtTimer, true },
+    };
+
+    bool overBudget = false;
+    for (const measurement& m : results) {
+        const bool over = m.budgeted && m.cycles > INSTRUMENTATION_BUDGET_CYCLES;
+        printf("%-24s %8.1f cycles%s\n", m.name, m.cycles, over ? "  over budget" : "");
+        overBudget |= over;
+    }
+
+    standin::DestroyWindow(hWnd);
+    if (!editor::UnloadDll()) {
+        fprintf(stderr, "unload failed\n");
+        return 1;
+    }
+    if (!sampled) {
+        fprintf(stderr, "expected every message counted and one in %u timed\n", (unsigned)STATS_SAMPLE_INTERVAL);
+        return 1;
+    }
+    if (overBudget) {
+        fprintf(stderr, "instrumentation costs more than %.0f cycles per message\n", INSTRUMENTATION_BUDGET_CYCLES);
+        return 1;
+    }
+    return 0;
+}
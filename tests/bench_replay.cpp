@@ -0,0 +1,394 @@
+// Replays a message trace, as written by the dll when UNITYEDITORDARKMODE_TRACE
+// names a file, through the real subclass procs against the stand-in user32
+// and GDI, and reports the cost per message, by message, and the API calls
+// per message. Windows of the kinds the trace names are created for it, and
+// the structures that lParam points to are rebuilt from what the records kept
+// of them (see TraceDetail); messages whose structures can't be rebuilt are
+// counted as skipped.
+//
+//     bench_replay [--quick] [--repeat n] [trace]
+//
+// Without a trace it first records one of an editor session (session.h)
+// through the dll's own trace mode. --quick, what ctest runs, replays that
+// twice and fails unless every message was recorded and replayed, and unless
+// the control color setters were sent on each control's first paint only,
+// with every later paint counted in ControlColorMessagesSaved.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "editor.h"
+#include "session.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+
+namespace {
+
+// the window classes of each kind, indexed by WndKind; Other has none we
+// could recreate
+const wchar_t* const g_kindClasses[WND_KIND_COUNT] = {
+    nullptr, L"UnityContainerWndClass", L"#32770", L"Button", L"tooltips_class32",
+    L"ComboBox", L"SysListView32", L"SysTreeView32",
+};
+
+bool IsChildKind(WndKind kind) {
+    return kind == WndKind::Button || kind == WndKind::ComboBox || kind == WndKind::ListView || kind == WndKind::TreeView;
+}
+
+const char* MessageName(UINT msg) {
+    switch (msg) {
+        case WM_SIZE: return "WM_SIZE";
+        case WM_SETTEXT: return "WM_SETTEXT";
+        case WM_PAINT: return "WM_PAINT";
+        case WM_ERASEBKGND: return "WM_ERASEBKGND";
+        case WM_SHOWWINDOW: return "WM_SHOWWINDOW";
+        case WM_SETCURSOR: return "WM_SETCURSOR";
+        case WM_DRAWITEM: return "WM_DRAWITEM";
+        case WM_SETFONT: return "WM_SETFONT";
+        case WM_WINDOWPOSCHANGING: return "WM_WINDOWPOSCHANGING";
+        case WM_WINDOWPOSCHANGED: return "WM_WINDOWPOSCHANGED";
+        case WM_STYLECHANGING: return "WM_STYLECHANGING";
+        case WM_STYLECHANGED: return "WM_STYLECHANGED";
+        case WM_NCPAINT: return "WM_NCPAINT";
+        case WM_NCACTIVATE: return "WM_NCACTIVATE";
+        case WM_INITMENU: return "WM_INITMENU";
+        case WM_CTLCOLOREDIT: return "WM_CTLCOLOREDIT";
+        case WM_CTLCOLORLISTBOX: return "WM_CTLCOLORLISTBOX";
+        case WM_CTLCOLORDLG: return "WM_CTLCOLORDLG";
+        case WM_CTLCOLORSTATIC: return "WM_CTLCOLORSTATIC";
+        case WM_MOUSEMOVE: return "WM_MOUSEMOVE";
+        case WM_MOUSELEAVE: return "WM_MOUSELEAVE";
+        case WM_THEMECHANGED: return "WM_THEMECHANGED";
+        case WM_UAHDRAWMENU: return "WM_UAHDRAWMENU";
+        case WM_UAHDRAWMENUITEM: return "WM_UAHDRAWMENUITEM";
+        case CB_GETCOMBOBOXINFO: return "CB_GETCOMBOBOXINFO";
+        case WM_UAHINITMENU: return "WM_UAHINITMENU";
+        default: return nullptr;
+    }
+}
+
+// messages of a window's lifetime, which the replay's own windows have had
+bool IsLifetimeMessage(UINT msg) {
+    return msg == WM_NCCREATE || msg == WM_CREATE || msg == WM_DESTROY || msg == WM_NCDESTROY;
+}
+
+// messages whose lParam points to something the trace keeps nothing of
+bool IsUnrebuildable(UINT msg) {
+    switch (msg) {
+        case WM_GETTEXT:
+        case WM_GETMINMAXINFO:
+        case WM_MEASUREITEM:
+        case WM_NOTIFY:
+        case WM_NCCALCSIZE:
+        case WM_DPICHANGED:
+        case WM_UAHMEASUREMENUITEM:
+        case WM_PRINT:
+        case WM_PRINTCLIENT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+typedef struct {
+    HWND hwnd;
+    WndKind kind;
+    HMENU menu;
+    HWND list;      // combo boxes, their list box
+} replay_window;
+
+// the trace turned into messages for the replay's windows, with the
+// structures they point to
+struct replay {
+    HWND host = nullptr;    // parent of the child windows
+    HWND other = nullptr;   // stands in for windows the trace has no records of
+    HDC hdc = nullptr;
+    std::map<DWORD, replay_window> windows;    // by the traced handle
+    HWND anyButton = nullptr;
+    std::vector<editor::replay_msg> messages;
+    size_t lifetime = 0;
+    size_t skipped = 0;
+
+    std::deque<DRAWITEMSTRUCT> drawItems;
+    std::deque<UAHMENU> menus;
+    std::deque<UAHDRAWMENUITEM> menuItems;
+    std::deque<WINDOWPOS> positions;
+    std::deque<STYLESTRUCT> styles;
+    std::deque<std::wstring> texts;
+    std::deque<COMBOBOXINFO> comboInfos;
+};
+
+const replay_window* GetWindow(replay& r, const trace_record& record) {
+    auto it = r.windows.find(record.hwnd);
+    if (it != r.windows.end()) return &it->second;
+
+    const WndKind kind = (WndKind)record.kind;
+    if (record.kind >= WND_KIND_COUNT || !g_kindClasses[record.kind]) return nullptr;
+
+    replay_window w = { nullptr, kind };
+    if (IsChildKind(kind)) {
+        w.hwnd = standin::CreateWindow(g_kindClasses[record.kind], r.host, WS_CHILD | record.buttonType);
+    }
+    else {
+        w.hwnd = standin::CreateWindow(g_kindClasses[record.kind], nullptr, kind == WndKind::Tooltip ? WS_POPUP : WS_OVERLAPPEDWINDOW);
+    }
+    if (kind == WndKind::Unity) {
+        w.menu = standin::CreateMenu({ L"&File", L"&Edit", L"&Assets", L"&GameObject", L"&Component", L"&Window", L"&Help" });
+        standin::SetMenu(w.hwnd, w.menu);
+    }
+    standin::ShowWindow(w.hwnd);
+    if (kind == WndKind::ComboBox) {
+        COMBOBOXINFO info = { sizeof(info) };
+        SendMessage(w.hwnd, CB_GETCOMBOBOXINFO, 0, (LPARAM)&info);
+        w.list = info.hwndList;
+    }
+    if (kind == WndKind::Button && !r.anyButton) r.anyButton = w.hwnd;
+    return &r.windows.emplace(record.hwnd, w).first->second;
+}
+
+HWND MapWindow(replay& r, DWORD traced) {
+    if (!traced) return nullptr;
+    auto it = r.windows.find(traced);
+    return it == r.windows.end() ? r.other : it->second.hwnd;
+}
+
+// the message to send for a record, false when it can't be replayed
+bool Rebuild(replay& r, const trace_record& record, editor::replay_msg& m) {
+    const replay_window* w = GetWindow(r, record);
+    if (!w) return false;
+
+    m = { w->hwnd, record.msg, record.wParam, (LPARAM)record.detail };
+    switch (record.msg) {
+        case WM_DRAWITEM:
+        {
+            DRAWITEMSTRUCT& dis = r.drawItems.emplace_back();
+            dis.CtlType = record.detail >> 24;
+            dis.itemAction = (record.detail >> 16) & 0xFF;
+            dis.itemState = record.detail & 0xFFFF;
+            dis.hwndItem = r.anyButton;
+            dis.hDC = r.hdc;
+            dis.rcItem = { 0, 0, 75, 23 };
+            if (dis.CtlType == ODT_BUTTON && !dis.hwndItem) return false;
+            m.lParam = (LPARAM)&dis;
+            break;
+        }
+        case WM_UAHDRAWMENU:
+            if (!w->menu) return false;
+            m.lParam = (LPARAM)&r.menus.emplace_back(UAHMENU{ w->menu, r.hdc, 0x00000a00 });
+            break;
+        case WM_UAHDRAWMENUITEM:
+        {
+            if (!w->menu) return false;
+            const int position = record.detail >> 16;
+            UAHDRAWMENUITEM& item = r.menuItems.emplace_back();
+            item.dis.CtlType = ODT_MENU;
+            item.dis.itemState = record.detail & 0xFFFF;
+            item.dis.hDC = r.hdc;
+            item.dis.rcItem = { 8 + position * 70, 31, 8 + (position + 1) * 70, 50 };
+            item.um = { w->menu, r.hdc, 0x00000a00 };
+            item.umi.iPosition = position;
+            m.lParam = (LPARAM)&item;
+            break;
+        }
+        case WM_WINDOWPOSCHANGING:
+        case WM_WINDOWPOSCHANGED:
+            m.lParam = (LPARAM)&r.positions.emplace_back(WINDOWPOS{ w->hwnd, nullptr, 0, 0, 0, 0, record.detail });
+            break;
+        case WM_STYLECHANGING:
+        case WM_STYLECHANGED:
+            m.lParam = (LPARAM)&r.styles.emplace_back(STYLESTRUCT{ record.detail, record.detail });
+            break;
+        case WM_SETTEXT:
+            m.lParam = (LPARAM)r.texts.emplace_back(record.detail, L'x').c_str();
+            break;
+        case CB_GETCOMBOBOXINFO:
+            m.lParam = (LPARAM)&r.comboInfos.emplace_back(COMBOBOXINFO{ sizeof(COMBOBOXINFO) });
+            break;
+        case WM_SETFONT:
+            m.wParam = 0;   // the default font, the traced one is gone
+            break;
+        case WM_NCPAINT:
+            m.wParam = 1;   // the whole frame, regions are gone too
+            break;
+        case WM_SETCURSOR:
+            m.wParam = (WPARAM)MapWindow(r, record.wParam);
+            break;
+        case WM_ERASEBKGND:
+            m.wParam = (WPARAM)r.hdc;
+            break;
+        case WM_CTLCOLORMSGBOX:
+        case WM_CTLCOLOREDIT:
+        case WM_CTLCOLORLISTBOX:
+        case WM_CTLCOLORBTN:
+        case WM_CTLCOLORDLG:
+        case WM_CTLCOLORSCROLLBAR:
+        case WM_CTLCOLORSTATIC:
+            m.wParam = (WPARAM)r.hdc;
+            m.lParam = (LPARAM)(record.msg == WM_CTLCOLORLISTBOX && w->list ? w->list : MapWindow(r, record.detail));
+            break;
+        case WM_COMMAND:
+            m.lParam = (LPARAM)MapWindow(r, record.detail);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+void Prepare(replay& r, std::string_view trace) {
+    r.host = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW, L"Replay");
+    r.other = standin::CreateWindow(L"Static", r.host, WS_CHILD);
+    standin::ShowWindow(r.host);
+    standin::ShowWindow(r.other);
+    r.hdc = GetWindowDC(r.host);
+
+    const size_t count = (trace.size() - sizeof(trace_header)) / sizeof(trace_record);
+    for (size_t i = 0; i < count; i++) {
+        trace_record record;
+        memcpy(&record, trace.data() + sizeof(trace_header) + i * sizeof(trace_record), sizeof(record));
+
+        editor::replay_msg m;
+        if (IsLifetimeMessage(record.msg)) {
+            r.lifetime++;
+        }
+        else if (IsUnrebuildable(record.msg) || !Rebuild(r, record, m)) {
+            r.skipped++;
+        }
+        else {
+            r.messages.push_back(m);
+        }
+    }
+}
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long cycles;
+} msg_cost;
+
+void Run(const replay& r, int repeat, std::map<UINT, msg_cost>& costs, double& nsPerMessage) {
+    standin::ResetApiCalls();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++) {
+        for (const editor::replay_msg& m : r.messages) {
+            const ULONGLONG before = __rdtsc();
+            SendMessage(m.hwnd, m.msg, m.wParam, m.lParam);
+            msg_cost& cost = costs[m.msg];
+            cost.count++;
+            cost.cycles += __rdtsc() - before;
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    nsPerMessage = std::chrono::duration<double, std::nano>(elapsed).count() / std::max<size_t>(1, r.messages.size() * repeat);
+}
+
+void Report(const replay& r, int repeat, const std::map<UINT, msg_cost>& costs, double nsPerMessage) {
+    const unsigned long long sent = (unsigned long long)r.messages.size() * repeat;
+    printf("replayed %zu messages x %d, %zu skipped, %zu of window lifetimes left out, %.1f ns/message\n",
+        r.messages.size(), repeat, r.skipped, r.lifetime, nsPerMessage);
+    for (const auto& [msg, cost] : costs) {
+        char hex[16];
+        snprintf(hex, sizeof(hex), "0x%04x", msg);
+        const char* name = MessageName(msg);
+        printf("    %-24s %8llu %9.1f cycles/message\n", name ? name : hex, cost.count / repeat, (double)cost.cycles / cost.count);
+    }
+    for (const auto& [api, calls] : standin::ApiCallCounts()) {
+        // the replay's own sends and rdtsc reads don't count
+        const unsigned long long own = api == "SendMessage" ? sent : 0;
+        if (calls > own) printf("    %-24s %8.3f calls/message\n", api.c_str(), (double)(calls - own) / sent);
+    }
+}
+
+ULONGLONG Counter(StatCounter counter) {
+    dm_stats stats = { sizeof(stats) };
+    UnityEditorDarkMode_GetStats(&stats);
+    return stats.counters[(int)counter];
+}
+
+// the color setters a replay saves with the theme unchanged: those of every
+// paint of a tooltip, tree view or list view but its first
+unsigned long long ExpectedColorMessagesSaved(const replay& r, int repeat) {
+    std::map<HWND, WndKind> kinds;
+    for (const auto& [traced, w] : r.windows) kinds[w.hwnd] = w.kind;
+
+    std::set<HWND> painted;
+    unsigned long long saved = 0;
+    for (int i = 0; i < repeat; i++) {
+        for (const editor::replay_msg& m : r.messages) {
+            auto it = kinds.find(m.hwnd);
+            if (m.msg != WM_PAINT || it == kinds.end() || !ControlColorSetters(it->second)) continue;
+            if (!painted.insert(m.hwnd).second) saved += ControlColorSetters(it->second);
+        }
+    }
+    return saved;
+}
+
+// a trace of one frame of the editor session, recorded by the dll
+std::string RecordSession(const std::string& dir) {
+    const std::string path = dir + "/session.trace";
+    standin::SetEnv(L"UNITYEDITORDARKMODE_TRACE", standin::WindowsPath(path).c_str());
+    OpenMessageTrace();
+
+    editor::session s;
+    editor::CreateSession(s);
+    editor::FixComboList(s);
+    for (const editor::replay_msg& m : s.messages) SendMessage(m.hwnd, m.msg, m.wParam, m.lParam);
+
+    CloseMessageTrace();
+    standin::SetEnv(L"UNITYEDITORDARKMODE_TRACE", nullptr);
+    ReleaseDC(s.unity, s.hdc);
+    return path;
+}
+
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    int repeat = 200;
+    const char* tracePath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) quick = true;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else tracePath = argv[i];
+    }
+    if (quick) repeat = 2;
+
+    const std::string dir = editor::LoadDll();
+    const std::string trace = standin::ReadTextFile(tracePath ? tracePath : RecordSession(dir));
+
+    trace_header header = {};
+    if (trace.size() >= sizeof(header)) memcpy(&header, trace.data(), sizeof(header));
+    if (header.magic != 0x54444555 || header.version != TRACE_VERSION || header.recordSize != sizeof(trace_record)) {
+        fprintf(stderr, "not a version %lu message trace\n", (unsigned long)TRACE_VERSION);
+        return 1;
+    }
+
+    replay r;
+    Prepare(r, trace);
+    std::map<UINT, msg_cost> costs;
+    double nsPerMessage = 0;
+    const ULONGLONG savedBefore = Counter(StatCounter::ControlColorMessagesSaved);
+    Run(r, repeat, costs, nsPerMessage);
+    const ULONGLONG saved = Counter(StatCounter::ControlColorMessagesSaved) - savedBefore;
+    const unsigned long long expectedSaved = ExpectedColorMessagesSaved(r, repeat);
+    Report(r, repeat, costs, nsPerMessage);
+    printf("control color setters saved: %llu, %llu expected\n", (unsigned long long)saved, expectedSaved);
+
+    ReleaseDC(r.host, r.hdc);
+    if (!editor::UnloadDll()) {
+        fprintf(stderr, "unload failed\n");
+        return 1;
+    }
+
+    // the recorded session has nothing a replay can't rebuild
+    if (quick && !tracePath && (r.messages.empty() || r.skipped != 0)) {
+        fprintf(stderr, "the session trace didn't replay in full\n");
+        return 1;
+    }
+    if (quick && (saved != expectedSaved || (!tracePath && saved == 0))) {
+        fprintf(stderr, "control color setters were sent with the colors current\n");
+        return 1;
+    }
+    return 0;
+}
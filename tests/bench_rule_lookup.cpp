@@ -0,0 +1,126 @@
+// What finding a window's [rules] row costs once the table is full and the
+// editor has windows of many classes: GetRuleActions against the stand-in
+// user32, with the class atom looked up in cfg->ruleSlots, next to the
+// lookup by class name it replaced (a GetClassName and a compare per rule
+// class, every time, see BaselineRuleActions). --quick (what ctest runs)
+// fails unless both agree for every window and the atom lookups made no
+// GetClassName calls once every class had been seen.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "editor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// window classes: each rule class under two atoms and once more with a
+// versioned name, the rest up to ATOM_CACHE_SIZE / 2 without a rule
+constexpr int CLASSES = ATOM_CACHE_SIZE / 2;
+constexpr DWORD STYLES[] = { BS_PUSHBUTTON, BS_CHECKBOX, BS_GROUPBOX, BS_OWNERDRAW };
+
+// the lookup before the slot was cached per atom
+BYTE BaselineRuleActions(HWND hWnd, const theme_cfg* cfg) {
+    WCHAR buf[256];
+    const WCHAR* name = GetBaseClassName(hWnd, buf);
+    int slot = OTHER_RULE_SLOT;
+    for (int i = 0; i < cfg->rules.classCount; i++) {
+        if (_wcsicmp(cfg->rules.classes[i], name) == 0) {
+            slot = i;
+            break;
+        }
+    }
+    const DWORD style = (DWORD)GetWindowLongPtr(hWnd, GWL_STYLE);
+    return cfg->rules.actions[slot][style & BS_TYPEMASK];
+}
+
+// fills the rule table up with classes of the ini's own
+std::string RulesIni() {
+    auto cfg = std::make_unique<theme_cfg>();
+    SetDefaultThemeConfig(*cfg);
+    std::string ini = "[rules]\n";
+    for (int i = cfg->rules.classCount; i < MAX_RULE_CLASSES; i++) {
+        ini += "ToolWindow" + std::to_string(i) + (i % 2 ? " = subclass, darkmode\n" : ":checkbox = subclass, wstr\n");
+    }
+    return ini;
+}
+
+std::vector<HWND> CreateWindows(const rule_table& rules) {
+    std::vector<std::wstring> names;
+    for (int i = 0; i < rules.classCount; i++) {
+        names.push_back(rules.classes[i]);
+        names.push_back(rules.classes[i]);
+        names.push_back(std::wstring(L"6.0.0.0!") + rules.classes[i]);
+    }
+    for (int i = 0; (int)names.size() < CLASSES; i++) {
+        names.push_back(L"Foreign" + std::to_wstring(i));
+    }
+
+    std::vector<HWND> windows;
+    for (const std::wstring& name : names) {
+        const ATOM atom = standin::RegisterClass(name.c_str());
+        for (DWORD style : STYLES) {
+            windows.push_back(standin::CreateWindowOfClass(atom, nullptr, WS_OVERLAPPEDWINDOW | style));
+        }
+    }
+    return windows;
+}
+
+template <typename Lookup>
+double NsPerLookup(const std::vector<HWND>& windows, int rounds, Lookup lookup) {
+    volatile BYTE sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (HWND hWnd : windows) sink = sink + lookup(hWnd);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)rounds * windows.size());
+}
+
+}
+
+int main(int argc, char** argv) {
+    const bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    const int rounds = quick ? 20 : 2000;
+
+    editor::LoadDll(RulesIni());
+    bool agree = true;
+    unsigned long long names = 0;
+    {
+        theme_reader reader;
+        const theme_cfg* cfg = LoadThemeConfig();
+        const std::vector<HWND> windows = CreateWindows(cfg->rules);
+        printf("%d rule classes, %d window classes, %zu windows\n", cfg->rules.classCount, CLASSES, windows.size());
+
+        for (HWND hWnd : windows) agree &= GetRuleActions(hWnd, cfg) == BaselineRuleActions(hWnd, cfg);
+
+        const double lookups = (double)rounds * windows.size();
+        standin::ResetApiCalls();
+        const double baseline = NsPerLookup(windows, rounds, [cfg](HWND hWnd) { return BaselineRuleActions(hWnd, cfg); });
+        const double baselineNames = standin::ApiCalls("GetClassName") / lookups;
+
+        standin::ResetApiCalls();
+        const double current = NsPerLookup(windows, rounds, [cfg](HWND hWnd) { return GetRuleActions(hWnd, cfg); });
+        names = standin::ApiCalls("GetClassName");
+
+        printf("before   %9.1f ns/lookup %6.3f GetClassName/lookup\n", baseline, baselineNames);
+        printf("after    %9.1f ns/lookup %6.3f GetClassName/lookup\n", current, names / lookups);
+        printf("speedup  %.2fx\n", baseline / current);
+    }
+
+    if (!editor::UnloadDll()) {
+        fprintf(stderr, "unload failed\n");
+        return 1;
+    }
+    if (!agree) {
+        fprintf(stderr, "the atom lookup and the name lookup disagree\n");
+        return 1;
+    }
+    if (names != 0) {
+        fprintf(stderr, "rule lookups looked up class names\n");
+        return 1;
+    }
+    return 0;
+}
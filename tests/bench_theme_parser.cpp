@@ -0,0 +1,160 @@
+// Parser throughput: the ini from the README with a [rules] section, and the
+// same repeated into a large file, parsed over and over. Reports MB/s and the
+// time per parse, and counts heap allocations made while parsing, which
+// --quick (what ctest runs) requires to be none.
+#include "../UnityEditorDarkMode.cpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+namespace {
+
+std::atomic<unsigned long long> g_allocations = 0;
+
+const std::string_view g_typicalIni =
+    "; UnityEditorDarkMode theme\n"
+    "menubar_textcolor = 200,200,200\n"
+    "menubar_textcolor_disabled = 160,160,160\n"
+    "menubar_bgcolor = 48,48,48\n"
+    "menubaritem_bgcolor = menubar_bgcolor\n"
+    "menubaritem_bgcolor_hot = #3e3e3e\n"
+    "menubaritem_bgcolor_selected = menubaritem_bgcolor_hot\n"
+    "caption_color = 32,32,32\n"
+    "\n"
+    "[rules]\n"
+    "MyToolWindowClass = subclass, darkmode\n"
+    "Button:pushbutton = subclass, darkmode\n"
+    "\"#32770\" = subclass, darkmode\n"
+    "\n"
+    "[watchdog]\n"
+    "gdi_budget = 6000\n";
+
+typedef struct {
+    double nsPerParse;
+    double mbPerSecond;
+    unsigned long long allocations;
+    int errors;
+} bench_result;
+
+bench_result Run(std::string_view text, int parses) {
+    auto cfg = std::make_unique<theme_cfg>();
+    SetDefaultThemeConfig(*cfg);
+
+    bench_result result = {};
+    const unsigned long long allocations = g_allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < parses; i++) {
+        result.errors += ParseThemeConfig(text, *cfg).errorCount;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    result.allocations = g_allocations.load() - allocations;
+
+    const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    result.nsPerParse = ns / parses;
+    result.mbPerSecond = (double)text.size() * parses / ns * 1e3;
+    return result;
+}
+
+void Report(const char* name, size_t bytes, const bench_result& r) {
+    printf("%-8s %8zu bytes %10.1f ns/parse %8.1f MB/s %llu allocations\n",
+        name, bytes, r.nsPerParse, r.mbPerSecond, r.allocations);
+}
+
+}
+
+// every allocation and deallocation form is replaced, so that each pointer
+// goes back through the counterpart of what it came from. Neither side is
+// inlined: the compiler would otherwise pair the library's operator new with
+// the free() in our operator delete and warn about the mismatch.
+namespace {
+
+__attribute__((noinline)) void* CountedAlloc(size_t size, size_t alignment = 0) {
+    g_allocations++;
+    if (!size) size = 1;
+    if (!alignment) return malloc(size);
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+__attribute__((noinline)) void CountedFree(void* p) {
+    free(p);
+}
+
+}
+
+void* operator new(size_t size) {
+    if (void* p = CountedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    if (void* p = CountedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* p = CountedAlloc(size, (size_t)alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    if (void* p = CountedAlloc(size, (size_t)alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size, (size_t)alignment);
+}
+
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+int main(int argc, char** argv) {
+    const bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+    // the rules of a large ini replace the same classes over and over, the
+    // colors are last one wins; "[]" goes back to the top-level keys
+    std::string large;
+    while (large.size() < (1 << 20) - g_typicalIni.size() - 3) {
+        large += "[]\n";
+        large += g_typicalIni;
+    }
+
+    const bench_result typical = Run(g_typicalIni, quick ? 1000 : 200000);
+    Report("typical", g_typicalIni.size(), typical);
+    const bench_result big = Run(large, quick ? 2 : 50);
+    Report("1 MB", large.size(), big);
+
+    if (typical.errors != 0 || big.errors != 0) {
+        fprintf(stderr, "the benchmark inis failed to parse\n");
+        return 1;
+    }
+    if (typical.allocations != 0 || big.allocations != 0) {
+        fprintf(stderr, "parsing allocated\n");
+        return 1;
+    }
+    return 0;
+}
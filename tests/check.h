@@ -0,0 +1,63 @@
+// A minimal test registry for the Linux tests: TEST(name) { CHECK(...); }
+// registers a test, check::RunAll runs them in order and reports failures.
+// Tests in one executable share the dll's process-wide state, so they run
+// in declaration order and may build on each other.
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace check {
+
+struct test {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<test>& Tests() {
+    static std::vector<test> tests;
+    return tests;
+}
+
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct registrar {
+    registrar(const char* name, void (*run)()) { Tests().push_back({ name, run }); }
+};
+
+inline void Fail(const char* file, int line, const char* expr) {
+    fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+    Failures()++;
+}
+
+// runs every test, or only those named on the command line
+inline int RunAll(int argc, char** argv) {
+    int ran = 0;
+    for (const test& t : Tests()) {
+        bool selected = argc <= 1;
+        for (int i = 1; i < argc; i++) selected |= strcmp(argv[i], t.name) == 0;
+        if (!selected) continue;
+
+        const int before = Failures();
+        t.run();
+        printf("%s %s\n", Failures() == before ? "ok  " : "FAIL", t.name);
+        ran++;
+    }
+    printf("%d tests, %d failed checks\n", ran, Failures());
+    return Failures() ? 1 : 0;
+}
+
+}
+
+#define TEST(name) \
+    static void name(); \
+    static check::registrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(expr) \
+    do { if (!(expr)) check::Fail(__FILE__, __LINE__, #expr); } while (0)
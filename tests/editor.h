@@ -0,0 +1,38 @@
+// The test process as the editor: loads the dll the way Unity's loader does
+// and keeps its main thread's message loop going. Include after
+// UnityEditorDarkMode.cpp; the calling thread plays the editor's main thread.
+#pragma once
+
+#include "standin.h"
+
+#include <string>
+#include <string_view>
+
+namespace editor {
+
+// a fresh directory holding the dll, or dir if given, with the ini next to
+// it unless ini is empty; returns the directory
+inline std::string LoadDll(std::string_view ini = {}, std::string dir = {}) {
+    if (dir.empty()) dir = standin::MakeTempDir();
+    const std::string dll = dir + "/UnityEditorDarkMode.dll";
+    if (!ini.empty()) standin::WriteTextFile(dll + ".ini", ini);
+    standin::SetDllPath(dll);
+    standin::SetDllMain(DllMain);
+    DllMain(standin::DllModule(), DLL_PROCESS_ATTACH, nullptr);
+
+    // the init stages run from the first message loop iteration
+    standin::PumpMessages();
+    return dir;
+}
+
+inline bool UnloadDll() {
+    return UnityEditorDarkMode_Unload() != FALSE;
+}
+
+// the attached state of a window, null when the dll left it alone
+inline wnd_state* WindowState(HWND hWnd) {
+    DWORD_PTR refData = 0;
+    return GetWindowSubclass(hWnd, CallWndSubClassProc, 0, &refData) ? (wnd_state*)refData : nullptr;
+}
+
+}
@@ -0,0 +1,123 @@
+// Fuzz target for the ini parser. Built with clang and -DUEDM_FUZZ=ON it is
+// a libFuzzer target; otherwise main feeds it random mutations of a few seed
+// inis, which is what ctest runs. Every input must parse without crashing,
+// and every error reported must point into the input.
+#include "../UnityEditorDarkMode.cpp"
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+namespace {
+
+void Require(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "fuzz_theme_parser: %s\n", what);
+        abort();
+    }
+}
+
+size_t LineLength(std::string_view text, int line) {
+    for (int i = 1; i < line; i++) {
+        const size_t eol = text.find('\n');
+        if (eol == std::string_view::npos) return std::string_view::npos;
+        text.remove_prefix(eol + 1);
+    }
+    return text.substr(0, text.find('\n')).size();
+}
+
+void ParseOne(std::string_view text) {
+    auto cfg = std::make_unique<theme_cfg>();
+    SetDefaultThemeConfig(*cfg);
+    const theme_parse_result result = ParseThemeConfig(text, *cfg);
+
+    if (text.starts_with("\xEF\xBB\xBF")) text.remove_prefix(3);
+    Require(result.errorCount >= 0, "negative error count");
+    for (int i = 0; i < std::min(result.errorCount, (int)ARRAYSIZE(result.errors)); i++) {
+        const theme_parse_error& e = result.errors[i];
+        Require(e.message != nullptr, "error without a message");
+        const size_t length = LineLength(text, e.line);
+        Require(e.line >= 1 && length != std::string_view::npos, "error line outside the input");
+        Require(e.column >= 1 && (size_t)e.column <= length + 1, "error column outside the line");
+    }
+
+    const rule_table& rules = cfg->rules;
+    Require(rules.classCount >= 0 && rules.classCount <= MAX_RULE_CLASSES, "rule table overflow");
+    for (int i = 0; i < rules.classCount; i++) {
+        Require(wmemchr(rules.classes[i], 0, RULE_CLASS_NAME_LENGTH) != nullptr, "unterminated class name");
+    }
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    ParseOne(std::string_view((const char*)data, size));
+    return 0;
+}
+
+#ifndef UEDM_LIBFUZZER
+
+namespace {
+
+const std::string_view g_seeds[] = {
+    g_defaultRules,
+    "menubar_textcolor = 200,200,200\n"
+    "menubar_textcolor_disabled = 160,160,160\n"
+    "menubar_bgcolor = #303030\n"
+    "menubaritem_bgcolor = menubar_bgcolor\n"
+    "caption_color = menubaritem_bgcolor\n",
+    "\xEF\xBB\xBF; settings\r\n"
+    "[watchdog]\r\n"
+    "gdi_budget = 5000\r\n"
+    "[rules]\r\n"
+    "\"#32770\":pushbutton = subclass, darkmode\r\n",
+};
+
+// pieces of the syntax, so that mutations reach past the first error
+const std::string_view g_tokens[] = {
+    "=", ",", "#", ":", "\"", "[", "]", "\n", "\r\n", ";", " ", "\t", "\xEF\xBB\xBF",
+    "[rules]", "[watchdog]", "menubar_bgcolor", "border_color", "pushbutton", "subclass", "none",
+    "255", "256", "-1", "99999999999", "#ffffff",
+};
+
+std::string Mutate(std::mt19937& rng, std::string text) {
+    const int edits = 1 + rng() % 8;
+    for (int i = 0; i < edits; i++) {
+        const size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+        switch (rng() % 5) {
+            case 0:
+                if (at < text.size()) text[at] = (char)rng();
+                break;
+            case 1:
+                if (at < text.size()) text.erase(at, 1 + rng() % 16);
+                break;
+            case 2:
+                text.insert(at, g_tokens[rng() % ARRAYSIZE(g_tokens)]);
+                break;
+            case 3:
+                text.insert(at, std::string(g_seeds[rng() % ARRAYSIZE(g_seeds)]));
+                break;
+            default:
+                text.insert(at, 1 + rng() % 300, (char)rng());
+                break;
+        }
+    }
+    return text;
+}
+
+}
+
+// fuzz_theme_parser [iterations] [seed]
+int main(int argc, char** argv) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 100000;
+    std::mt19937 rng(argc > 2 ? (unsigned)atol(argv[2]) : 1);
+
+    for (std::string_view seed : g_seeds) ParseOne(seed);
+    for (long i = 0; i < iterations; i++) {
+        ParseOne(Mutate(rng, std::string(g_seeds[rng() % ARRAYSIZE(g_seeds)])));
+    }
+    printf("%ld inputs parsed\n", iterations);
+    return 0;
+}
+
+#endif
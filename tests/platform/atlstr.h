@@ -0,0 +1,19 @@
+// Part of the stand-in SDK: the few members of ATL's CStringW the dll uses
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+
+class CStringW {
+public:
+    CStringW() = default;
+    CStringW(const wchar_t* s) : str(s ? s : L"") {}
+
+    void Append(const wchar_t* s) { str.append(s); }
+    const wchar_t* GetString() const { return str.c_str(); }
+    operator const wchar_t*() const { return str.c_str(); }
+
+private:
+    std::wstring str;
+};
@@ -0,0 +1,14 @@
+// Part of the stand-in SDK: the time stamp counter where there is one,
+// otherwise a nanosecond clock, which the cycle budgets treat the same
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+
+inline unsigned long long __rdtsc() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
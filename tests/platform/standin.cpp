@@ -0,0 +1,1937 @@
+// Simulated kernel32, user32, gdi32, comctl32, uxtheme and dwmapi for the
+// tests, see standin.h. Just enough of each to run the dll's code paths with
+// the same rules as on Windows where they matter to it: subclassing and
+// thread hooks only work on the caller's own thread, thread timers and
+// posted messages are delivered by the owning thread's message loop, named
+// sections are shared within the process and views honor their access.
+#include "standin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STANDIN_API() \
+    static standin::api_counter api_counter_(__func__); \
+    api_counter_.calls.fetch_add(1, std::memory_order_relaxed)
+
+// for the APIs a test may make fail, see standin::FailApi
+#define STANDIN_FAIL_IF_ASKED(result) \
+    if (IsFailing(__func__)) return result
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+std::mutex g_lock;                  // everything below that isn't atomic
+std::condition_variable g_changed;  // any object became signaled or a message was posted
+
+struct hook_rec {
+    int idHook;
+    HOOKPROC proc;
+    DWORD threadId;
+    bool removed;
+};
+
+struct timer_rec {
+    UINT_PTR id;
+    UINT elapse;
+    TIMERPROC proc;
+    clock::time_point due;
+};
+
+struct thread_rec {
+    DWORD id;
+    bool exited = false;
+    bool gui = false;   // called into USER
+    std::deque<MSG> queue;
+    std::vector<hook_rec*> hooks;   // newest last
+    std::vector<timer_rec> timers;
+};
+
+std::map<DWORD, std::shared_ptr<thread_rec>> g_threads;
+std::atomic<DWORD> g_nextThreadId = 0x1000;
+thread_local std::shared_ptr<thread_rec> t_self;
+thread_local DWORD t_lastError = 0;
+
+thread_rec& Self() {
+    if (!t_self) {
+        auto rec = std::make_shared<thread_rec>();
+        rec->id = g_nextThreadId.fetch_add(4);
+        std::lock_guard lock(g_lock);
+        g_threads[rec->id] = rec;
+        t_self = rec;
+    }
+    return *t_self;
+}
+
+// caller holds g_lock
+thread_rec* FindThread(DWORD threadId) {
+    auto it = g_threads.find(threadId);
+    return it == g_threads.end() || it->second->exited ? nullptr : it->second.get();
+}
+
+struct window_rec;
+
+struct subclass_rec {
+    SUBCLASSPROC proc;
+    UINT_PTR id;
+    DWORD_PTR refData;
+};
+
+struct class_rec {
+    ATOM atom;
+    std::wstring name;
+    HINSTANCE owner;
+};
+
+struct window_rec {
+    HWND hwnd;
+    DWORD threadId;
+    DWORD processId = 0;    // set for another process's window, see CreateForeignWindow
+    ATOM atom;
+    std::wstring className;
+    HWND parent;
+    std::vector<HWND> children;
+    LONG_PTR style;
+    std::wstring text;
+    HFONT font = nullptr;
+    HMENU menu = nullptr;
+    HWND comboList = nullptr;
+    RECT rect;          // screen coordinates
+    POINT clientOrigin; // relative to rect
+    SIZE clientSize;
+    UINT dpi = USER_DEFAULT_SCREEN_DPI;
+    std::vector<subclass_rec> subclasses;  // innermost first
+    standin::window_proc proc;
+    std::map<DWORD, DWORD> dwm;
+    std::map<UINT, COLORREF> colors;
+    bool themed = false;
+    int invalidations = 0;
+    bool tracksLeave = false;   // TrackMouseEvent(TME_LEAVE) until the mouse leaves
+    std::atomic<bool> alive = true;
+};
+
+constexpr size_t MAX_WINDOWS = 1 << 16;
+std::atomic<window_rec*> g_windows[MAX_WINDOWS];
+std::atomic<size_t> g_windowCount = 0;
+std::vector<class_rec> g_classes = { { 0x8002, L"#32770", nullptr } };
+ATOM g_nextAtom = 0xC000;
+
+window_rec* FindWindow(HWND hWnd) {
+    const size_t index = ((UINT_PTR)hWnd >> 4) - 1;
+    if (!hWnd || ((UINT_PTR)hWnd & 0xF) || index >= MAX_WINDOWS) return nullptr;
+    window_rec* w = g_windows[index].load(std::memory_order_acquire);
+    return w && w->alive.load(std::memory_order_acquire) ? w : nullptr;
+}
+
+// subclass procs running on this thread, for DefSubclassProc
+struct subclass_frame {
+    window_rec* window;
+    int index;
+};
+thread_local std::vector<subclass_frame> t_frames;
+
+LRESULT CallSubclass(window_rec* w, int index, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    index = std::min(index, (int)w->subclasses.size() - 1);
+    if (index < 0) {
+        return w->proc ? w->proc(w->hwnd, uMsg, wParam, lParam) : standin::DefaultWindowProc(w->hwnd, uMsg, wParam, lParam);
+    }
+    const subclass_rec subclass = w->subclasses[index];
+    t_frames.push_back({ w, index });
+    const LRESULT lr = subclass.proc(w->hwnd, uMsg, wParam, lParam, subclass.id, subclass.refData);
+    t_frames.pop_back();
+    return lr;
+}
+
+LRESULT Deliver(window_rec* w, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    return CallSubclass(w, (int)w->subclasses.size() - 1, uMsg, wParam, lParam);
+}
+
+// the thread's hooks of one type, newest first; every hook is called, as if
+// each one passed the call on with CallNextHookEx
+LRESULT CallHooks(DWORD threadId, int idHook, int nCode, WPARAM wParam, LPARAM lParam) {
+    std::vector<hook_rec*> hooks;
+    {
+        std::lock_guard lock(g_lock);
+        thread_rec* thread = FindThread(threadId);
+        if (!thread) return 0;
+        for (auto it = thread->hooks.rbegin(); it != thread->hooks.rend(); ++it) {
+            if ((*it)->idHook == idHook && !(*it)->removed) hooks.push_back(*it);
+        }
+    }
+    LRESULT lr = 0;
+    for (hook_rec* hook : hooks) {
+        if (!hook->removed) lr |= hook->proc(nCode, wParam, lParam);
+    }
+    return lr;
+}
+
+// gdi objects, theme data and menus; handle values don't overlap windows'
+enum class gdi_kind { Brush, Pen, Font, Bitmap, DC, WindowDC, Theme };
+std::unordered_map<UINT_PTR, gdi_kind> g_gdiObjects;
+std::unordered_map<UINT_PTR, std::map<gdi_kind, HGDIOBJ>> g_selected;
+UINT_PTR g_nextGdi = 0x10000000;
+std::atomic<LONG> g_liveGdi = 0;
+std::atomic<LONG> g_liveThemes = 0;
+standin::gdi_counts g_gdiCounts = {};
+DWORD g_gdiBase = 0;
+DWORD g_userBase = 0;
+
+void* NewGdiObject(gdi_kind kind) {
+    std::lock_guard lock(g_lock);
+    const UINT_PTR handle = g_nextGdi += 4;
+    g_gdiObjects[handle] = kind;
+    g_gdiCounts.created++;
+    (kind == gdi_kind::Theme ? g_liveThemes : g_liveGdi)++;
+    return (void*)handle;
+}
+
+bool DeleteGdiObject(const void* handle, std::initializer_list<gdi_kind> kinds) {
+    std::lock_guard lock(g_lock);
+    auto it = g_gdiObjects.find((UINT_PTR)handle);
+    if (it == g_gdiObjects.end() || std::find(kinds.begin(), kinds.end(), it->second) == kinds.end()) {
+        if (handle) g_gdiCounts.badDeletes++;
+        return false;
+    }
+    g_gdiCounts.deleted++;
+    (it->second == gdi_kind::Theme ? g_liveThemes : g_liveGdi)--;
+    g_selected.erase(it->first);
+    g_gdiObjects.erase(it);
+    return true;
+}
+
+std::map<UINT_PTR, std::vector<std::wstring>> g_menus;
+UINT_PTR g_nextMenu = 0x30000000;
+
+// kernel objects
+struct section {
+    int fd;
+    size_t size;
+    std::wstring name;
+
+    section(int fd, size_t size, std::wstring name) : fd(fd), size(size), name(std::move(name)) {}
+    section(const section&) = delete;
+    section& operator=(const section&) = delete;
+    ~section() { close(fd); }
+};
+
+struct kobject {
+    enum kind_t { File, Event, Thread, Mapping, Change, Snapshot } kind;
+    bool manualReset = false;
+    bool signaled = false;          // events and change notifications
+    std::shared_ptr<thread_rec> thread;
+    int fd = -1;
+    bool written = false;
+    std::string path;               // files, and the directory of a change notification
+    std::shared_ptr<section> mapping;
+    std::vector<DWORD> threads;     // snapshot
+    size_t next = 0;
+};
+
+std::unordered_map<UINT_PTR, std::shared_ptr<kobject>> g_handles;
+UINT_PTR g_nextHandle = 0x20000000;
+std::map<std::wstring, std::weak_ptr<section>> g_sections;
+std::unordered_map<const void*, std::pair<size_t, std::shared_ptr<section>>> g_views;
+
+HANDLE NewHandle(std::shared_ptr<kobject> object) {
+    std::lock_guard lock(g_lock);
+    const UINT_PTR handle = g_nextHandle += 4;
+    g_handles[handle] = std::move(object);
+    return (HANDLE)handle;
+}
+
+std::shared_ptr<kobject> FindHandle(HANDLE handle) {
+    std::lock_guard lock(g_lock);
+    auto it = g_handles.find((UINT_PTR)handle);
+    return it == g_handles.end() ? nullptr : it->second;
+}
+
+// caller holds g_lock
+bool IsSignaled(kobject& object) {
+    switch (object.kind) {
+        case kobject::Event:
+        case kobject::Change:
+            return object.signaled;
+        case kobject::Thread:
+            return object.thread->exited;
+        default:
+            return false;
+    }
+}
+
+std::string Directory(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// caller holds g_lock
+void SignalChange(const std::string& path) {
+    const std::string dir = Directory(path);
+    for (auto& [handle, object] : g_handles) {
+        if (object->kind == kobject::Change && object->path == dir) object->signaled = true;
+    }
+    g_changed.notify_all();
+}
+
+std::string NarrowPath(LPCWSTR path) {
+    std::string narrow;
+    for (const WCHAR* p = path; *p; p++) narrow += *p == L'\\' ? '/' : (char)*p;
+    return narrow;
+}
+
+FILETIME ToFileTime(const timespec& ts) {
+    const ULONGLONG t = (ULONGLONG)ts.tv_sec * 10000000 + ts.tv_nsec / 100 + 116444736000000000ull;
+    return { (DWORD)t, (DWORD)(t >> 32) };
+}
+
+// modules
+const HMODULE g_dllModule = (HMODULE)0x180000000ull;
+const HMODULE g_exeModule = (HMODULE)0x140000000ull;
+const HMODULE g_ntdll = (HMODULE)0x7ff800000000ull;
+const HMODULE g_uxtheme = (HMODULE)0x7ff810000000ull;
+const HMODULE g_user32 = (HMODULE)0x7ff820000000ull;
+standin::dll_main g_dllMain = nullptr;
+std::wstring g_dllPath = L"C:\\Unity\\UnityEditorDarkMode.dll";
+std::map<HMODULE, std::vector<std::pair<std::string, FARPROC>>> g_modules;
+std::set<std::string> g_missingExports;   // "module!name" or "module!#ordinal"
+std::map<HMODULE, LONG> g_moduleRefs;
+
+DWORD g_osBuild = 22631;
+std::atomic<int> g_appMode = 0;
+std::atomic<int> g_menuThemeFlushes = 0;
+std::map<std::wstring, std::wstring> g_env;
+std::atomic<ULONGLONG> g_tickOffset = 0;
+std::atomic<LONGLONG> g_counterStep = 0;   // ns, see SetPerformanceCounterStep
+std::atomic<LONGLONG> g_counterSteps = 0;
+std::vector<std::wstring> g_debugLog;
+
+// counters register on their API's first call, which may be made with
+// g_lock held
+std::mutex g_counterLock;
+
+std::vector<standin::api_counter*>& Counters() {
+    static std::vector<standin::api_counter*> counters;
+    return counters;
+}
+
+std::set<std::string, std::less<>> g_failingApis; // under g_counterLock
+
+bool IsFailing(std::string_view name) {
+    std::lock_guard lock(g_counterLock);
+    return g_failingApis.find(name) != g_failingApis.end();
+}
+
+// thrown by FreeLibraryAndExitThread, caught where the thread started
+struct thread_exit {};
+
+void ExitCurrentThread() {
+    if (g_dllMain) g_dllMain(g_dllModule, DLL_THREAD_DETACH, nullptr);
+
+    std::lock_guard lock(g_lock);
+    thread_rec& self = *t_self;
+    self.exited = true;
+    for (hook_rec* hook : self.hooks) hook->removed = true;
+    self.hooks.clear();
+    self.timers.clear();
+    self.queue.clear();
+    const size_t count = g_windowCount;
+    for (size_t i = 0; i < count; i++) {
+        window_rec* w = g_windows[i];
+        if (w && w->threadId == self.id) w->alive = false;
+    }
+    g_changed.notify_all();
+}
+
+void RunThread(const std::shared_ptr<thread_rec>& rec, const std::function<void()>& body) {
+    t_self = rec;
+    if (g_dllMain) g_dllMain(g_dllModule, DLL_THREAD_ATTACH, nullptr);
+    try {
+        body();
+    }
+    catch (const thread_exit&) {
+    }
+    ExitCurrentThread();
+}
+
+std::shared_ptr<thread_rec> NewThread() {
+    auto rec = std::make_shared<thread_rec>();
+    rec->id = g_nextThreadId.fetch_add(4);
+    std::lock_guard lock(g_lock);
+    g_threads[rec->id] = rec;
+    return rec;
+}
+
+// STANDIN_API counters of the stand-ins handed out by GetProcAddress
+LONG WINAPI StandinRtlGetVersion(RTL_OSVERSIONINFOW* info) {
+    STANDIN_API();
+    info->dwMajorVersion = 10;
+    info->dwMinorVersion = 0;
+    info->dwBuildNumber = g_osBuild;
+    return 0;
+}
+
+int WINAPI StandinSetPreferredAppMode(int mode) {
+    STANDIN_API();
+    return g_appMode.exchange(mode);
+}
+
+void WINAPI StandinFlushMenuThemes() {
+    STANDIN_API();
+    g_menuThemeFlushes++;
+}
+
+HTHEME WINAPI StandinOpenThemeDataForDpi(HWND hwnd, LPCWSTR pszClassList, UINT dpi) {
+    STANDIN_API();
+    return NewGdiObject(gdi_kind::Theme);
+}
+
+
+}
+
+// standin.h
+namespace standin {
+
+api_counter::api_counter(const char* name) : name(name), calls(0) {
+    std::lock_guard lock(g_counterLock);
+    Counters().push_back(this);
+}
+
+unsigned long long ApiCalls(std::string_view name) {
+    std::lock_guard lock(g_counterLock);
+    unsigned long long calls = 0;
+    for (api_counter* counter : Counters()) {
+        if (counter->name == name) calls += counter->calls;
+    }
+    return calls;
+}
+
+std::vector<std::pair<std::string, unsigned long long>> ApiCallCounts() {
+    std::map<std::string, unsigned long long> sums;
+    {
+        std::lock_guard lock(g_counterLock);
+        for (api_counter* counter : Counters()) {
+            if (counter->calls) sums[counter->name] += counter->calls;
+        }
+    }
+    return { sums.begin(), sums.end() };
+}
+
+void ResetApiCalls() {
+    std::lock_guard lock(g_counterLock);
+    for (api_counter* counter : Counters()) counter->calls = 0;
+}
+
+void FailApi(std::string_view name, bool fail) {
+    std::lock_guard lock(g_counterLock);
+    const auto it = g_failingApis.find(name);
+    if (fail && it == g_failingApis.end()) g_failingApis.emplace(name);
+    else if (!fail && it != g_failingApis.end()) g_failingApis.erase(it);
+}
+
+HMODULE DllModule() {
+    return g_dllModule;
+}
+
+void SetDllMain(dll_main entry) {
+    g_dllMain = entry;
+}
+
+void SetDllPath(const std::string& path) {
+    g_dllPath = WindowsPath(path);
+}
+
+void RegisterModule(HMODULE module, std::vector<std::pair<std::string, FARPROC>> exports) {
+    std::lock_guard lock(g_lock);
+    g_modules[module] = std::move(exports);
+}
+
+void UnregisterModule(HMODULE module) {
+    std::lock_guard lock(g_lock);
+    g_modules.erase(module);
+}
+
+void SetSystemExport(std::string_view module, std::string_view name, bool present) {
+    std::lock_guard lock(g_lock);
+    const std::string key = std::string(module) + "!" + std::string(name);
+    if (present) g_missingExports.erase(key);
+    else g_missingExports.insert(key);
+}
+
+LONG ModuleReferences(HMODULE module) {
+    std::lock_guard lock(g_lock);
+    return g_moduleRefs[module];
+}
+
+void SetOsBuild(DWORD build) {
+    g_osBuild = build;
+}
+
+int AppMode() {
+    return g_appMode;
+}
+
+int MenuThemeFlushes() {
+    return g_menuThemeFlushes;
+}
+
+void SetEnv(const wchar_t* name, const wchar_t* value) {
+    std::lock_guard lock(g_lock);
+    if (value) g_env[name] = value;
+    else g_env.erase(name);
+}
+
+void AdvanceTicks(ULONGLONG ms) {
+    g_tickOffset += ms;
+}
+
+void SetPerformanceCounterStep(double ms) {
+    g_counterStep = (LONGLONG)(ms * 1000000);
+}
+
+void SetGuiResourceBase(DWORD gdi, DWORD user) {
+    std::lock_guard lock(g_lock);
+    g_gdiBase = gdi;
+    g_userBase = user;
+}
+
+LONG LiveGdiObjects() {
+    return g_liveGdi;
+}
+
+bool IsLiveGdiObject(HGDIOBJ handle) {
+    std::lock_guard lock(g_lock);
+    return g_gdiObjects.count((UINT_PTR)handle) != 0;
+}
+
+LONG LiveThemeHandles() {
+    return g_liveThemes;
+}
+
+gdi_counts GdiCounts() {
+    std::lock_guard lock(g_lock);
+    return g_gdiCounts;
+}
+
+std::vector<std::wstring> DebugLog() {
+    std::lock_guard lock(g_lock);
+    return g_debugLog;
+}
+
+void ClearDebugLog() {
+    std::lock_guard lock(g_lock);
+    g_debugLog.clear();
+}
+
+std::string MakeTempDir() {
+    char dir[] = "/tmp/uedm.XXXXXX";
+    return mkdtemp(dir) ? dir : "";
+}
+
+void WriteTextFile(const std::string& path, std::string_view text) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return;
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+    std::lock_guard lock(g_lock);
+    SignalChange(path);
+}
+
+std::string ReadTextFile(const std::string& path) {
+    std::string text;
+    if (FILE* f = fopen(path.c_str(), "rb")) {
+        char buf[4096];
+        for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) text.append(buf, n);
+        fclose(f);
+    }
+    return text;
+}
+
+std::wstring WindowsPath(const std::string& path) {
+    std::wstring wide;
+    for (char c : path) wide += c == '/' ? L'\\' : (WCHAR)(unsigned char)c;
+    return wide;
+}
+
+struct thread::state {
+    std::thread thread;
+};
+
+thread::thread(std::function<void()> body) : impl(new state) {
+    auto rec = NewThread();
+    threadId = rec->id;
+    impl->thread = std::thread([rec, body = std::move(body)] { RunThread(rec, body); });
+}
+
+thread::~thread() {
+    join();
+    delete impl;
+}
+
+void thread::join() {
+    if (impl->thread.joinable()) impl->thread.join();
+}
+
+size_t PumpMessages() {
+    thread_rec& self = Self();
+    size_t handled = 0;
+    for (;;) {
+        MSG msg = {};
+        {
+            std::lock_guard lock(g_lock);
+            self.gui = true;
+            if (!self.queue.empty()) {
+                msg = self.queue.front();
+                self.queue.pop_front();
+            }
+            else {
+                const auto now = clock::now();
+                auto due = std::find_if(self.timers.begin(), self.timers.end(), [now](const timer_rec& t) { return t.due <= now; });
+                if (due == self.timers.end()) break;
+                due->due = now + std::chrono::milliseconds(due->elapse);
+                msg = { nullptr, WM_TIMER, due->id, (LPARAM)due->proc };
+            }
+        }
+
+        CallHooks(self.id, WH_GETMESSAGE, HC_ACTION, PM_REMOVE, (LPARAM)&msg);
+        if (msg.message == WM_TIMER && msg.lParam) {
+            ((TIMERPROC)msg.lParam)(msg.hwnd, WM_TIMER, msg.wParam, (DWORD)GetTickCount64());
+        }
+        else if (window_rec* w = FindWindow(msg.hwnd)) {
+            Deliver(w, msg.message, msg.wParam, msg.lParam);
+        }
+        handled++;
+    }
+    return handled;
+}
+
+bool PumpUntil(const std::function<bool()>& done, DWORD timeoutMs) {
+    const auto deadline = clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        PumpMessages();
+        if (done()) return true;
+        if (clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+size_t QueuedMessages(DWORD threadId) {
+    std::lock_guard lock(g_lock);
+    thread_rec* thread = FindThread(threadId);
+    return thread ? thread->queue.size() : 0;
+}
+
+int HookCount(DWORD threadId, int idHook) {
+    std::lock_guard lock(g_lock);
+    thread_rec* thread = FindThread(threadId);
+    if (!thread) return 0;
+    return (int)std::count_if(thread->hooks.begin(), thread->hooks.end(),
+        [idHook](const hook_rec* hook) { return hook->idHook == idHook && !hook->removed; });
+}
+
+ATOM RegisterClass(const wchar_t* name, HINSTANCE owner) {
+    std::lock_guard lock(g_lock);
+    const ATOM atom = g_nextAtom++;
+    g_classes.push_back({ atom, name, owner });
+    return atom;
+}
+
+HWND CreateWindowOfClass(ATOM atom, HWND parent, DWORD style, const wchar_t* text) {
+    thread_rec& self = Self();
+    auto* w = new window_rec{};
+    {
+        std::lock_guard lock(g_lock);
+        self.gui = true;
+        auto cls = std::find_if(g_classes.begin(), g_classes.end(), [atom](const class_rec& c) { return c.atom == atom; });
+        if (cls == g_classes.end()) {
+            delete w;
+            return nullptr;
+        }
+        const size_t index = g_windowCount++;
+        w->hwnd = (HWND)((index + 1) << 4);
+        w->threadId = self.id;
+        w->atom = atom;
+        w->className = cls->name;
+        w->parent = parent;
+        w->style = style;
+        w->text = text;
+        if (parent) {
+            w->rect = { 10, 10, 110, 40 };
+            w->clientOrigin = { 0, 0 };
+            w->clientSize = { 100, 30 };
+        }
+        else {
+            w->rect = { 100, 100, 900, 700 };
+            w->clientOrigin = { 8, 59 };
+            w->clientSize = { 784, 533 };
+        }
+        if (window_rec* p = FindWindow(parent)) p->children.push_back(w->hwnd);
+        g_windows[index].store(w, std::memory_order_release);
+    }
+    if (_wcsicmp(w->className.c_str(), L"ComboBox") == 0) {
+        w->comboList = CreateWindow(L"ComboLBox", nullptr, WS_POPUP);
+    }
+
+    CREATESTRUCT cs = {};
+    cs.hwndParent = parent;
+    cs.style = (LONG)style;
+    cs.lpszName = text;
+    cs.lpszClass = w->className.c_str();
+    CBT_CREATEWND cbt = { &cs, nullptr };
+    CallHooks(self.id, WH_CBT, HCBT_CREATEWND, (WPARAM)w->hwnd, (LPARAM)&cbt);
+    Deliver(w, WM_NCCREATE, 0, (LPARAM)&cs);
+    Deliver(w, WM_CREATE, 0, (LPARAM)&cs);
+    return w->hwnd;
+}
+
+HWND CreateWindow(const wchar_t* className, HWND parent, DWORD style, const wchar_t* text) {
+    ATOM atom = 0;
+    {
+        std::lock_guard lock(g_lock);
+        for (const class_rec& cls : g_classes) {
+            if (_wcsicmp(cls.name.c_str(), className) == 0) {
+                atom = cls.atom;
+                break;
+            }
+        }
+    }
+    return CreateWindowOfClass(atom ? atom : RegisterClass(className), parent, style, text);
+}
+
+HWND CreateForeignWindow(DWORD processId, DWORD threadId, HWND parent) {
+    std::lock_guard lock(g_lock);
+    const size_t index = g_windowCount++;
+    auto* w = new window_rec{};
+    w->hwnd = (HWND)((index + 1) << 4);
+    w->threadId = threadId;
+    w->processId = processId;
+    w->className = parent ? L"Static" : L"ForeignWindowClass";
+    w->parent = parent;
+    w->style = parent ? WS_CHILD : WS_OVERLAPPEDWINDOW;
+    w->rect = parent ? RECT{ 10, 10, 110, 40 } : RECT{ 100, 100, 900, 700 };
+    if (window_rec* p = FindWindow(parent)) p->children.push_back(w->hwnd);
+    g_windows[index].store(w, std::memory_order_release);
+    return w->hwnd;
+}
+
+void ShowWindow(HWND hWnd) {
+    window_rec* w = FindWindow(hWnd);
+    if (!w || (w->style & WS_VISIBLE)) return;
+
+    Deliver(w, WM_SHOWWINDOW, TRUE, 0);
+    WINDOWPOS pos = { hWnd, nullptr, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_SHOWWINDOW };
+    Deliver(w, WM_WINDOWPOSCHANGING, 0, (LPARAM)&pos);
+    w->style |= WS_VISIBLE;
+    Deliver(w, WM_WINDOWPOSCHANGED, 0, (LPARAM)&pos);
+}
+
+void DestroyWindow(HWND hWnd) {
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return;
+
+    CallHooks(w->threadId, WH_CBT, HCBT_DESTROYWND, (WPARAM)hWnd, 0);
+    Deliver(w, WM_DESTROY, 0, 0);
+    for (HWND child : std::vector<HWND>(w->children)) DestroyWindow(child);
+    if (w->comboList) DestroyWindow(w->comboList);
+    Deliver(w, WM_NCDESTROY, 0, 0);
+
+    std::lock_guard lock(g_lock);
+    w->alive = false;
+    if (window_rec* p = FindWindow(w->parent)) std::erase(p->children, hWnd);
+}
+
+void SetWindowDpi(HWND hWnd, UINT dpi) {
+    if (window_rec* w = FindWindow(hWnd)) w->dpi = dpi;
+}
+
+void SetWindowRect(HWND hWnd, RECT rect) {
+    if (window_rec* w = FindWindow(hWnd)) w->rect = rect;
+}
+
+void SetWindowFont(HWND hWnd, HFONT font) {
+    if (window_rec* w = FindWindow(hWnd)) w->font = font;
+}
+
+void SetWindowProc(HWND hWnd, window_proc proc) {
+    if (window_rec* w = FindWindow(hWnd)) w->proc = std::move(proc);
+}
+
+LRESULT DefaultWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return 0;
+
+    switch (uMsg) {
+        case WM_NCCREATE:
+            return TRUE;
+        case WM_SETTEXT:
+            w->text = (LPCWSTR)lParam;
+            return TRUE;
+        case WM_GETTEXTLENGTH:
+            return (LRESULT)w->text.size();
+        case WM_GETFONT:
+            return (LRESULT)w->font;
+        case WM_SETFONT:
+            w->font = (HFONT)wParam;
+            return 0;
+        case CB_GETCOMBOBOXINFO:
+            ((COMBOBOXINFO*)lParam)->hwndList = w->comboList;
+            return TRUE;
+        case TTM_SETTIPBKCOLOR:
+        case TTM_SETTIPTEXTCOLOR:
+            w->colors[uMsg] = (COLORREF)wParam;
+            return 0;
+        case TVM_SETBKCOLOR:
+        case TVM_SETTEXTCOLOR:
+        case LVM_SETBKCOLOR:
+        case LVM_SETTEXTCOLOR:
+        case LVM_SETTEXTBKCOLOR:
+            w->colors[uMsg] = (COLORREF)lParam;
+            return TRUE;
+        default:
+            return 0;
+    }
+}
+
+int SubclassCount(HWND hWnd) {
+    window_rec* w = FindWindow(hWnd);
+    return w ? (int)w->subclasses.size() : 0;
+}
+
+HMENU CreateMenu(std::vector<std::wstring> labels) {
+    std::lock_guard lock(g_lock);
+    const UINT_PTR menu = g_nextMenu += 4;
+    g_menus[menu] = std::move(labels);
+    return (HMENU)menu;
+}
+
+void SetMenu(HWND hWnd, HMENU menu) {
+    if (window_rec* w = FindWindow(hWnd)) w->menu = menu;
+}
+
+void SetMenuItemText(HMENU menu, int position, const std::wstring& label) {
+    std::lock_guard lock(g_lock);
+    std::vector<std::wstring>& labels = g_menus[(UINT_PTR)menu];
+    if ((size_t)position >= labels.size()) labels.resize(position + 1);
+    labels[position] = label;
+}
+
+void RemoveMenuItem(HMENU menu, int position) {
+    std::lock_guard lock(g_lock);
+    std::vector<std::wstring>& labels = g_menus[(UINT_PTR)menu];
+    if ((size_t)position < labels.size()) labels.erase(labels.begin() + position);
+}
+
+bool GetDwmAttribute(HWND hWnd, DWORD attribute, DWORD& value) {
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return false;
+    std::lock_guard lock(g_lock);
+    auto it = w->dwm.find(attribute);
+    if (it == w->dwm.end()) return false;
+    value = it->second;
+    return true;
+}
+
+bool HasWindowTheme(HWND hWnd) {
+    window_rec* w = FindWindow(hWnd);
+    return w && w->themed;
+}
+
+int Invalidations(HWND hWnd) {
+    window_rec* w = FindWindow(hWnd);
+    return w ? w->invalidations : 0;
+}
+
+void MouseLeave(HWND hWnd) {
+    window_rec* w = FindWindow(hWnd);
+    if (!w || !w->tracksLeave) return;
+    w->tracksLeave = false;
+    Deliver(w, WM_MOUSELEAVE, 0, 0);
+}
+
+COLORREF ControlColor(HWND hWnd, UINT setter) {
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return CLR_INVALID;
+    auto it = w->colors.find(setter);
+    return it == w->colors.end() ? CLR_INVALID : it->second;
+}
+
+}
+
+// user32
+ATOM GetClassLongPtr(HWND hWnd, int nIndex) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    return w && nIndex == GCW_ATOM ? w->atom : 0;
+}
+
+int GetClassName(HWND hWnd, LPWSTR lpClassName, int nMaxCount) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || nMaxCount <= 0) return 0;
+    const int length = std::min((int)w->className.size(), nMaxCount - 1);
+    wmemcpy(lpClassName, w->className.c_str(), length);
+    lpClassName[length] = 0;
+    return length;
+}
+
+LONG_PTR GetWindowLongPtr(HWND hWnd, int nIndex) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    return w && nIndex == GWL_STYLE ? w->style : 0;
+}
+
+LONG_PTR SetWindowLongPtr(HWND hWnd, int nIndex, LONG_PTR dwNewLong) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || nIndex != GWL_STYLE) return 0;
+
+    const LONG_PTR old = w->style;
+    STYLESTRUCT ss = { (DWORD)old, (DWORD)dwNewLong };
+    Deliver(w, WM_STYLECHANGING, (WPARAM)GWL_STYLE, (LPARAM)&ss);
+    w->style = ss.styleNew;
+    Deliver(w, WM_STYLECHANGED, (WPARAM)GWL_STYLE, (LPARAM)&ss);
+    return old;
+}
+
+int GetWindowText(HWND hWnd, LPWSTR lpString, int nMaxCount) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || nMaxCount <= 0) return 0;
+    const int length = std::min((int)w->text.size(), nMaxCount - 1);
+    wmemcpy(lpString, w->text.c_str(), length);
+    lpString[length] = 0;
+    return length;
+}
+
+BOOL IsWindow(HWND hWnd) {
+    STANDIN_API();
+    return FindWindow(hWnd) != nullptr;
+}
+
+// top-level windows only, in creation order; no class or title filter
+HWND FindWindowEx(HWND hWndParent, HWND hWndChildAfter, LPCWSTR lpszClass, LPCWSTR lpszWindow) {
+    STANDIN_API();
+    if (hWndParent || lpszClass || lpszWindow) return nullptr;
+    const size_t count = g_windowCount;
+    for (size_t i = hWndChildAfter ? ((UINT_PTR)hWndChildAfter >> 4) : 0; i < count; i++) {
+        window_rec* w = g_windows[i];
+        if (w && w->alive && !w->parent) return w->hwnd;
+    }
+    return nullptr;
+}
+
+DWORD GetWindowThreadProcessId(HWND hWnd, LPDWORD lpdwProcessId) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return 0;
+    if (lpdwProcessId) *lpdwProcessId = w->processId ? w->processId : GetCurrentProcessId();
+    return w->threadId;
+}
+
+HWND GetAncestor(HWND hWnd, UINT gaFlags) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return nullptr;
+    if (gaFlags == GA_PARENT) return w->parent;
+    while (window_rec* parent = FindWindow(w->parent)) w = parent;
+    return w->hwnd;
+}
+
+HWND GetParent(HWND hWnd) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    return w ? w->parent : nullptr;
+}
+
+BOOL GetWindowRect(HWND hWnd, RECT* lpRect) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return FALSE;
+    *lpRect = w->rect;
+    return TRUE;
+}
+
+BOOL GetClientRect(HWND hWnd, RECT* lpRect) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return FALSE;
+    *lpRect = { 0, 0, w->clientSize.cx, w->clientSize.cy };
+    return TRUE;
+}
+
+int MapWindowPoints(HWND hWndFrom, HWND hWndTo, POINT* lpPoints, UINT cPoints) {
+    STANDIN_API();
+    const auto origin = [](HWND hWnd) {
+        window_rec* w = FindWindow(hWnd);
+        return w ? POINT{ w->rect.left + w->clientOrigin.x, w->rect.top + w->clientOrigin.y } : POINT{ 0, 0 };
+    };
+    const POINT from = origin(hWndFrom);
+    const POINT to = origin(hWndTo);
+    for (UINT i = 0; i < cPoints; i++) {
+        lpPoints[i].x += from.x - to.x;
+        lpPoints[i].y += from.y - to.y;
+    }
+    return (int)(((WORD)(from.x - to.x)) | ((DWORD)(WORD)(from.y - to.y) << 16));
+}
+
+BOOL GetMenuBarInfo(HWND hWnd, LONG idObject, LONG idItem, MENUBARINFO* pmbi) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || !w->menu || idObject != OBJID_MENU) return FALSE;
+    pmbi->rcBar = { w->rect.left + 8, w->rect.top + 31, w->rect.right - 8, w->rect.top + 50 };
+    pmbi->hMenu = w->menu;
+    return TRUE;
+}
+
+BOOL GetMenuItemInfo(HMENU hMenu, UINT item, BOOL fByPosition, MENUITEMINFO* lpmii) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    auto it = g_menus.find((UINT_PTR)hMenu);
+    if (it == g_menus.end() || !fByPosition || item >= it->second.size()) return FALSE;
+
+    const std::wstring& label = it->second[item];
+    if (lpmii->fMask & MIIM_STRING) {
+        if (!lpmii->dwTypeData || !lpmii->cch) {
+            lpmii->cch = (UINT)label.size();
+        }
+        else {
+            const UINT length = std::min((UINT)label.size(), lpmii->cch - 1);
+            wmemcpy(lpmii->dwTypeData, label.c_str(), length);
+            lpmii->dwTypeData[length] = 0;
+            lpmii->cch = length;
+        }
+    }
+    return TRUE;
+}
+
+UINT GetDpiForWindow(HWND hWnd) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    return w ? w->dpi : 0;
+}
+
+BOOL SystemParametersInfoForDpi(UINT uiAction, UINT uiParam, PVOID pvParam, UINT fWinIni, UINT dpi) {
+    STANDIN_API();
+    if (uiAction != SPI_GETNONCLIENTMETRICS || !pvParam) return FALSE;
+    NONCLIENTMETRICS& ncm = *(NONCLIENTMETRICS*)pvParam;
+    ncm = { sizeof(ncm) };
+    ncm.lfMessageFont.lfHeight = MulDiv(-12, dpi, USER_DEFAULT_SCREEN_DPI);
+    wcscpy(ncm.lfMessageFont.lfFaceName, L"Segoe UI");
+    return TRUE;
+}
+
+BOOL RedrawWindow(HWND hWnd, const RECT* lprcUpdate, HRGN hrgnUpdate, UINT flags) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return FALSE;
+    w->invalidations++;
+    return TRUE;
+}
+
+BOOL InvalidateRect(HWND hWnd, const RECT* lpRect, BOOL bErase) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w) return FALSE;
+    w->invalidations++;
+    return TRUE;
+}
+
+BOOL TrackMouseEvent(TRACKMOUSEEVENT* lpEventTrack) {
+    STANDIN_API();
+    window_rec* w = FindWindow(lpEventTrack->hwndTrack);
+    if (!w || lpEventTrack->cbSize != sizeof(TRACKMOUSEEVENT)) return FALSE;
+    if (lpEventTrack->dwFlags & TME_LEAVE) w->tracksLeave = !(lpEventTrack->dwFlags & TME_CANCEL);
+    return TRUE;
+}
+
+LRESULT SendMessage(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    return w ? Deliver(w, Msg, wParam, lParam) : 0;
+}
+
+BOOL PostThreadMessage(DWORD idThread, UINT Msg, WPARAM wParam, LPARAM lParam) {
+    STANDIN_API();
+    STANDIN_FAIL_IF_ASKED(FALSE);
+    std::lock_guard lock(g_lock);
+    thread_rec* thread = FindThread(idThread);
+    if (!thread) return FALSE;
+    thread->queue.push_back({ nullptr, Msg, wParam, lParam });
+    g_changed.notify_all();
+    return TRUE;
+}
+
+BOOL PeekMessage(MSG* lpMsg, HWND hWnd, UINT wMsgFilterMin, UINT wMsgFilterMax, UINT wRemoveMsg) {
+    STANDIN_API();
+    thread_rec& self = Self();
+    const UINT remove = wRemoveMsg & PM_REMOVE;
+    {
+        std::lock_guard lock(g_lock);
+        self.gui = true;
+        // only sent messages were asked for, and nothing is ever sent across threads here
+        if ((wRemoveMsg & PM_QS_SENDMESSAGE) || self.queue.empty()) return FALSE;
+        *lpMsg = self.queue.front();
+        if (remove) self.queue.pop_front();
+    }
+    CallHooks(self.id, WH_GETMESSAGE, HC_ACTION, remove, (LPARAM)lpMsg);
+    return TRUE;
+}
+
+DWORD MsgWaitForMultipleObjects(DWORD nCount, const HANDLE* pHandles, BOOL fWaitAll, DWORD dwMilliseconds, DWORD dwWakeMask) {
+    STANDIN_API();
+    thread_rec& self = Self();
+    std::vector<std::shared_ptr<kobject>> objects;
+    for (DWORD i = 0; i < nCount; i++) objects.push_back(FindHandle(pHandles[i]));
+
+    const auto deadline = dwMilliseconds == INFINITE ? clock::time_point::max() : clock::now() + std::chrono::milliseconds(dwMilliseconds);
+    std::unique_lock lock(g_lock);
+    for (;;) {
+        for (DWORD i = 0; i < nCount; i++) {
+            if (objects[i] && IsSignaled(*objects[i])) {
+                if (objects[i]->kind == kobject::Event && !objects[i]->manualReset) objects[i]->signaled = false;
+                return WAIT_OBJECT_0 + i;
+            }
+        }
+        // posted messages only count as input when the mask asks for them
+        if ((dwWakeMask & ~QS_SENDMESSAGE) && !self.queue.empty()) return WAIT_OBJECT_0 + nCount;
+        if (g_changed.wait_until(lock, deadline) == std::cv_status::timeout && clock::now() >= deadline) return WAIT_TIMEOUT;
+    }
+}
+
+BOOL EnumThreadWindows(DWORD dwThreadId, WNDENUMPROC lpfn, LPARAM lParam) {
+    STANDIN_API();
+    std::vector<HWND> windows;
+    for (size_t i = 0, count = g_windowCount; i < count; i++) {
+        window_rec* w = g_windows[i];
+        if (w && w->alive && w->threadId == dwThreadId && !w->parent) windows.push_back(w->hwnd);
+    }
+    for (HWND hWnd : windows) {
+        if (!lpfn(hWnd, lParam)) break;
+    }
+    return TRUE;
+}
+
+BOOL EnumChildWindows(HWND hWndParent, WNDENUMPROC lpEnumFunc, LPARAM lParam) {
+    STANDIN_API();
+    std::vector<HWND> windows;
+    const std::function<void(HWND)> collect = [&](HWND parent) {
+        if (window_rec* w = FindWindow(parent)) {
+            for (HWND child : w->children) {
+                windows.push_back(child);
+                collect(child);
+            }
+        }
+    };
+    collect(hWndParent);
+    for (HWND hWnd : windows) {
+        if (!lpEnumFunc(hWnd, lParam)) break;
+    }
+    return TRUE;
+}
+
+BOOL GetGUIThreadInfo(DWORD idThread, GUITHREADINFO* pgui) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    thread_rec* thread = FindThread(idThread);
+    return thread && thread->gui;
+}
+
+DWORD GetGuiResources(HANDLE hProcess, DWORD uiFlags) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    if (uiFlags == GR_GDIOBJECTS) return g_gdiBase + (DWORD)g_liveGdi;
+
+    DWORD user = g_userBase + (DWORD)g_menus.size();
+    for (size_t i = 0, count = g_windowCount; i < count; i++) {
+        if (window_rec* w = g_windows[i]; w && w->alive && !w->processId) user++;
+    }
+    for (const auto& [id, thread] : g_threads) {
+        user += (DWORD)thread->hooks.size();
+    }
+    return user;
+}
+
+HHOOK SetWindowsHookEx(int idHook, HOOKPROC lpfn, HINSTANCE hmod, DWORD dwThreadId) {
+    STANDIN_API();
+    STANDIN_FAIL_IF_ASKED(nullptr);
+    std::lock_guard lock(g_lock);
+    thread_rec* thread = FindThread(dwThreadId);
+    if (!thread || !lpfn) return nullptr;
+    hook_rec* hook = new hook_rec{ idHook, lpfn, dwThreadId, false };
+    thread->hooks.push_back(hook);
+    return (HHOOK)hook;
+}
+
+BOOL UnhookWindowsHookEx(HHOOK hhk) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    hook_rec* hook = (hook_rec*)hhk;
+    if (!hook || hook->removed) return FALSE;
+    hook->removed = true;
+    if (thread_rec* thread = FindThread(hook->threadId)) std::erase(thread->hooks, hook);
+    return TRUE;
+}
+
+LRESULT CallNextHookEx(HHOOK hhk, int nCode, WPARAM wParam, LPARAM lParam) {
+    STANDIN_API();
+    return 0;
+}
+
+UINT_PTR SetTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse, TIMERPROC lpTimerFunc) {
+    STANDIN_API();
+    static UINT_PTR nextTimer = 0x7000;
+    thread_rec& self = Self();
+    std::lock_guard lock(g_lock);
+    if (hWnd) return 0;
+    const UINT_PTR id = ++nextTimer;
+    self.timers.push_back({ id, uElapse, lpTimerFunc, clock::now() + std::chrono::milliseconds(uElapse) });
+    return id;
+}
+
+BOOL KillTimer(HWND hWnd, UINT_PTR uIDEvent) {
+    STANDIN_API();
+    thread_rec& self = Self();
+    std::lock_guard lock(g_lock);
+    return std::erase_if(self.timers, [uIDEvent](const timer_rec& t) { return t.id == uIDEvent; }) != 0;
+}
+
+HDC GetWindowDC(HWND hWnd) {
+    STANDIN_API();
+    return FindWindow(hWnd) ? (HDC)NewGdiObject(gdi_kind::WindowDC) : nullptr;
+}
+
+int ReleaseDC(HWND hWnd, HDC hDC) {
+    STANDIN_API();
+    return DeleteGdiObject(hDC, { gdi_kind::WindowDC });
+}
+
+int FillRect(HDC hDC, const RECT* lprc, HBRUSH hbr) {
+    STANDIN_API();
+    return hDC && hbr;
+}
+
+BOOL DrawFocusRect(HDC hDC, const RECT* lprc) {
+    STANDIN_API();
+    return TRUE;
+}
+
+int DrawText(HDC hdc, LPCWSTR lpchText, int cchText, RECT* lprc, UINT format) {
+    STANDIN_API();
+    return 16;
+}
+
+BOOL OffsetRect(RECT* lprc, int dx, int dy) {
+    lprc->left += dx;
+    lprc->right += dx;
+    lprc->top += dy;
+    lprc->bottom += dy;
+    return TRUE;
+}
+
+BOOL InflateRect(RECT* lprc, int dx, int dy) {
+    lprc->left -= dx;
+    lprc->right += dx;
+    lprc->top -= dy;
+    lprc->bottom += dy;
+    return TRUE;
+}
+
+BOOL EqualRect(const RECT* lprc1, const RECT* lprc2) {
+    return memcmp(lprc1, lprc2, sizeof(RECT)) == 0;
+}
+
+BOOL IsRectEmpty(const RECT* lprc) {
+    return lprc->right <= lprc->left || lprc->bottom <= lprc->top;
+}
+
+int MulDiv(int nNumber, int nNumerator, int nDenominator) {
+    if (nDenominator == 0) return -1;
+    const long long product = (long long)nNumber * nNumerator;
+    const long long magnitude = (std::llabs(product) + std::llabs((long long)nDenominator) / 2) / std::llabs((long long)nDenominator);
+    return (int)((product < 0) != (nDenominator < 0) ? -magnitude : magnitude);
+}
+
+// comctl32
+BOOL SetWindowSubclass(HWND hWnd, SUBCLASSPROC pfnSubclass, UINT_PTR uIdSubclass, DWORD_PTR dwRefData) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || w->threadId != Self().id) return FALSE;
+    for (subclass_rec& subclass : w->subclasses) {
+        if (subclass.proc == pfnSubclass && subclass.id == uIdSubclass) {
+            subclass.refData = dwRefData;
+            return TRUE;
+        }
+    }
+    w->subclasses.push_back({ pfnSubclass, uIdSubclass, dwRefData });
+    return TRUE;
+}
+
+BOOL GetWindowSubclass(HWND hWnd, SUBCLASSPROC pfnSubclass, UINT_PTR uIdSubclass, DWORD_PTR* pdwRefData) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || w->threadId != Self().id) return FALSE;
+    for (const subclass_rec& subclass : w->subclasses) {
+        if (subclass.proc == pfnSubclass && subclass.id == uIdSubclass) {
+            if (pdwRefData) *pdwRefData = subclass.refData;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BOOL RemoveWindowSubclass(HWND hWnd, SUBCLASSPROC pfnSubclass, UINT_PTR uIdSubclass) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hWnd);
+    if (!w || w->threadId != Self().id) return FALSE;
+    return std::erase_if(w->subclasses, [&](const subclass_rec& subclass) {
+        return subclass.proc == pfnSubclass && subclass.id == uIdSubclass;
+    }) != 0;
+}
+
+LRESULT DefSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    STANDIN_API();
+    for (auto it = t_frames.rbegin(); it != t_frames.rend(); ++it) {
+        if (it->window->hwnd == hWnd) return CallSubclass(it->window, it->index - 1, uMsg, wParam, lParam);
+    }
+    window_rec* w = FindWindow(hWnd);
+    return w ? CallSubclass(w, -1, uMsg, wParam, lParam) : 0;
+}
+
+// gdi32
+HBRUSH CreateSolidBrush(COLORREF color) {
+    STANDIN_API();
+    return (HBRUSH)NewGdiObject(gdi_kind::Brush);
+}
+
+HPEN CreatePen(int iStyle, int cWidth, COLORREF color) {
+    STANDIN_API();
+    return (HPEN)NewGdiObject(gdi_kind::Pen);
+}
+
+HFONT CreateFontIndirect(const LOGFONT* lplf) {
+    STANDIN_API();
+    return (HFONT)NewGdiObject(gdi_kind::Font);
+}
+
+HDC CreateCompatibleDC(HDC hdc) {
+    STANDIN_API();
+    return (HDC)NewGdiObject(gdi_kind::DC);
+}
+
+HBITMAP CreateCompatibleBitmap(HDC hdc, int cx, int cy) {
+    STANDIN_API();
+    return cx > 0 && cy > 0 ? (HBITMAP)NewGdiObject(gdi_kind::Bitmap) : nullptr;
+}
+
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ h) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    auto it = g_gdiObjects.find((UINT_PTR)h);
+    if (!hdc || it == g_gdiObjects.end()) return nullptr;
+    HGDIOBJ& selected = g_selected[(UINT_PTR)hdc][it->second];
+    const HGDIOBJ previous = selected;
+    selected = h;
+    // the DC's stock object for the kind, never deleted
+    return previous ? previous : (HGDIOBJ)(0x1000 + (UINT_PTR)it->second * 4);
+}
+
+BOOL DeleteObject(HGDIOBJ ho) {
+    STANDIN_API();
+    return DeleteGdiObject(ho, { gdi_kind::Brush, gdi_kind::Pen, gdi_kind::Font, gdi_kind::Bitmap });
+}
+
+BOOL DeleteDC(HDC hdc) {
+    STANDIN_API();
+    return DeleteGdiObject(hdc, { gdi_kind::DC });
+}
+
+BOOL BitBlt(HDC hdc, int x, int y, int cx, int cy, HDC hdcSrc, int x1, int y1, DWORD rop) {
+    STANDIN_API();
+    return hdc && hdcSrc;
+}
+
+BOOL Rectangle(HDC hdc, int left, int top, int right, int bottom) {
+    STANDIN_API();
+    return TRUE;
+}
+
+COLORREF SetBkColor(HDC hdc, COLORREF color) {
+    STANDIN_API();
+    return 0;
+}
+
+COLORREF SetTextColor(HDC hdc, COLORREF color) {
+    STANDIN_API();
+    return 0;
+}
+
+int SetBkMode(HDC hdc, int mode) {
+    STANDIN_API();
+    return OPAQUE;
+}
+
+// uxtheme and dwm
+HTHEME OpenThemeData(HWND hwnd, LPCWSTR pszClassList) {
+    STANDIN_API();
+    return NewGdiObject(gdi_kind::Theme);
+}
+
+HRESULT CloseThemeData(HTHEME hTheme) {
+    STANDIN_API();
+    return DeleteGdiObject(hTheme, { gdi_kind::Theme }) ? S_OK : E_FAIL;
+}
+
+HRESULT DrawThemeTextEx(HTHEME hTheme, HDC hdc, int iPartId, int iStateId, LPCWSTR pszText, int cchText, DWORD dwTextFlags, RECT* pRect, const DTTOPTS* pOptions) {
+    STANDIN_API();
+    return hdc ? S_OK : E_FAIL;
+}
+
+HRESULT SetWindowTheme(HWND hwnd, LPCWSTR pszSubAppName, LPCWSTR pszSubIdList) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hwnd);
+    if (!w) return E_FAIL;
+    w->themed = pszSubAppName != nullptr;
+    return S_OK;
+}
+
+HRESULT DwmSetWindowAttribute(HWND hwnd, DWORD dwAttribute, LPCVOID pvAttribute, DWORD cbAttribute) {
+    STANDIN_API();
+    window_rec* w = FindWindow(hwnd);
+    if (!w || cbAttribute != sizeof(DWORD)) return E_FAIL;
+    std::lock_guard lock(g_lock);
+    w->dwm[dwAttribute] = *(const DWORD*)pvAttribute;
+    return S_OK;
+}
+
+// kernel32
+DWORD GetCurrentThreadId() {
+    return Self().id;
+}
+
+DWORD GetCurrentProcessId() {
+    return (DWORD)getpid();
+}
+
+HANDLE GetCurrentProcess() {
+    return (HANDLE)(LONG_PTR)-1;
+}
+
+DWORD GetLastError() {
+    return t_lastError;
+}
+
+void Sleep(DWORD dwMilliseconds) {
+    STANDIN_API();
+    if (dwMilliseconds) std::this_thread::sleep_for(std::chrono::milliseconds(dwMilliseconds));
+    else std::this_thread::yield();
+}
+
+ULONGLONG GetTickCount64() {
+    STANDIN_API();
+    return (ULONGLONG)std::chrono::duration_cast<std::chrono::milliseconds>(clock::now().time_since_epoch()).count() + g_tickOffset;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* lpPerformanceCount) {
+    STANDIN_API();
+    const LONGLONG stepped = g_counterSteps.fetch_add(g_counterStep) + g_counterStep;
+    lpPerformanceCount->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count() +
+        (LONGLONG)g_tickOffset * 1000000 + stepped;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* lpFrequency) {
+    STANDIN_API();
+    lpFrequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+void OutputDebugStringW(LPCWSTR lpOutputString) {
+    STANDIN_API();
+    if (getenv("STANDIN_DEBUG")) fprintf(stderr, "%ls", lpOutputString);
+    std::lock_guard lock(g_lock);
+    g_debugLog.push_back(lpOutputString);
+}
+
+DWORD GetEnvironmentVariableW(LPCWSTR lpName, LPWSTR lpBuffer, DWORD nSize) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    auto it = g_env.find(lpName);
+    if (it == g_env.end()) return 0;
+    const std::wstring& value = it->second;
+    if (!lpBuffer || nSize <= value.size()) return (DWORD)value.size() + 1;
+    wcscpy(lpBuffer, value.c_str());
+    return (DWORD)value.size();
+}
+
+BOOL CloseHandle(HANDLE hObject) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    auto it = g_handles.find((UINT_PTR)hObject);
+    if (it == g_handles.end()) return FALSE;
+    kobject& object = *it->second;
+    if (object.kind == kobject::File) {
+        close(object.fd);
+        if (object.written) SignalChange(object.path);
+    }
+    g_handles.erase(it);
+    return TRUE;
+}
+
+HANDLE CreateEventW(SECURITY_ATTRIBUTES* lpEventAttributes, BOOL bManualReset, BOOL bInitialState, LPCWSTR lpName) {
+    STANDIN_API();
+    auto event = std::make_shared<kobject>(kobject{ kobject::Event });
+    event->manualReset = bManualReset;
+    event->signaled = bInitialState;
+    return NewHandle(event);
+}
+
+BOOL SetEvent(HANDLE hEvent) {
+    STANDIN_API();
+    std::shared_ptr<kobject> event = FindHandle(hEvent);
+    if (!event || event->kind != kobject::Event) return FALSE;
+    std::lock_guard lock(g_lock);
+    event->signaled = true;
+    g_changed.notify_all();
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE hEvent) {
+    STANDIN_API();
+    std::shared_ptr<kobject> event = FindHandle(hEvent);
+    if (!event || event->kind != kobject::Event) return FALSE;
+    std::lock_guard lock(g_lock);
+    event->signaled = false;
+    return TRUE;
+}
+
+DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE* lpHandles, BOOL bWaitAll, DWORD dwMilliseconds) {
+    STANDIN_API();
+    return MsgWaitForMultipleObjects(nCount, lpHandles, bWaitAll, dwMilliseconds, 0);
+}
+
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds) {
+    STANDIN_API();
+    return MsgWaitForMultipleObjects(1, &hHandle, FALSE, dwMilliseconds, 0);
+}
+
+HANDLE CreateThread(SECURITY_ATTRIBUTES* lpThreadAttributes, SIZE_T dwStackSize, LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter, DWORD dwCreationFlags, LPDWORD lpThreadId) {
+    STANDIN_API();
+    auto rec = NewThread();
+    auto object = std::make_shared<kobject>(kobject{ kobject::Thread });
+    object->thread = rec;
+    if (lpThreadId) *lpThreadId = rec->id;
+    const HANDLE handle = NewHandle(object);
+    std::thread([rec, lpStartAddress, lpParameter] {
+        RunThread(rec, [=] { lpStartAddress(lpParameter); });
+    }).detach();
+    return handle;
+}
+
+HANDLE OpenThread(DWORD dwDesiredAccess, BOOL bInheritHandle, DWORD dwThreadId) {
+    STANDIN_API();
+    auto object = std::make_shared<kobject>(kobject{ kobject::Thread });
+    {
+        std::lock_guard lock(g_lock);
+        auto it = g_threads.find(dwThreadId);
+        if (it == g_threads.end()) return nullptr;
+        object->thread = it->second;
+    }
+    return NewHandle(object);
+}
+
+HANDLE CreateToolhelp32Snapshot(DWORD dwFlags, DWORD th32ProcessID) {
+    STANDIN_API();
+    auto snapshot = std::make_shared<kobject>(kobject{ kobject::Snapshot });
+    {
+        std::lock_guard lock(g_lock);
+        for (const auto& [id, thread] : g_threads) {
+            if (!thread->exited) snapshot->threads.push_back(id);
+        }
+    }
+    return NewHandle(snapshot);
+}
+
+namespace {
+
+BOOL NextSnapshotThread(HANDLE hSnapshot, THREADENTRY32* lpte) {
+    std::shared_ptr<kobject> snapshot = FindHandle(hSnapshot);
+    if (!snapshot || snapshot->kind != kobject::Snapshot || snapshot->next >= snapshot->threads.size()) return FALSE;
+    lpte->th32ThreadID = snapshot->threads[snapshot->next++];
+    lpte->th32OwnerProcessID = GetCurrentProcessId();
+    return TRUE;
+}
+
+}
+
+BOOL Thread32First(HANDLE hSnapshot, THREADENTRY32* lpte) {
+    STANDIN_API();
+    if (std::shared_ptr<kobject> snapshot = FindHandle(hSnapshot)) snapshot->next = 0;
+    return NextSnapshotThread(hSnapshot, lpte);
+}
+
+BOOL Thread32Next(HANDLE hSnapshot, THREADENTRY32* lpte) {
+    STANDIN_API();
+    return NextSnapshotThread(hSnapshot, lpte);
+}
+
+// writer -1, otherwise the number of readers
+void AcquireSRWLockShared(PSRWLOCK SRWLock) {
+    STANDIN_API();
+    std::atomic_ref<LONG_PTR> state(SRWLock->Ptr);
+    for (;;) {
+        LONG_PTR readers = state.load(std::memory_order_relaxed);
+        if (readers >= 0 && state.compare_exchange_weak(readers, readers + 1, std::memory_order_acquire)) return;
+        std::this_thread::yield();
+    }
+}
+
+void ReleaseSRWLockShared(PSRWLOCK SRWLock) {
+    std::atomic_ref<LONG_PTR>(SRWLock->Ptr).fetch_sub(1, std::memory_order_release);
+}
+
+void AcquireSRWLockExclusive(PSRWLOCK SRWLock) {
+    STANDIN_API();
+    std::atomic_ref<LONG_PTR> state(SRWLock->Ptr);
+    for (;;) {
+        LONG_PTR free = 0;
+        if (state.compare_exchange_weak(free, -1, std::memory_order_acquire)) return;
+        std::this_thread::yield();
+    }
+}
+
+void ReleaseSRWLockExclusive(PSRWLOCK SRWLock) {
+    std::atomic_ref<LONG_PTR>(SRWLock->Ptr).store(0, std::memory_order_release);
+}
+
+BOOL GetModuleHandleExW(DWORD dwFlags, LPCWSTR lpModuleName, HMODULE* phModule) {
+    STANDIN_API();
+    HMODULE module = nullptr;
+    if (dwFlags & GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS) {
+        std::lock_guard lock(g_lock);
+        // addresses inside other registered modules are their handles
+        module = g_modules.count((HMODULE)lpModuleName) ? (HMODULE)lpModuleName : g_dllModule;
+    }
+    else {
+        module = GetModuleHandleW(lpModuleName);
+    }
+    *phModule = module;
+    if (!module) return FALSE;
+    if (!(dwFlags & GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT)) {
+        std::lock_guard lock(g_lock);
+        g_moduleRefs[module]++;
+    }
+    return TRUE;
+}
+
+HMODULE GetModuleHandle(LPCWSTR lpModuleName) {
+    return GetModuleHandleW(lpModuleName);
+}
+
+HMODULE GetModuleHandleW(LPCWSTR lpModuleName) {
+    STANDIN_API();
+    if (!lpModuleName) return g_exeModule;
+    if (_wcsicmp(lpModuleName, L"ntdll.dll") == 0) return g_ntdll;
+    if (_wcsicmp(lpModuleName, L"uxtheme.dll") == 0) return g_uxtheme;
+    if (_wcsicmp(lpModuleName, L"user32.dll") == 0) return g_user32;
+    return nullptr;
+}
+
+DWORD GetModuleFileNameW(HMODULE hModule, LPWSTR lpFilename, DWORD nSize) {
+    STANDIN_API();
+    if (hModule != g_dllModule || !nSize) return 0;
+    const DWORD length = std::min((DWORD)g_dllPath.size(), nSize - 1);
+    wmemcpy(lpFilename, g_dllPath.c_str(), length);
+    lpFilename[length] = 0;
+    return length;
+}
+
+HMODULE LoadLibraryExW(LPCWSTR lpLibFileName, HANDLE hFile, DWORD dwFlags) {
+    STANDIN_API();
+    return GetModuleHandleW(lpLibFileName);
+}
+
+FARPROC GetProcAddress(HMODULE hModule, LPCSTR lpProcName) {
+    STANDIN_API();
+    const bool ordinal = (ULONG_PTR)lpProcName < 0x10000;
+    const auto is = [&](const char* name) { return !ordinal && strcmp(lpProcName, name) == 0; };
+
+    const char* system = hModule == g_ntdll ? "ntdll.dll" : hModule == g_uxtheme ? "uxtheme.dll" : nullptr;
+    if (system) {
+        char key[128];
+        if (ordinal) snprintf(key, sizeof(key), "%s!#%u", system, (unsigned)(ULONG_PTR)lpProcName);
+        else snprintf(key, sizeof(key), "%s!%s", system, lpProcName);
+        std::lock_guard lock(g_lock);
+        if (g_missingExports.count(key)) return nullptr;
+    }
+
+    if (hModule == g_ntdll && is("RtlGetVersion")) return (FARPROC)StandinRtlGetVersion;
+    if (hModule == g_uxtheme) {
+        if (ordinal && (ULONG_PTR)lpProcName == 135) return (FARPROC)StandinSetPreferredAppMode;
+        if (ordinal && (ULONG_PTR)lpProcName == 136) return (FARPROC)StandinFlushMenuThemes;
+        if (is("OpenThemeDataForDpi")) return (FARPROC)StandinOpenThemeDataForDpi;
+    }
+
+    std::lock_guard lock(g_lock);
+    auto it = g_modules.find(hModule);
+    if (it == g_modules.end() || ordinal) return nullptr;
+    for (const auto& [name, proc] : it->second) {
+        if (name == lpProcName) return proc;
+    }
+    return nullptr;
+}
+
+BOOL FreeLibrary(HMODULE hLibModule) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    LONG& refs = g_moduleRefs[hLibModule];
+    if (refs <= 0) return FALSE;
+    refs--;
+    return TRUE;
+}
+
+void FreeLibraryAndExitThread(HMODULE hLibModule, DWORD dwExitCode) {
+    STANDIN_API();
+    FreeLibrary(hLibModule);
+    throw thread_exit{};
+}
+
+HANDLE CreateFileW(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, SECURITY_ATTRIBUTES* lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile) {
+    STANDIN_API();
+    const bool write = dwDesiredAccess & (GENERIC_WRITE | FILE_APPEND_DATA);
+    int flags = write ? ((dwDesiredAccess & GENERIC_READ) ? O_RDWR : O_WRONLY) : O_RDONLY;
+    if (dwDesiredAccess == FILE_APPEND_DATA) flags |= O_APPEND;
+    if (dwCreationDisposition == CREATE_ALWAYS) flags |= O_CREAT | O_TRUNC;
+
+    const std::string path = NarrowPath(lpFileName);
+    const int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        t_lastError = ERROR_FILE_NOT_FOUND;
+        return INVALID_HANDLE_VALUE;
+    }
+    auto file = std::make_shared<kobject>(kobject{ kobject::File });
+    file->fd = fd;
+    file->path = path;
+    file->written = dwCreationDisposition == CREATE_ALWAYS;
+    return NewHandle(file);
+}
+
+BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead, LPDWORD lpNumberOfBytesRead, void* lpOverlapped) {
+    STANDIN_API();
+    std::shared_ptr<kobject> file = FindHandle(hFile);
+    if (!file || file->kind != kobject::File) return FALSE;
+    DWORD total = 0;
+    while (total < nNumberOfBytesToRead) {
+        const ssize_t n = read(file->fd, (char*)lpBuffer + total, nNumberOfBytesToRead - total);
+        if (n < 0) return FALSE;
+        if (n == 0) break;
+        total += (DWORD)n;
+    }
+    if (lpNumberOfBytesRead) *lpNumberOfBytesRead = total;
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite, LPDWORD lpNumberOfBytesWritten, void* lpOverlapped) {
+    STANDIN_API();
+    std::shared_ptr<kobject> file = FindHandle(hFile);
+    if (!file || file->kind != kobject::File) return FALSE;
+    // one write call, appends from several threads don't interleave
+    const ssize_t n = write(file->fd, lpBuffer, nNumberOfBytesToWrite);
+    if (n < 0) return FALSE;
+    file->written = true;
+    if (lpNumberOfBytesWritten) *lpNumberOfBytesWritten = (DWORD)n;
+    return TRUE;
+}
+
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* lpFileSize) {
+    STANDIN_API();
+    std::shared_ptr<kobject> file = FindHandle(hFile);
+    struct stat st;
+    if (!file || file->kind != kobject::File || fstat(file->fd, &st) != 0) return FALSE;
+    lpFileSize->QuadPart = st.st_size;
+    return TRUE;
+}
+
+BOOL GetFileAttributesExW(LPCWSTR lpFileName, GET_FILEEX_INFO_LEVELS fInfoLevelId, LPVOID lpFileInformation) {
+    STANDIN_API();
+    struct stat st;
+    if (stat(NarrowPath(lpFileName).c_str(), &st) != 0) return FALSE;
+    WIN32_FILE_ATTRIBUTE_DATA& data = *(WIN32_FILE_ATTRIBUTE_DATA*)lpFileInformation;
+    data = {};
+    data.dwFileAttributes = S_ISDIR(st.st_mode) ? 0x10 : FILE_ATTRIBUTE_NORMAL;
+    data.ftCreationTime = ToFileTime(st.st_ctim);
+    data.ftLastAccessTime = ToFileTime(st.st_atim);
+    data.ftLastWriteTime = ToFileTime(st.st_mtim);
+    data.nFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+    data.nFileSizeLow = (DWORD)st.st_size;
+    return TRUE;
+}
+
+BOOL MoveFileExW(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, DWORD dwFlags) {
+    STANDIN_API();
+    const std::string to = NarrowPath(lpNewFileName);
+    if (rename(NarrowPath(lpExistingFileName).c_str(), to.c_str()) != 0) return FALSE;
+    std::lock_guard lock(g_lock);
+    SignalChange(to);
+    return TRUE;
+}
+
+BOOL DeleteFileW(LPCWSTR lpFileName) {
+    STANDIN_API();
+    const std::string path = NarrowPath(lpFileName);
+    if (unlink(path.c_str()) != 0) return FALSE;
+    std::lock_guard lock(g_lock);
+    SignalChange(path);
+    return TRUE;
+}
+
+LONG CompareFileTime(const FILETIME* lpFileTime1, const FILETIME* lpFileTime2) {
+    const ULONGLONG a = ((ULONGLONG)lpFileTime1->dwHighDateTime << 32) | lpFileTime1->dwLowDateTime;
+    const ULONGLONG b = ((ULONGLONG)lpFileTime2->dwHighDateTime << 32) | lpFileTime2->dwLowDateTime;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// sections are memfds; file-backed ones get a copy of the file, which is
+// all a read-only mapping can tell apart
+HANDLE CreateFileMappingW(HANDLE hFile, SECURITY_ATTRIBUTES* lpFileMappingAttributes, DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, LPCWSTR lpName) {
+    STANDIN_API();
+    t_lastError = ERROR_SUCCESS;
+    std::shared_ptr<section> mapping;
+    if (lpName) {
+        std::lock_guard lock(g_lock);
+        mapping = g_sections[lpName].lock();
+        if (mapping) t_lastError = ERROR_ALREADY_EXISTS;
+    }
+
+    if (!mapping) {
+        size_t size = ((size_t)dwMaximumSizeHigh << 32) | dwMaximumSizeLow;
+        std::string content;
+        if (hFile != INVALID_HANDLE_VALUE) {
+            std::shared_ptr<kobject> file = FindHandle(hFile);
+            if (!file || file->kind != kobject::File) return nullptr;
+            content = standin::ReadTextFile(file->path);
+            if (!size) size = content.size();
+        }
+        if (!size) return nullptr;
+
+        const int fd = memfd_create("standin-section", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, (off_t)size) != 0 ||
+            (!content.empty() && pwrite(fd, content.data(), std::min(size, content.size()), 0) < 0)) {
+            if (fd >= 0) close(fd);
+            return nullptr;
+        }
+        mapping = std::make_shared<section>(fd, size, lpName ? lpName : L"");
+        if (lpName) {
+            std::lock_guard lock(g_lock);
+            g_sections[lpName] = mapping;
+        }
+    }
+
+    auto object = std::make_shared<kobject>(kobject{ kobject::Mapping });
+    object->mapping = mapping;
+    return NewHandle(object);
+}
+
+LPVOID MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess, DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, SIZE_T dwNumberOfBytesToMap) {
+    STANDIN_API();
+    std::shared_ptr<kobject> object = FindHandle(hFileMappingObject);
+    if (!object || object->kind != kobject::Mapping) return nullptr;
+
+    const std::shared_ptr<section>& mapping = object->mapping;
+    const size_t size = dwNumberOfBytesToMap ? dwNumberOfBytesToMap : mapping->size;
+    const int prot = (dwDesiredAccess & FILE_MAP_WRITE) ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* view = mmap(nullptr, size, prot, MAP_SHARED, mapping->fd, 0);
+    if (view == MAP_FAILED) return nullptr;
+
+    std::lock_guard lock(g_lock);
+    g_views[view] = { size, mapping };
+    return view;
+}
+
+BOOL UnmapViewOfFile(LPCVOID lpBaseAddress) {
+    STANDIN_API();
+    std::lock_guard lock(g_lock);
+    auto it = g_views.find(lpBaseAddress);
+    if (it == g_views.end()) return FALSE;
+    munmap(const_cast<void*>(lpBaseAddress), it->second.first);
+    g_views.erase(it);
+    return TRUE;
+}
+
+HANDLE FindFirstChangeNotificationW(LPCWSTR lpPathName, BOOL bWatchSubtree, DWORD dwNotifyFilter) {
+    STANDIN_API();
+    std::string dir = NarrowPath(lpPathName);
+    while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+    auto change = std::make_shared<kobject>(kobject{ kobject::Change });
+    change->path = dir;
+    return NewHandle(change);
+}
+
+BOOL FindNextChangeNotification(HANDLE hChangeHandle) {
+    STANDIN_API();
+    std::shared_ptr<kobject> change = FindHandle(hChangeHandle);
+    if (!change || change->kind != kobject::Change) return FALSE;
+    std::lock_guard lock(g_lock);
+    change->signaled = false;
+    return TRUE;
+}
+
+BOOL FindCloseChangeNotification(HANDLE hChangeHandle) {
+    STANDIN_API();
+    return CloseHandle(hChangeHandle);
+}
+
+// CRT extensions
+int _wcsicmp(const wchar_t* string1, const wchar_t* string2) {
+    STANDIN_API();
+    for (;; string1++, string2++) {
+        const wint_t a = towlower(*string1);
+        const wint_t b = towlower(*string2);
+        if (a != b) return a < b ? -1 : 1;
+        if (!a) return 0;
+    }
+}
+
+// MSVC's wide printf reads %s as a wide string and %S as a narrow one, and
+// its longs are 32 bits like DWORD; glibc differs on all three
+int swprintf_s_impl(wchar_t* buffer, size_t sizeOfBuffer, const wchar_t* format, ...) {
+    std::wstring converted;
+    for (const wchar_t* p = format; *p; p++) {
+        converted += *p;
+        if (*p != L'%') continue;
+        if (p[1] == L'%') {
+            converted += *++p;
+            continue;
+        }
+        while (p[1] && wcschr(L"-+ #0123456789.*", p[1])) converted += *++p;
+        if (p[1] == L'l' && p[2] != L'l' && p[2] && wcschr(L"diuxX", p[2])) p++;
+        if (p[1] == L's') {
+            converted += L"ls";
+            p++;
+        }
+        else if (p[1] == L'S') {
+            converted += L's';
+            p++;
+        }
+    }
+
+    va_list args;
+    va_start(args, format);
+    const int n = vswprintf(buffer, sizeOfBuffer, converted.c_str(), args);
+    va_end(args);
+    if (n < 0 && sizeOfBuffer) buffer[0] = 0;
+    return n;
+}
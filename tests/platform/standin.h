@@ -0,0 +1,134 @@
+// Test-side controls of the stand-in Win32 layer: what the dll sees as the
+// editor's threads, windows, files and system, and counters of every API
+// call it makes. All of it lives in one process, "the editor" is the test.
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace standin {
+
+// the dll under test; DllMain is called on thread exit like the loader does
+using dll_main = bool (*)(HMODULE module, DWORD reason, LPVOID reserved);
+HMODULE DllModule();
+void SetDllMain(dll_main entry);
+void SetDllPath(const std::string& path);   // what GetModuleFileNameW reports, POSIX path
+
+// another module loaded into the process, e.g. an older build of the dll
+void RegisterModule(HMODULE module, std::vector<std::pair<std::string, FARPROC>> exports);
+void UnregisterModule(HMODULE module);
+LONG ModuleReferences(HMODULE module);     // taken by GetModuleHandleEx, given back by FreeLibrary
+
+// takes an export of ntdll.dll or uxtheme.dll away, or gives it back, as on
+// builds that lack it; ordinals are named "#135"
+void SetSystemExport(std::string_view module, std::string_view name, bool present);
+
+// the system
+void SetOsBuild(DWORD build);   // before the dll probes it
+int AppMode();                  // last SetPreferredAppMode, 0 (Default) if never called
+int MenuThemeFlushes();
+void SetEnv(const wchar_t* name, const wchar_t* value);  // null value removes it
+void AdvanceTicks(ULONGLONG ms);    // moves GetTickCount64 and QueryPerformanceCounter forward
+void SetPerformanceCounterStep(double ms); // each QueryPerformanceCounter call moves it this much further
+void SetGuiResourceBase(DWORD gdi, DWORD user); // objects owned by the rest of the editor
+LONG LiveGdiObjects();
+bool IsLiveGdiObject(HGDIOBJ handle);
+LONG LiveThemeHandles();
+// every gdi object, DC and theme handle created and deleted so far, and
+// deletes of a handle that wasn't live or not of the kind the call deletes
+typedef struct {
+    unsigned long long created;
+    unsigned long long deleted;
+    unsigned long long badDeletes;
+} gdi_counts;
+gdi_counts GdiCounts();
+std::vector<std::wstring> DebugLog();   // OutputDebugStringW, oldest first
+void ClearDebugLog();
+
+// files, with POSIX paths; writes signal change notifications on the directory
+std::string MakeTempDir();
+void WriteTextFile(const std::string& path, std::string_view text);
+std::string ReadTextFile(const std::string& path);
+std::wstring WindowsPath(const std::string& path);
+
+// threads; the body runs with a thread id of its own and DllMain sees it
+// exit, after which its windows and hooks are gone
+class thread {
+public:
+    explicit thread(std::function<void()> body);
+    ~thread();
+    thread(const thread&) = delete;
+    thread& operator=(const thread&) = delete;
+
+    DWORD id() const { return threadId; }
+    void join();
+
+private:
+    struct state;
+    state* impl;
+    DWORD threadId;
+};
+
+// delivers what is queued for the calling thread the way its message loop
+// would, WH_GETMESSAGE hooks and due timers included; returns the number of
+// messages handled
+size_t PumpMessages();
+bool PumpUntil(const std::function<bool()>& done, DWORD timeoutMs);
+size_t QueuedMessages(DWORD threadId);
+int HookCount(DWORD threadId, int idHook);
+
+// window classes and windows, created on the calling thread; the CBT hooks
+// and WM_NCCREATE / WM_CREATE run as with CreateWindowEx
+ATOM RegisterClass(const wchar_t* name, HINSTANCE owner = nullptr);
+HWND CreateWindow(const wchar_t* className, HWND parent, DWORD style, const wchar_t* text = L"");
+HWND CreateWindowOfClass(ATOM atom, HWND parent, DWORD style, const wchar_t* text = L"");
+// a window of another process's thread, a child when parent is one of them:
+// the enumerations and GetWindowThreadProcessId see it, no hook or message
+// runs for it
+HWND CreateForeignWindow(DWORD processId, DWORD threadId, HWND parent = nullptr);
+void ShowWindow(HWND hWnd);         // WM_SHOWWINDOW and the SWP_SHOWWINDOW position change
+void DestroyWindow(HWND hWnd);      // children included
+void SetWindowDpi(HWND hWnd, UINT dpi);
+void SetWindowRect(HWND hWnd, RECT rect);    // screen coordinates; sends nothing, the test sends what should follow
+void SetWindowFont(HWND hWnd, HFONT font);
+
+// the procedure below every subclass, by default a small DefWindowProc that
+// keeps text, font and the colors controls are given
+using window_proc = std::function<LRESULT(HWND, UINT, WPARAM, LPARAM)>;
+void SetWindowProc(HWND hWnd, window_proc proc);
+LRESULT DefaultWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+int SubclassCount(HWND hWnd);
+
+HMENU CreateMenu(std::vector<std::wstring> labels);
+void SetMenu(HWND hWnd, HMENU menu);
+void SetMenuItemText(HMENU menu, int position, const std::wstring& label);
+void RemoveMenuItem(HMENU menu, int position);
+
+// what the dll did to a window
+bool GetDwmAttribute(HWND hWnd, DWORD attribute, DWORD& value);
+bool HasWindowTheme(HWND hWnd);     // SetWindowTheme with a non-null name in effect
+int Invalidations(HWND hWnd);       // InvalidateRect and RedrawWindow calls
+void MouseLeave(HWND hWnd);         // WM_MOUSELEAVE, if TrackMouseEvent asked for it
+COLORREF ControlColor(HWND hWnd, UINT setter); // last value of a color setter message, CLR_INVALID if never sent
+
+// calls per API since the last reset, by function name
+struct api_counter {
+    const char* name;
+    std::atomic<unsigned long long> calls;
+    explicit api_counter(const char* name);
+};
+unsigned long long ApiCalls(std::string_view name);
+std::vector<std::pair<std::string, unsigned long long>> ApiCallCounts(); // non-zero only, by name
+void ResetApiCalls();
+
+// makes PostThreadMessage or SetWindowsHookEx fail, as with a full queue or
+// a desktop out of heap, until called again with fail false
+void FailApi(std::string_view name, bool fail = true);
+
+}
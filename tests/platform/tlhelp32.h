@@ -0,0 +1,4 @@
+// Part of the stand-in SDK, everything is declared in windows.h
+#pragma once
+
+#include <windows.h>
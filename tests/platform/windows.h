@@ -0,0 +1,791 @@
+// Stand-in for the parts of the Windows SDK the dll uses, so that
+// UnityEditorDarkMode.cpp builds and runs on Linux for the tests and
+// benchmarks. Types and constants match the SDK; the functions are
+// implemented by a small simulated user32/gdi32/kernel32 in standin.cpp,
+// see standin.h for what the tests can drive and observe.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+
+#define WINAPI
+#define CALLBACK
+#define APIENTRY
+#define DECLSPEC_NORETURN
+
+// sizes as on Windows, LONG and DWORD are 32 bits there
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef uint32_t UINT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int INT;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef uint64_t UINT64;
+typedef intptr_t INT_PTR;
+typedef uintptr_t UINT_PTR;
+typedef intptr_t LONG_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef ULONG_PTR DWORD_PTR;
+typedef ULONG_PTR SIZE_T;
+typedef UINT_PTR WPARAM;
+typedef LONG_PTR LPARAM;
+typedef LONG_PTR LRESULT;
+typedef WORD ATOM;
+typedef LONG HRESULT;
+typedef DWORD COLORREF;
+
+typedef wchar_t WCHAR;
+typedef WCHAR TCHAR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef LPWSTR LPTSTR;
+typedef LPCWSTR LPCTSTR;
+typedef char* LPSTR;
+typedef const char* LPCSTR;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef DWORD* LPDWORD;
+typedef void* HANDLE;
+typedef void* HGDIOBJ;
+typedef void* HTHEME;
+
+#define DECLARE_HANDLE(name) struct name##__ { int unused; }; typedef struct name##__* name
+DECLARE_HANDLE(HWND);
+DECLARE_HANDLE(HDC);
+DECLARE_HANDLE(HBRUSH);
+DECLARE_HANDLE(HPEN);
+DECLARE_HANDLE(HFONT);
+DECLARE_HANDLE(HBITMAP);
+DECLARE_HANDLE(HMENU);
+DECLARE_HANDLE(HINSTANCE);
+DECLARE_HANDLE(HHOOK);
+DECLARE_HANDLE(HICON);
+DECLARE_HANDLE(HRGN);
+DECLARE_HANDLE(HWINEVENTHOOK);
+typedef HINSTANCE HMODULE;
+typedef HICON HCURSOR;
+
+typedef INT_PTR(WINAPI* FARPROC)();
+typedef LRESULT(CALLBACK* HOOKPROC)(int nCode, WPARAM wParam, LPARAM lParam);
+typedef BOOL(CALLBACK* WNDENUMPROC)(HWND hWnd, LPARAM lParam);
+typedef void(CALLBACK* TIMERPROC)(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+typedef DWORD(WINAPI* LPTHREAD_START_ROUTINE)(LPVOID lpParam);
+typedef LRESULT(CALLBACK* SUBCLASSPROC)(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
+typedef void(CALLBACK* WINEVENTPROC)(HWINEVENTHOOK hWinEventHook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD idEventThread, DWORD dwmsEventTime);
+
+typedef union _LARGE_INTEGER {
+    struct {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct tagRECT {
+    LONG left, top, right, bottom;
+} RECT, *LPRECT;
+
+typedef struct tagPOINT {
+    LONG x, y;
+} POINT, *LPPOINT;
+
+typedef struct tagSIZE {
+    LONG cx, cy;
+} SIZE;
+
+typedef struct tagMSG {
+    HWND hwnd;
+    UINT message;
+    WPARAM wParam;
+    LPARAM lParam;
+    DWORD time;
+    POINT pt;
+} MSG;
+
+typedef struct tagDRAWITEMSTRUCT {
+    UINT CtlType;
+    UINT CtlID;
+    UINT itemID;
+    UINT itemAction;
+    UINT itemState;
+    HWND hwndItem;
+    HDC hDC;
+    RECT rcItem;
+    ULONG_PTR itemData;
+} DRAWITEMSTRUCT;
+
+typedef struct tagMEASUREITEMSTRUCT {
+    UINT CtlType;
+    UINT CtlID;
+    UINT itemID;
+    UINT itemWidth;
+    UINT itemHeight;
+    ULONG_PTR itemData;
+} MEASUREITEMSTRUCT;
+
+typedef struct tagMENUITEMINFOW {
+    UINT cbSize;
+    UINT fMask;
+    UINT fType;
+    UINT fState;
+    UINT wID;
+    HMENU hSubMenu;
+    HBITMAP hbmpChecked;
+    HBITMAP hbmpUnchecked;
+    ULONG_PTR dwItemData;
+    LPWSTR dwTypeData;
+    UINT cch;
+    HBITMAP hbmpItem;
+} MENUITEMINFO;
+
+typedef struct tagMENUBARINFO {
+    DWORD cbSize;
+    RECT rcBar;
+    HMENU hMenu;
+    HWND hwndMenu;
+    BOOL fBarFocused : 1;
+    BOOL fFocused : 1;
+} MENUBARINFO;
+
+typedef struct tagCOMBOBOXINFO {
+    DWORD cbSize;
+    RECT rcItem;
+    RECT rcButton;
+    DWORD stateButton;
+    HWND hwndCombo;
+    HWND hwndItem;
+    HWND hwndList;
+} COMBOBOXINFO;
+
+typedef struct tagCREATESTRUCTW {
+    LPVOID lpCreateParams;
+    HINSTANCE hInstance;
+    HMENU hMenu;
+    HWND hwndParent;
+    int cy, cx, y, x;
+    LONG style;
+    LPCWSTR lpszName;
+    LPCWSTR lpszClass;
+    DWORD dwExStyle;
+} CREATESTRUCT;
+
+typedef struct tagCBT_CREATEWNDW {
+    CREATESTRUCT* lpcs;
+    HWND hwndInsertAfter;
+} CBT_CREATEWND;
+
+typedef struct tagWINDOWPOS {
+    HWND hwnd;
+    HWND hwndInsertAfter;
+    int x, y, cx, cy;
+    UINT flags;
+} WINDOWPOS;
+
+typedef struct tagTRACKMOUSEEVENT {
+    DWORD cbSize;
+    DWORD dwFlags;
+    HWND hwndTrack;
+    DWORD dwHoverTime;
+} TRACKMOUSEEVENT;
+
+typedef struct tagSTYLESTRUCT {
+    DWORD styleOld;
+    DWORD styleNew;
+} STYLESTRUCT;
+
+typedef struct tagLOGFONTW {
+    LONG lfHeight;
+    LONG lfWidth;
+    LONG lfEscapement;
+    LONG lfOrientation;
+    LONG lfWeight;
+    BYTE lfItalic;
+    BYTE lfUnderline;
+    BYTE lfStrikeOut;
+    BYTE lfCharSet;
+    BYTE lfOutPrecision;
+    BYTE lfClipPrecision;
+    BYTE lfQuality;
+    BYTE lfPitchAndFamily;
+    WCHAR lfFaceName[32];
+} LOGFONT;
+
+typedef struct tagNONCLIENTMETRICSW {
+    UINT cbSize;
+    int iBorderWidth;
+    int iScrollWidth;
+    int iScrollHeight;
+    int iCaptionWidth;
+    int iCaptionHeight;
+    LOGFONT lfCaptionFont;
+    int iSmCaptionWidth;
+    int iSmCaptionHeight;
+    LOGFONT lfSmCaptionFont;
+    int iMenuWidth;
+    int iMenuHeight;
+    LOGFONT lfMenuFont;
+    LOGFONT lfStatusFont;
+    LOGFONT lfMessageFont;
+    int iPaddedBorderWidth;
+} NONCLIENTMETRICS;
+
+typedef struct tagTHREADENTRY32 {
+    DWORD dwSize;
+    DWORD cntUsage;
+    DWORD th32ThreadID;
+    DWORD th32OwnerProcessID;
+    LONG tpBasePri;
+    LONG tpDeltaPri;
+    DWORD dwFlags;
+} THREADENTRY32;
+
+typedef struct _OSVERSIONINFOW {
+    ULONG dwOSVersionInfoSize;
+    ULONG dwMajorVersion;
+    ULONG dwMinorVersion;
+    ULONG dwBuildNumber;
+    ULONG dwPlatformId;
+    WCHAR szCSDVersion[128];
+} RTL_OSVERSIONINFOW;
+
+typedef struct _WIN32_FILE_ATTRIBUTE_DATA {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef struct tagGUITHREADINFO {
+    DWORD cbSize;
+    DWORD flags;
+    HWND hwndActive;
+    HWND hwndFocus;
+    HWND hwndCapture;
+    HWND hwndMenuOwner;
+    HWND hwndMoveSize;
+    HWND hwndCaret;
+    RECT rcCaret;
+} GUITHREADINFO;
+
+typedef struct _SECURITY_ATTRIBUTES {
+    DWORD nLength;
+    LPVOID lpSecurityDescriptor;
+    BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES;
+
+typedef struct _DTTOPTS {
+    DWORD dwSize;
+    DWORD dwFlags;
+    COLORREF crText;
+    COLORREF crBorder;
+    COLORREF crShadow;
+    int iTextShadowType;
+    POINT ptShadowOffset;
+    int iBorderSize;
+    int iFontPropId;
+    int iColorPropId;
+    int iStateId;
+    BOOL fApplyOverlay;
+    int iGlowSize;
+    void* pfnDrawTextCallback;
+    LPARAM lParam;
+} DTTOPTS;
+
+typedef struct _RTL_SRWLOCK {
+    LONG_PTR Ptr;   // opaque, an integer here for the stand-in's atomics
+} SRWLOCK, *PSRWLOCK;
+#define SRWLOCK_INIT { 0 }
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define CLR_INVALID 0xFFFFFFFF
+#define DWMWA_COLOR_DEFAULT 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+#define GetRValue(rgb) ((BYTE)(rgb))
+#define GetGValue(rgb) ((BYTE)(((WORD)(rgb)) >> 8))
+#define GetBValue(rgb) ((BYTE)((rgb) >> 16))
+#define LOWORD(l) ((WORD)(((DWORD_PTR)(l)) & 0xffff))
+#define HIWORD(l) ((WORD)((((DWORD_PTR)(l)) >> 16) & 0xffff))
+#define MAKEWPARAM(l, h) ((WPARAM)(DWORD)((WORD)(l) | ((DWORD)(WORD)(h) << 16)))
+#define MAKELPARAM(l, h) ((LPARAM)(DWORD)((WORD)(l) | ((DWORD)(WORD)(h) << 16)))
+#define MAKEINTRESOURCEA(i) ((LPSTR)((ULONG_PTR)((WORD)(i))))
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+// window messages
+enum : UINT {
+    WM_NULL = 0x0000,
+    WM_CREATE = 0x0001,
+    WM_DESTROY = 0x0002,
+    WM_MOVE = 0x0003,
+    WM_SIZE = 0x0005,
+    WM_ACTIVATE = 0x0006,
+    WM_SETFOCUS = 0x0007,
+    WM_KILLFOCUS = 0x0008,
+    WM_ENABLE = 0x000A,
+    WM_SETREDRAW = 0x000B,
+    WM_SETTEXT = 0x000C,
+    WM_GETTEXT = 0x000D,
+    WM_GETTEXTLENGTH = 0x000E,
+    WM_PAINT = 0x000F,
+    WM_CLOSE = 0x0010,
+    WM_ERASEBKGND = 0x0014,
+    WM_SHOWWINDOW = 0x0018,
+    WM_SETTINGCHANGE = 0x001A,
+    WM_ACTIVATEAPP = 0x001C,
+    WM_CANCELMODE = 0x001F,
+    WM_SETCURSOR = 0x0020,
+    WM_MOUSEACTIVATE = 0x0021,
+    WM_GETMINMAXINFO = 0x0024,
+    WM_DRAWITEM = 0x002B,
+    WM_MEASUREITEM = 0x002C,
+    WM_SETFONT = 0x0030,
+    WM_GETFONT = 0x0031,
+    WM_WINDOWPOSCHANGING = 0x0046,
+    WM_WINDOWPOSCHANGED = 0x0047,
+    WM_NOTIFY = 0x004E,
+    WM_STYLECHANGING = 0x007C,
+    WM_STYLECHANGED = 0x007D,
+    WM_NCCREATE = 0x0081,
+    WM_NCDESTROY = 0x0082,
+    WM_NCCALCSIZE = 0x0083,
+    WM_NCHITTEST = 0x0084,
+    WM_NCPAINT = 0x0085,
+    WM_NCACTIVATE = 0x0086,
+    WM_GETDLGCODE = 0x0087,
+    WM_NCMOUSEMOVE = 0x00A0,
+    WM_NCLBUTTONDOWN = 0x00A1,
+    WM_NCLBUTTONUP = 0x00A2,
+    WM_KEYDOWN = 0x0100,
+    WM_KEYUP = 0x0101,
+    WM_CHAR = 0x0102,
+    WM_SYSKEYDOWN = 0x0104,
+    WM_SYSKEYUP = 0x0105,
+    WM_COMMAND = 0x0111,
+    WM_SYSCOMMAND = 0x0112,
+    WM_TIMER = 0x0113,
+    WM_INITMENU = 0x0116,
+    WM_INITMENUPOPUP = 0x0117,
+    WM_MENUSELECT = 0x011F,
+    WM_ENTERIDLE = 0x0121,
+    WM_CHANGEUISTATE = 0x0127,
+    WM_UPDATEUISTATE = 0x0128,
+    WM_QUERYUISTATE = 0x0129,
+    WM_CTLCOLORMSGBOX = 0x0132,
+    WM_CTLCOLOREDIT = 0x0133,
+    WM_CTLCOLORLISTBOX = 0x0134,
+    WM_CTLCOLORBTN = 0x0135,
+    WM_CTLCOLORDLG = 0x0136,
+    WM_CTLCOLORSCROLLBAR = 0x0137,
+    WM_CTLCOLORSTATIC = 0x0138,
+    WM_MOUSEMOVE = 0x0200,
+    WM_LBUTTONDOWN = 0x0201,
+    WM_LBUTTONUP = 0x0202,
+    WM_LBUTTONDBLCLK = 0x0203,
+    WM_RBUTTONDOWN = 0x0204,
+    WM_RBUTTONUP = 0x0205,
+    WM_MOUSEWHEEL = 0x020A,
+    WM_PARENTNOTIFY = 0x0210,
+    WM_ENTERMENULOOP = 0x0211,
+    WM_EXITMENULOOP = 0x0212,
+    WM_CAPTURECHANGED = 0x0215,
+    WM_ENTERSIZEMOVE = 0x0231,
+    WM_EXITSIZEMOVE = 0x0232,
+    WM_MOUSEHOVER = 0x02A1,
+    WM_MOUSELEAVE = 0x02A3,
+    WM_DPICHANGED = 0x02E0,
+    WM_DPICHANGED_BEFOREPARENT = 0x02E2,
+    WM_DPICHANGED_AFTERPARENT = 0x02E3,
+    WM_PRINT = 0x0317,
+    WM_PRINTCLIENT = 0x0318,
+    WM_THEMECHANGED = 0x031A,
+    WM_USER = 0x0400,
+    WM_APP = 0x8000,
+};
+
+enum : UINT {
+    TTM_SETTIPBKCOLOR = WM_USER + 19,
+    TTM_SETTIPTEXTCOLOR = WM_USER + 20,
+    CB_GETCOMBOBOXINFO = 0x0164,
+    TVM_SETBKCOLOR = 0x1100 + 29,
+    TVM_SETTEXTCOLOR = 0x1100 + 30,
+    LVM_SETBKCOLOR = 0x1000 + 1,
+    LVM_SETTEXTCOLOR = 0x1000 + 36,
+    LVM_SETTEXTBKCOLOR = 0x1000 + 38,
+};
+
+// hooks
+enum : int {
+    WH_GETMESSAGE = 3,
+    WH_CBT = 5,
+    HC_ACTION = 0,
+    HCBT_CREATEWND = 3,
+    HCBT_DESTROYWND = 4,
+};
+
+enum : UINT {
+    PM_NOREMOVE = 0x0000,
+    PM_REMOVE = 0x0001,
+    QS_SENDMESSAGE = 0x0040,
+    QS_ALLINPUT = 0x04FF,
+    PM_QS_SENDMESSAGE = QS_SENDMESSAGE << 16,
+};
+
+// window styles and attributes
+enum : int {
+    GWL_STYLE = -16,
+    GWL_EXSTYLE = -20,
+    GCW_ATOM = -32,
+};
+
+enum : DWORD {
+    WS_CHILD = 0x40000000,
+    WS_VISIBLE = 0x10000000,
+    WS_POPUP = 0x80000000,
+    WS_OVERLAPPEDWINDOW = 0x00CF0000,
+
+    // button styles share the window style bits
+    BS_PUSHBUTTON = 0x0,
+    BS_DEFPUSHBUTTON = 0x1,
+    BS_CHECKBOX = 0x2,
+    BS_AUTOCHECKBOX = 0x3,
+    BS_RADIOBUTTON = 0x4,
+    BS_GROUPBOX = 0x7,
+    BS_AUTORADIOBUTTON = 0x9,
+    BS_OWNERDRAW = 0xB,
+    BS_TYPEMASK = 0xF,
+    BS_ICON = 0x40,
+    BS_BITMAP = 0x80,
+    BS_LEFT = 0x100,
+};
+
+enum : UINT {
+    ODT_MENU = 1,
+    ODT_BUTTON = 4,
+    ODA_DRAWENTIRE = 1,
+    ODA_SELECT = 2,
+    ODA_FOCUS = 4,
+    ODS_SELECTED = 0x0001,
+    ODS_GRAYED = 0x0002,
+    ODS_DISABLED = 0x0004,
+    ODS_CHECKED = 0x0008,
+    ODS_FOCUS = 0x0010,
+    ODS_DEFAULT = 0x0020,
+    ODS_HOTLIGHT = 0x0040,
+    ODS_INACTIVE = 0x0080,
+    ODS_NOACCEL = 0x0100,
+};
+
+enum : DWORD {
+    TME_HOVER = 0x00000001,
+    TME_LEAVE = 0x00000002,
+    TME_CANCEL = 0x80000000,
+};
+
+enum : UINT {
+    SWP_NOSIZE = 0x0001,
+    SWP_NOMOVE = 0x0002,
+    SWP_NOZORDER = 0x0004,
+    SWP_FRAMECHANGED = 0x0020,
+    SWP_SHOWWINDOW = 0x0040,
+    SWP_HIDEWINDOW = 0x0080,
+};
+
+// WM_SIZE
+enum : UINT {
+    SIZE_RESTORED = 0,
+    SIZE_MINIMIZED = 1,
+    SIZE_MAXIMIZED = 2,
+};
+
+enum : UINT {
+    RDW_INVALIDATE = 0x0001,
+    RDW_ERASE = 0x0004,
+    RDW_ALLCHILDREN = 0x0080,
+    RDW_UPDATENOW = 0x0100,
+    RDW_FRAME = 0x0400,
+};
+
+enum : UINT {
+    GA_PARENT = 1,
+    GA_ROOT = 2,
+};
+
+enum : LONG {
+    OBJID_WINDOW = 0,
+    OBJID_MENU = -3,
+    CHILDID_SELF = 0,
+};
+
+enum : UINT {
+    MIIM_STRING = 0x0040,
+    MIIM_FTYPE = 0x0100,
+};
+
+// gdi
+enum : int {
+    PS_SOLID = 0,
+    TRANSPARENT = 1,
+    OPAQUE = 2,
+};
+
+enum : DWORD {
+    SRCCOPY = 0x00CC0020,
+};
+
+enum : UINT {
+    DT_CENTER = 0x00000001,
+    DT_VCENTER = 0x00000004,
+    DT_SINGLELINE = 0x00000020,
+    DT_CALCRECT = 0x00000400,
+    DT_EDITCONTROL = 0x00002000,
+    DT_HIDEPREFIX = 0x00100000,
+};
+
+enum : DWORD {
+    GR_GDIOBJECTS = 0,
+    GR_USEROBJECTS = 1,
+};
+
+// uxtheme and dwm
+enum : int {
+    MENU_BARITEM = 8,
+    MENU_POPUPITEM = 14,
+    MBI_NORMAL = 1,
+    MPI_NORMAL = 1,
+    MPI_HOT = 2,
+    MPI_DISABLED = 3,
+};
+
+enum : DWORD {
+    DTT_TEXTCOLOR = 1,
+};
+
+enum : DWORD {
+    DWMWA_USE_IMMERSIVE_DARK_MODE = 20,
+    DWMWA_BORDER_COLOR = 34,
+    DWMWA_CAPTION_COLOR = 35,
+    DWMWA_TEXT_COLOR = 36,
+};
+
+#define USER_DEFAULT_SCREEN_DPI 96
+#define USER_TIMER_MINIMUM 0x0000000A
+#define HTCLIENT 1
+
+enum : UINT {
+    SPI_GETNONCLIENTMETRICS = 0x0029,
+};
+
+// kernel32
+enum : DWORD {
+    DLL_PROCESS_DETACH = 0,
+    DLL_PROCESS_ATTACH = 1,
+    DLL_THREAD_ATTACH = 2,
+    DLL_THREAD_DETACH = 3,
+};
+
+enum : DWORD {
+    GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT = 0x2,
+    GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS = 0x4,
+    LOAD_LIBRARY_SEARCH_SYSTEM32 = 0x800,
+};
+
+enum : DWORD {
+    GENERIC_READ = 0x80000000,
+    GENERIC_WRITE = 0x40000000,
+    FILE_APPEND_DATA = 0x0004,
+    FILE_SHARE_READ = 0x1,
+    FILE_SHARE_WRITE = 0x2,
+    FILE_SHARE_DELETE = 0x4,
+    CREATE_ALWAYS = 2,
+    OPEN_EXISTING = 3,
+    FILE_ATTRIBUTE_HIDDEN = 0x2,
+    FILE_ATTRIBUTE_NORMAL = 0x80,
+    PAGE_READONLY = 0x02,
+    PAGE_READWRITE = 0x04,
+    FILE_MAP_WRITE = 0x0002,
+    FILE_MAP_READ = 0x0004,
+    FILE_MAP_ALL_ACCESS = 0x000F001F,
+    FILE_NOTIFY_CHANGE_FILE_NAME = 0x1,
+    FILE_NOTIFY_CHANGE_LAST_WRITE = 0x10,
+    MOVEFILE_REPLACE_EXISTING = 0x1,
+    TH32CS_SNAPTHREAD = 0x4,
+    SYNCHRONIZE = 0x00100000,
+};
+
+enum : DWORD {
+    WAIT_OBJECT_0 = 0,
+    WAIT_TIMEOUT = 258,
+    WAIT_FAILED = 0xFFFFFFFF,
+};
+
+enum : DWORD {
+    ERROR_SUCCESS = 0,
+    ERROR_FILE_NOT_FOUND = 2,
+    ERROR_INVALID_HANDLE = 6,
+    ERROR_ALREADY_EXISTS = 183,
+};
+
+typedef enum _GET_FILEEX_INFO_LEVELS {
+    GetFileExInfoStandard,
+} GET_FILEEX_INFO_LEVELS;
+
+// user32
+ATOM GetClassLongPtr(HWND hWnd, int nIndex);
+int GetClassName(HWND hWnd, LPWSTR lpClassName, int nMaxCount);
+LONG_PTR GetWindowLongPtr(HWND hWnd, int nIndex);
+LONG_PTR SetWindowLongPtr(HWND hWnd, int nIndex, LONG_PTR dwNewLong);
+int GetWindowText(HWND hWnd, LPWSTR lpString, int nMaxCount);
+BOOL IsWindow(HWND hWnd);
+HWND FindWindowEx(HWND hWndParent, HWND hWndChildAfter, LPCWSTR lpszClass, LPCWSTR lpszWindow);
+DWORD GetWindowThreadProcessId(HWND hWnd, LPDWORD lpdwProcessId);
+HWND GetAncestor(HWND hWnd, UINT gaFlags);
+HWND GetParent(HWND hWnd);
+BOOL GetWindowRect(HWND hWnd, RECT* lpRect);
+BOOL GetClientRect(HWND hWnd, RECT* lpRect);
+int MapWindowPoints(HWND hWndFrom, HWND hWndTo, POINT* lpPoints, UINT cPoints);
+BOOL GetMenuBarInfo(HWND hWnd, LONG idObject, LONG idItem, MENUBARINFO* pmbi);
+BOOL GetMenuItemInfo(HMENU hMenu, UINT item, BOOL fByPosition, MENUITEMINFO* lpmii);
+UINT GetDpiForWindow(HWND hWnd);
+BOOL SystemParametersInfoForDpi(UINT uiAction, UINT uiParam, PVOID pvParam, UINT fWinIni, UINT dpi);
+BOOL RedrawWindow(HWND hWnd, const RECT* lprcUpdate, HRGN hrgnUpdate, UINT flags);
+BOOL InvalidateRect(HWND hWnd, const RECT* lpRect, BOOL bErase);
+BOOL TrackMouseEvent(TRACKMOUSEEVENT* lpEventTrack);
+LRESULT SendMessage(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam);
+BOOL PostThreadMessage(DWORD idThread, UINT Msg, WPARAM wParam, LPARAM lParam);
+BOOL PeekMessage(MSG* lpMsg, HWND hWnd, UINT wMsgFilterMin, UINT wMsgFilterMax, UINT wRemoveMsg);
+DWORD MsgWaitForMultipleObjects(DWORD nCount, const HANDLE* pHandles, BOOL fWaitAll, DWORD dwMilliseconds, DWORD dwWakeMask);
+BOOL EnumThreadWindows(DWORD dwThreadId, WNDENUMPROC lpfn, LPARAM lParam);
+BOOL EnumChildWindows(HWND hWndParent, WNDENUMPROC lpEnumFunc, LPARAM lParam);
+BOOL GetGUIThreadInfo(DWORD idThread, GUITHREADINFO* pgui);
+DWORD GetGuiResources(HANDLE hProcess, DWORD uiFlags);
+HHOOK SetWindowsHookEx(int idHook, HOOKPROC lpfn, HINSTANCE hmod, DWORD dwThreadId);
+BOOL UnhookWindowsHookEx(HHOOK hhk);
+LRESULT CallNextHookEx(HHOOK hhk, int nCode, WPARAM wParam, LPARAM lParam);
+UINT_PTR SetTimer(HWND hWnd, UINT_PTR nIDEvent, UINT uElapse, TIMERPROC lpTimerFunc);
+BOOL KillTimer(HWND hWnd, UINT_PTR uIDEvent);
+HDC GetWindowDC(HWND hWnd);
+int ReleaseDC(HWND hWnd, HDC hDC);
+int FillRect(HDC hDC, const RECT* lprc, HBRUSH hbr);
+BOOL DrawFocusRect(HDC hDC, const RECT* lprc);
+int DrawText(HDC hdc, LPCWSTR lpchText, int cchText, RECT* lprc, UINT format);
+BOOL OffsetRect(RECT* lprc, int dx, int dy);
+BOOL InflateRect(RECT* lprc, int dx, int dy);
+BOOL EqualRect(const RECT* lprc1, const RECT* lprc2);
+BOOL IsRectEmpty(const RECT* lprc);
+int MulDiv(int nNumber, int nNumerator, int nDenominator);
+
+// comctl32
+BOOL SetWindowSubclass(HWND hWnd, SUBCLASSPROC pfnSubclass, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
+BOOL GetWindowSubclass(HWND hWnd, SUBCLASSPROC pfnSubclass, UINT_PTR uIdSubclass, DWORD_PTR* pdwRefData);
+BOOL RemoveWindowSubclass(HWND hWnd, SUBCLASSPROC pfnSubclass, UINT_PTR uIdSubclass);
+LRESULT DefSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+inline COLORREF TreeView_SetBkColor(HWND hwnd, COLORREF clr) { return (COLORREF)SendMessage(hwnd, TVM_SETBKCOLOR, 0, (LPARAM)clr); }
+inline COLORREF TreeView_SetTextColor(HWND hwnd, COLORREF clr) { return (COLORREF)SendMessage(hwnd, TVM_SETTEXTCOLOR, 0, (LPARAM)clr); }
+inline BOOL ListView_SetBkColor(HWND hwnd, COLORREF clrBk) { return (BOOL)SendMessage(hwnd, LVM_SETBKCOLOR, 0, (LPARAM)clrBk); }
+inline BOOL ListView_SetTextColor(HWND hwnd, COLORREF clrText) { return (BOOL)SendMessage(hwnd, LVM_SETTEXTCOLOR, 0, (LPARAM)clrText); }
+inline BOOL ListView_SetTextBkColor(HWND hwnd, COLORREF clrTextBk) { return (BOOL)SendMessage(hwnd, LVM_SETTEXTBKCOLOR, 0, (LPARAM)clrTextBk); }
+
+// gdi32
+HBRUSH CreateSolidBrush(COLORREF color);
+HPEN CreatePen(int iStyle, int cWidth, COLORREF color);
+HFONT CreateFontIndirect(const LOGFONT* lplf);
+HDC CreateCompatibleDC(HDC hdc);
+HBITMAP CreateCompatibleBitmap(HDC hdc, int cx, int cy);
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ h);
+BOOL DeleteObject(HGDIOBJ ho);
+BOOL DeleteDC(HDC hdc);
+BOOL BitBlt(HDC hdc, int x, int y, int cx, int cy, HDC hdcSrc, int x1, int y1, DWORD rop);
+BOOL Rectangle(HDC hdc, int left, int top, int right, int bottom);
+COLORREF SetBkColor(HDC hdc, COLORREF color);
+COLORREF SetTextColor(HDC hdc, COLORREF color);
+int SetBkMode(HDC hdc, int mode);
+
+// uxtheme and dwm
+HTHEME OpenThemeData(HWND hwnd, LPCWSTR pszClassList);
+HRESULT CloseThemeData(HTHEME hTheme);
+HRESULT DrawThemeTextEx(HTHEME hTheme, HDC hdc, int iPartId, int iStateId, LPCWSTR pszText, int cchText, DWORD dwTextFlags, RECT* pRect, const DTTOPTS* pOptions);
+HRESULT SetWindowTheme(HWND hwnd, LPCWSTR pszSubAppName, LPCWSTR pszSubIdList);
+HRESULT DwmSetWindowAttribute(HWND hwnd, DWORD dwAttribute, LPCVOID pvAttribute, DWORD cbAttribute);
+
+// kernel32
+DWORD GetCurrentThreadId();
+DWORD GetCurrentProcessId();
+HANDLE GetCurrentProcess();
+DWORD GetLastError();
+void Sleep(DWORD dwMilliseconds);
+ULONGLONG GetTickCount64();
+BOOL QueryPerformanceCounter(LARGE_INTEGER* lpPerformanceCount);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* lpFrequency);
+void OutputDebugStringW(LPCWSTR lpOutputString);
+DWORD GetEnvironmentVariableW(LPCWSTR lpName, LPWSTR lpBuffer, DWORD nSize);
+BOOL CloseHandle(HANDLE hObject);
+HANDLE CreateEventW(SECURITY_ATTRIBUTES* lpEventAttributes, BOOL bManualReset, BOOL bInitialState, LPCWSTR lpName);
+BOOL SetEvent(HANDLE hEvent);
+BOOL ResetEvent(HANDLE hEvent);
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds);
+DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE* lpHandles, BOOL bWaitAll, DWORD dwMilliseconds);
+HANDLE CreateThread(SECURITY_ATTRIBUTES* lpThreadAttributes, SIZE_T dwStackSize, LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter, DWORD dwCreationFlags, LPDWORD lpThreadId);
+HANDLE OpenThread(DWORD dwDesiredAccess, BOOL bInheritHandle, DWORD dwThreadId);
+HANDLE CreateToolhelp32Snapshot(DWORD dwFlags, DWORD th32ProcessID);
+BOOL Thread32First(HANDLE hSnapshot, THREADENTRY32* lpte);
+BOOL Thread32Next(HANDLE hSnapshot, THREADENTRY32* lpte);
+void AcquireSRWLockShared(PSRWLOCK SRWLock);
+void ReleaseSRWLockShared(PSRWLOCK SRWLock);
+void AcquireSRWLockExclusive(PSRWLOCK SRWLock);
+void ReleaseSRWLockExclusive(PSRWLOCK SRWLock);
+BOOL GetModuleHandleExW(DWORD dwFlags, LPCWSTR lpModuleName, HMODULE* phModule);
+HMODULE GetModuleHandle(LPCWSTR lpModuleName);
+HMODULE GetModuleHandleW(LPCWSTR lpModuleName);
+DWORD GetModuleFileNameW(HMODULE hModule, LPWSTR lpFilename, DWORD nSize);
+HMODULE LoadLibraryExW(LPCWSTR lpLibFileName, HANDLE hFile, DWORD dwFlags);
+FARPROC GetProcAddress(HMODULE hModule, LPCSTR lpProcName);
+BOOL FreeLibrary(HMODULE hLibModule);
+void FreeLibraryAndExitThread(HMODULE hLibModule, DWORD dwExitCode);
+HANDLE CreateFileW(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, SECURITY_ATTRIBUTES* lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
+BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead, LPDWORD lpNumberOfBytesRead, void* lpOverlapped);
+BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite, LPDWORD lpNumberOfBytesWritten, void* lpOverlapped);
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* lpFileSize);
+BOOL GetFileAttributesExW(LPCWSTR lpFileName, GET_FILEEX_INFO_LEVELS fInfoLevelId, LPVOID lpFileInformation);
+BOOL MoveFileExW(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, DWORD dwFlags);
+BOOL DeleteFileW(LPCWSTR lpFileName);
+LONG CompareFileTime(const FILETIME* lpFileTime1, const FILETIME* lpFileTime2);
+HANDLE CreateFileMappingW(HANDLE hFile, SECURITY_ATTRIBUTES* lpFileMappingAttributes, DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, LPCWSTR lpName);
+LPVOID MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess, DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, SIZE_T dwNumberOfBytesToMap);
+BOOL UnmapViewOfFile(LPCVOID lpBaseAddress);
+HANDLE FindFirstChangeNotificationW(LPCWSTR lpPathName, BOOL bWatchSubtree, DWORD dwNotifyFilter);
+BOOL FindNextChangeNotification(HANDLE hChangeHandle);
+BOOL FindCloseChangeNotification(HANDLE hChangeHandle);
+
+// CRT extensions
+int _wcsicmp(const wchar_t* string1, const wchar_t* string2);
+int swprintf_s_impl(wchar_t* buffer, size_t sizeOfBuffer, const wchar_t* format, ...);
+
+template <size_t size, typename... Args>
+int swprintf_s(wchar_t (&buffer)[size], const wchar_t* format, Args... args) {
+    return swprintf_s_impl(buffer, size, format, args...);
+}
+
+inline void YieldProcessor() {}
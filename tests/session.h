@@ -0,0 +1,120 @@
+// One frame of an editor session: the Unity window with its menu bar, the
+// preferences dialog with its controls next to it and a tooltip, and the
+// messages such a frame sends through them (menu bar paints, control colors,
+// owner-drawn buttons, mouse moves). Shared by the benchmarks; include after
+// UnityEditorDarkMode.cpp with the dll loaded.
+#pragma once
+
+#include "standin.h"
+
+#include <vector>
+
+namespace editor {
+
+typedef struct {
+    HWND hwnd;
+    UINT msg;
+    WPARAM wParam;
+    LPARAM lParam;
+} replay_msg;
+
+struct session {
+    HWND unity;
+    HWND dialog;
+    HWND buttons[4];
+    HWND checkbox;
+    HWND label;
+    HWND tooltip;
+    HWND listView;
+    HWND treeView;
+    HWND comboBox;
+    HMENU menu;
+    HDC hdc;
+    UAHMENU uahMenu;
+    UAHDRAWMENUITEM menuItems[6];
+    DRAWITEMSTRUCT buttonItems[4];
+    WINDOWPOS move;
+    std::vector<replay_msg> messages;
+};
+
+inline void CreateSession(session& s) {
+    s.unity = standin::CreateWindow(L"UnityContainerWndClass", nullptr, WS_OVERLAPPEDWINDOW, L"Unity");
+    s.menu = standin::CreateMenu({ L"&File", L"&Edit", L"&Assets", L"&GameObject", L"&Component", L"&Window" });
+    standin::SetMenu(s.unity, s.menu);
+    standin::ShowWindow(s.unity);
+
+    s.dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW, L"Preferences");
+    for (HWND& button : s.buttons) button = standin::CreateWindow(L"Button", s.dialog, WS_CHILD | BS_PUSHBUTTON, L"OK");
+    s.checkbox = standin::CreateWindow(L"Button", s.dialog, WS_CHILD | BS_AUTOCHECKBOX, L"Enabled");
+    s.label = standin::CreateWindow(L"Static", s.dialog, WS_CHILD, L"Name");
+    s.listView = standin::CreateWindow(L"SysListView32", s.dialog, WS_CHILD);
+    s.treeView = standin::CreateWindow(L"SysTreeView32", s.dialog, WS_CHILD);
+    s.comboBox = standin::CreateWindow(L"ComboBox", s.dialog, WS_CHILD);
+    s.tooltip = standin::CreateWindow(L"tooltips_class32", nullptr, WS_POPUP);
+    for (HWND hWnd : { s.dialog, s.buttons[0], s.buttons[1], s.buttons[2], s.buttons[3], s.checkbox, s.label, s.listView, s.treeView, s.comboBox, s.tooltip }) {
+        standin::ShowWindow(hWnd);
+    }
+
+    s.hdc = GetWindowDC(s.unity);
+    s.uahMenu = { s.menu, s.hdc, 0x00000a00 };
+    for (int i = 0; i < 6; i++) {
+        UAHDRAWMENUITEM& item = s.menuItems[i];
+        item = {};
+        item.dis.CtlType = ODT_MENU;
+        item.dis.itemState = i == 2 ? ODS_HOTLIGHT : ODS_DEFAULT;
+        item.dis.hDC = s.hdc;
+        item.dis.rcItem = { 8 + i * 70, 31, 8 + (i + 1) * 70, 50 };
+        item.um = s.uahMenu;
+        item.umi.iPosition = i;
+    }
+    for (int i = 0; i < 4; i++) {
+        DRAWITEMSTRUCT& dis = s.buttonItems[i];
+        dis = {};
+        dis.CtlType = ODT_BUTTON;
+        dis.itemAction = ODA_DRAWENTIRE;
+        dis.itemState = i == 0 ? ODS_FOCUS : 0;
+        dis.hwndItem = s.buttons[i];
+        dis.hDC = s.hdc;
+        dis.rcItem = { 0, 0, 75, 23 };
+    }
+    s.move = { s.unity, nullptr, 120, 120, 0, 0, SWP_NOSIZE | SWP_NOZORDER };
+
+    // one frame of an editor with the mouse moving over the menu bar and the
+    // preferences dialog open next to it
+    auto& m = s.messages;
+    m.push_back({ s.unity, WM_NCACTIVATE, TRUE, 0 });
+    m.push_back({ s.unity, WM_NCPAINT, 1, 0 });
+    m.push_back({ s.unity, WM_UAHDRAWMENU, 0, (LPARAM)&s.uahMenu });
+    for (UAHDRAWMENUITEM& item : s.menuItems) m.push_back({ s.unity, WM_UAHDRAWMENUITEM, 0, (LPARAM)&item });
+    for (int i = 0; i < 4; i++) {
+        m.push_back({ s.unity, WM_SETCURSOR, (WPARAM)s.unity, HTCLIENT });
+        m.push_back({ s.unity, WM_MOUSEMOVE, 0, i * 8 });
+    }
+    m.push_back({ s.unity, WM_WINDOWPOSCHANGED, 0, (LPARAM)&s.move });
+    m.push_back({ s.unity, WM_ERASEBKGND, (WPARAM)s.hdc, 0 });
+    m.push_back({ s.dialog, WM_NCPAINT, 1, 0 });
+    m.push_back({ s.dialog, WM_CTLCOLORDLG, (WPARAM)s.hdc, (LPARAM)s.dialog });
+    m.push_back({ s.dialog, WM_CTLCOLORSTATIC, (WPARAM)s.hdc, (LPARAM)s.label });
+    m.push_back({ s.dialog, WM_ERASEBKGND, (WPARAM)s.hdc, 0 });
+    for (DRAWITEMSTRUCT& dis : s.buttonItems) m.push_back({ s.dialog, WM_DRAWITEM, 0, (LPARAM)&dis });
+    for (HWND button : s.buttons) m.push_back({ button, WM_MOUSEMOVE, 0, 0 });
+    m.push_back({ s.checkbox, WM_PAINT, 0, 0 });
+    m.push_back({ s.label, WM_PAINT, 0, 0 });
+    m.push_back({ s.listView, WM_PAINT, 0, 0 });
+    m.push_back({ s.listView, WM_MOUSEMOVE, 0, 0 });
+    m.push_back({ s.treeView, WM_PAINT, 0, 0 });
+    m.push_back({ s.treeView, WM_MOUSEMOVE, 0, 0 });
+    m.push_back({ s.comboBox, WM_CTLCOLORLISTBOX, (WPARAM)s.hdc, 0 });
+    m.push_back({ s.tooltip, WM_PAINT, 0, 0 });
+}
+
+// WM_CTLCOLORLISTBOX is only handled for the combo box's own list box
+inline void FixComboList(session& s) {
+    COMBOBOXINFO info = { sizeof(info) };
+    SendMessage(s.comboBox, CB_GETCOMBOBOXINFO, 0, (LPARAM)&info);
+    for (replay_msg& m : s.messages) {
+        if (m.msg == WM_CTLCOLORLISTBOX) m.lParam = (LPARAM)info.hwndList;
+    }
+}
+
+}
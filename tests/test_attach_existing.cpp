@@ -0,0 +1,116 @@
+// Windows that were created before the dll was loaded: they are found on
+// the loading thread, children included, and get what WM_NCCREATE would have
+// given them, within the discovery time budget.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+HWND g_unity;
+HWND g_tooltip;
+HWND g_unruled;
+HWND g_plain;
+HWND g_pushButton;
+HWND g_checkBox;
+HWND g_label;
+HWND g_slowButton;
+std::vector<HWND> g_lateButtons;
+
+HWND Create(const wchar_t* className, HWND parent, DWORD style) {
+    HWND hWnd = standin::CreateWindow(className, parent, style);
+    standin::ShowWindow(hWnd);
+    return hWnd;
+}
+
+// the attach summary AttachExistingWindows wrote last
+std::wstring AttachSummary() {
+    std::wstring summary;
+    for (const std::wstring& line : standin::DebugLog()) {
+        if (line.find(L" windows on thread ") != std::wstring::npos) summary = line;
+    }
+    return summary;
+}
+
+bool Contains(const std::wstring& text, const wchar_t* part) {
+    return text.find(part) != std::wstring::npos;
+}
+
+}
+
+TEST(load) {
+    g_unity = Create(L"UnityContainerWndClass", nullptr, WS_OVERLAPPEDWINDOW);
+    g_tooltip = Create(L"tooltips_class32", nullptr, WS_POPUP);
+    g_unruled = Create(L"Static", nullptr, WS_OVERLAPPEDWINDOW);
+    g_plain = Create(L"PlainToolWindow", nullptr, WS_OVERLAPPEDWINDOW);
+    HWND dialog = Create(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    g_pushButton = Create(L"Button", dialog, WS_CHILD | BS_PUSHBUTTON);
+    g_checkBox = Create(L"Button", dialog, WS_CHILD | BS_AUTOCHECKBOX);
+    g_label = Create(L"Static", dialog, WS_CHILD);
+
+    // a dialog whose first button takes longer to restyle than the whole
+    // budget; the buttons after it are left for another time
+    HWND slowDialog = Create(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    g_slowButton = Create(L"Button", slowDialog, WS_CHILD | BS_PUSHBUTTON);
+    standin::SetWindowProc(g_slowButton, [](HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+        if (uMsg == WM_STYLECHANGED) standin::AdvanceTicks(2 * (ULONGLONG)WINDOW_DISCOVERY_BUDGET_MS);
+        return standin::DefaultWindowProc(hWnd, uMsg, wParam, lParam);
+    });
+    for (int i = 0; i < 3; i++) g_lateButtons.push_back(Create(L"Button", slowDialog, WS_CHILD | BS_PUSHBUTTON));
+
+    editor::LoadDll("[rules]\nPlainToolWindow = subclass\n");
+    CHECK(editor::WindowState(g_unity) != nullptr);
+}
+
+TEST(top_level_tooltips_get_their_style) {
+    CHECK(editor::WindowState(g_tooltip) != nullptr);
+    CHECK(standin::HasWindowTheme(g_tooltip));
+    CHECK(standin::Invalidations(g_tooltip) > 0);
+}
+
+TEST(top_level_windows_follow_their_rules) {
+    DWORD dark = 0;
+    CHECK(standin::GetDwmAttribute(g_unity, DWMWA_USE_IMMERSIVE_DARK_MODE, dark) && dark);
+
+    // no rule, nothing at all; subclass without darkmode, no dark frame
+    CHECK(editor::WindowState(g_unruled) == nullptr);
+    CHECK(!standin::GetDwmAttribute(g_unruled, DWMWA_USE_IMMERSIVE_DARK_MODE, dark));
+    CHECK(editor::WindowState(g_plain) != nullptr);
+    CHECK(!standin::GetDwmAttribute(g_plain, DWMWA_USE_IMMERSIVE_DARK_MODE, dark));
+}
+
+TEST(children_catch_up_on_their_style) {
+    CHECK(editor::WindowState(g_pushButton) != nullptr);
+    CHECK((GetWindowLongPtr(g_pushButton, GWL_STYLE) & BS_TYPEMASK) == BS_OWNERDRAW);
+    CHECK(standin::HasWindowTheme(g_checkBox));
+    CHECK(editor::WindowState(g_label) == nullptr);
+}
+
+TEST(the_budget_covers_attaching) {
+    CHECK(editor::WindowState(g_slowButton) != nullptr);
+    for (HWND hWnd : g_lateButtons) {
+        CHECK(editor::WindowState(hWnd) == nullptr);
+        CHECK((GetWindowLongPtr(hWnd, GWL_STYLE) & BS_TYPEMASK) == BS_PUSHBUTTON);
+    }
+
+    const std::wstring summary = AttachSummary();
+    CHECK(Contains(summary, L"found 13 windows"));
+    CHECK(Contains(summary, L"subclassed 8 "));
+    CHECK(Contains(summary, L"(time budget exceeded)"));
+}
+
+TEST(only_windows_attached_are_counted) {
+    // everything found now is attached already, or left alone by the rules
+    for (HWND hWnd : g_lateButtons) standin::DestroyWindow(hWnd);
+    AttachExistingWindows();
+    CHECK(Contains(AttachSummary(), L"subclassed 0 "));
+}
+
+TEST(unload) {
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,143 @@
+// The per-thread DPI resource sets: at most MAX_DPI_RESOURCE_SETS of them,
+// the least recently used one is rebuilt for a new DPI, and a window whose
+// set went to another DPI, or that moved to another DPI, gets the right one
+// again on its next draw.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+#include <set>
+
+namespace {
+
+HWND g_dialog;
+
+ULONGLONG SetsBuilt() {
+    dm_stats stats = { sizeof(stats) };
+    UnityEditorDarkMode_GetStats(&stats);
+    return stats.counters[(int)StatCounter::DpiResourceSetsBuilt];
+}
+
+std::set<UINT> SetDpis() {
+    std::set<UINT> dpis;
+    for (const dpi_resources& set : GetUiThread()->dpiResources) {
+        if (set.dpi) dpis.insert(set.dpi);
+    }
+    return dpis;
+}
+
+dpi_resources& Get(UINT dpi) {
+    return GetDpiResources(*GetUiThread(), dpi);
+}
+
+LONG DpiObjectsHeld() {
+    dm_watchdog watchdog = { sizeof(watchdog) };
+    UnityEditorDarkMode_GetWatchdog(&watchdog);
+    return watchdog.created[(int)GdiPath::DpiResources] - watchdog.released[(int)GdiPath::DpiResources];
+}
+
+dpi_resources& WindowSet(HWND hWnd) {
+    return GetWindowDpiResources(hWnd, editor::WindowState(hWnd));
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll();
+    g_dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    standin::ShowWindow(g_dialog);
+    CHECK(editor::WindowState(g_dialog) != nullptr);
+    CHECK(GetUiThread() != nullptr);
+}
+
+TEST(a_set_per_dpi_built_once) {
+    const ULONGLONG built = SetsBuilt();
+    dpi_resources& set = Get(96);
+    CHECK(set.dpi == 96);
+    CHECK(set.messageFont != nullptr);
+    CHECK(set.borderWidth == 1);
+    CHECK(&Get(96) == &set);
+    CHECK(SetsBuilt() == built + 1);
+
+    CHECK(Get(192).borderWidth == 2);
+    CHECK(Get(960).borderWidth == MAX_BUTTON_BORDER_WIDTH);
+    CHECK(Get(120).dpi == 120);
+    CHECK(SetDpis() == std::set<UINT>({ 96, 120, 192, 960 }));
+    CHECK(SetsBuilt() == built + 4);
+}
+
+TEST(the_least_recently_used_set_goes) {
+    Get(96);
+    Get(120);
+    Get(960);
+
+    // 192 was used longest ago
+    HFONT font96 = Get(96).messageFont;
+    Get(144);
+    CHECK(SetDpis() == std::set<UINT>({ 96, 120, 144, 960 }));
+    CHECK(Get(96).messageFont == font96);
+
+    // then 120
+    Get(240);
+    CHECK(SetDpis() == std::set<UINT>({ 96, 144, 240, 960 }));
+}
+
+TEST(sets_are_capped) {
+    const LONG held = DpiObjectsHeld();
+    const LONG live = standin::LiveGdiObjects();
+    for (int round = 0; round < 4; round++) {
+        for (UINT dpi = 96; dpi <= 480; dpi += 24) {
+            GetMenuTheme(Get(dpi), g_dialog);
+        }
+    }
+    CHECK(SetDpis().size() == MAX_DPI_RESOURCE_SETS);
+
+    // a font and a menu theme per set at most, whatever was built and
+    // released on the way
+    CHECK(DpiObjectsHeld() <= 2 * MAX_DPI_RESOURCE_SETS);
+    CHECK(DpiObjectsHeld() >= held);
+    CHECK(standin::LiveGdiObjects() <= live + MAX_DPI_RESOURCE_SETS);
+    CHECK(standin::LiveThemeHandles() <= MAX_DPI_RESOURCE_SETS + 1);
+}
+
+TEST(windows_get_their_set_back_after_it_went_to_another_dpi) {
+    standin::SetWindowDpi(g_dialog, 96);
+    SendMessage(g_dialog, WM_DPICHANGED_AFTERPARENT, 0, 0);
+    CHECK(WindowSet(g_dialog).dpi == 96);
+
+    for (UINT dpi : { 120u, 144u, 168u, 192u }) Get(dpi);
+    CHECK(!SetDpis().count(96));
+
+    const ULONGLONG built = SetsBuilt();
+    CHECK(WindowSet(g_dialog).dpi == 96);
+    CHECK(SetsBuilt() == built + 1);
+}
+
+TEST(rebuilt_after_wm_dpichanged) {
+    RECT suggested = { 0, 0, 800, 600 };
+    standin::SetWindowDpi(g_dialog, 144);
+    SendMessage(g_dialog, WM_DPICHANGED, MAKEWPARAM(144, 144), (LPARAM)&suggested);
+    CHECK(editor::WindowState(g_dialog)->dpi == 144);
+
+    dpi_resources& set = WindowSet(g_dialog);
+    CHECK(set.dpi == 144);
+    CHECK(set.borderWidth == 2);
+
+    // and again when it moves on, at the cost of one set at most
+    const ULONGLONG built = SetsBuilt();
+    standin::SetWindowDpi(g_dialog, 288);
+    SendMessage(g_dialog, WM_DPICHANGED, MAKEWPARAM(288, 288), (LPARAM)&suggested);
+    CHECK(WindowSet(g_dialog).dpi == 288);
+    CHECK(WindowSet(g_dialog).borderWidth == 3);
+    CHECK(SetsBuilt() <= built + 1);
+}
+
+TEST(unload_releases_every_set) {
+    CHECK(editor::UnloadDll());
+    CHECK(DpiObjectsHeld() == 0);
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,131 @@
+// Every GDI object, DC and theme handle the dll creates is deleted again:
+// painting reuses what the theme's cache holds, a theme reload deletes what
+// the snapshot it replaced created once its grace period is over, and after
+// the unload the stand-in's creates and deletes balance exactly, with no
+// delete of a handle that wasn't live.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+std::string g_ini;
+HWND g_unity;
+HMENU g_menu;
+HWND g_dialog;
+HWND g_button;
+HDC g_hdc;
+
+void DrawMenuBar() {
+    UAHMENU menu = { g_menu, g_hdc, 0x00000a00 };
+    SendMessage(g_unity, WM_UAHDRAWMENU, 0, (LPARAM)&menu);
+    for (int i = 0; i < 2; i++) {
+        UAHDRAWMENUITEM item = {};
+        item.dis.CtlType = ODT_MENU;
+        item.dis.hDC = g_hdc;
+        item.dis.rcItem = { 8 + i * 60, 31, 8 + (i + 1) * 60, 50 };
+        item.um = menu;
+        item.umi.iPosition = i;
+        SendMessage(g_unity, WM_UAHDRAWMENUITEM, 0, (LPARAM)&item);
+    }
+}
+
+void DrawButton() {
+    HDC hdc = GetWindowDC(g_dialog);
+    DRAWITEMSTRUCT dis = {};
+    dis.CtlType = ODT_BUTTON;
+    dis.itemAction = ODA_DRAWENTIRE;
+    dis.hwndItem = g_button;
+    dis.hDC = hdc;
+    dis.rcItem = { 0, 0, 75, 23 };
+    SendMessage(g_dialog, WM_DRAWITEM, 0, (LPARAM)&dis);
+    ReleaseDC(g_dialog, hdc);
+}
+
+// a paint of everything that draws with the theme's objects
+void Paint() {
+    DrawMenuBar();
+    DrawButton();
+    SendMessage(g_dialog, WM_CTLCOLORDLG, (WPARAM)g_hdc, (LPARAM)g_dialog);
+    SendMessage(g_dialog, WM_CTLCOLOREDIT, (WPARAM)g_hdc, 0);
+    SendMessage(g_dialog, WM_CTLCOLORSTATIC, (WPARAM)g_hdc, 0);
+}
+
+// rewrites the ini and waits for the watcher to publish it
+bool ChangeTheme(std::string_view text) {
+    const theme_cfg* before = g_theme.load();
+    standin::WriteTextFile(g_ini, text);
+    return standin::PumpUntil([before] { return g_theme.load() != before; }, 5000);
+}
+
+}
+
+TEST(load) {
+    CHECK(standin::GdiCounts().created == 0);
+    g_ini = editor::LoadDll("menubar_bgcolor = 48,48,48\n") + "/UnityEditorDarkMode.dll.ini";
+    g_unity = standin::CreateWindow(L"UnityContainerWndClass", nullptr, WS_OVERLAPPEDWINDOW, L"Unity");
+    g_menu = standin::CreateMenu({ L"&File", L"&Edit" });
+    standin::SetMenu(g_unity, g_menu);
+    standin::ShowWindow(g_unity);
+    g_dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    g_button = standin::CreateWindow(L"Button", g_dialog, WS_CHILD | BS_PUSHBUTTON, L"OK");
+    standin::ShowWindow(g_dialog);
+    standin::ShowWindow(g_button);
+    g_hdc = GetWindowDC(g_unity);
+
+    // the watcher has taken note of the ini once it waits for changes
+    CHECK(standin::PumpUntil([] { return standin::ApiCalls("WaitForMultipleObjects") != 0; }, 5000));
+}
+
+TEST(painting_again_creates_nothing) {
+    Paint();
+    const standin::gdi_counts counts = standin::GdiCounts();
+    for (int i = 0; i < 10; i++) Paint();
+
+    // the button's DC is the only thing made and given back per paint
+    const standin::gdi_counts after = standin::GdiCounts();
+    CHECK(after.created - counts.created == 10);
+    CHECK(after.deleted - counts.deleted == 10);
+    CHECK(after.badDeletes == 0);
+}
+
+TEST(a_reload_deletes_what_the_replaced_theme_created) {
+    // a reload keeps the snapshot it replaced for the grace period, so that
+    // two are alive from the second one on
+    const LONG live = standin::LiveGdiObjects();
+    CHECK(ChangeTheme("menubar_bgcolor = 30,30,30\n"));
+    standin::AdvanceTicks(THEME_RETIRE_MS);
+    CHECK(ChangeTheme("menubar_bgcolor = 20,30,30\n"));
+    Paint();
+    CHECK(g_retiredThemes.size() == 1);
+    const LONG steady = standin::LiveGdiObjects();
+    CHECK(steady > live);
+
+    // from then on each reload deletes as much as it creates
+    for (int color : { 10, 40, 50 }) {
+        const standin::gdi_counts counts = standin::GdiCounts();
+        standin::AdvanceTicks(THEME_RETIRE_MS);
+        CHECK(ChangeTheme("menubar_bgcolor = " + std::to_string(color) + ",30,30\n"));
+        Paint();
+        CHECK(g_retiredThemes.size() == 1);
+        CHECK(standin::LiveGdiObjects() == steady);
+        CHECK(standin::GdiCounts().created > counts.created);
+    }
+    CHECK(standin::GdiCounts().badDeletes == 0);
+}
+
+TEST(unload_leaves_nothing_behind) {
+    ReleaseDC(g_unity, g_hdc);
+    CHECK(editor::UnloadDll());
+
+    const standin::gdi_counts counts = standin::GdiCounts();
+    CHECK(counts.created == counts.deleted);
+    CHECK(counts.badDeletes == 0);
+    CHECK(standin::LiveGdiObjects() == 0);
+    CHECK(standin::LiveThemeHandles() == 0);
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,126 @@
+// The init stages: DllMain only hooks the loading thread and posts itself
+// INIT_PROCESS_MESSAGE_TAG, the stages then run in order from its message
+// loop. Where the post or the hook fails they run inline instead, and a
+// stage that leaves the dll detaching stops the rest. Each test sets up
+// the process differently, so each is run in a process of its own.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// an older build that neither speaks our handoff version nor lets go
+const HMODULE g_previous = (HMODULE)0x190000000ull;
+
+BOOL WINAPI StuckUnload() {
+    return FALSE;
+}
+
+// the stages in the order RunInitStages reported them
+std::vector<std::wstring> StagesRun() {
+    constexpr std::wstring_view prefix = L"UnityEditorDarkMode: ";
+    std::vector<std::wstring> stages;
+    for (const std::wstring& line : standin::DebugLog()) {
+        const size_t took = line.find(L" took ");
+        if (line.starts_with(prefix) && took != std::wstring::npos) {
+            stages.push_back(line.substr(prefix.size(), took - prefix.size()));
+        }
+    }
+    return stages;
+}
+
+std::vector<std::wstring> FirstStages(size_t count) {
+    std::vector<std::wstring> stages;
+    for (size_t i = 0; i < count && i < ARRAYSIZE(g_initStages); i++) {
+        const std::string name = g_initStages[i].name;
+        stages.emplace_back(name.begin(), name.end());
+    }
+    return stages;
+}
+
+// DllMain as the loader calls it, without the message loop editor::LoadDll
+// runs right after
+void AttachDll() {
+    standin::SetDllPath(standin::MakeTempDir() + "/UnityEditorDarkMode.dll");
+    standin::SetDllMain(DllMain);
+    DllMain(standin::DllModule(), DLL_PROCESS_ATTACH, nullptr);
+}
+
+}
+
+TEST(stages_run_in_order_from_the_message_loop) {
+    AttachDll();
+    CHECK(StagesRun().empty());
+    CHECK(standin::QueuedMessages(GetCurrentThreadId()) == 1);
+
+    standin::PumpMessages();
+    CHECK(StagesRun() == FirstStages(ARRAYSIZE(g_initStages)));
+    CHECK(GetUiThread() && GetUiThread()->initialized);
+
+    // only once
+    PostThreadTag(GetCurrentThreadId(), INIT_PROCESS_MESSAGE_TAG);
+    standin::PumpMessages();
+    CHECK(StagesRun().size() == ARRAYSIZE(g_initStages));
+    CHECK(editor::UnloadDll());
+}
+
+TEST(stages_run_inline_when_the_post_fails) {
+    standin::FailApi("PostThreadMessage");
+    AttachDll();
+    standin::FailApi("PostThreadMessage", false);
+
+    CHECK(StagesRun() == FirstStages(ARRAYSIZE(g_initStages)));
+    CHECK(GetUiThread() && GetUiThread()->initialized);
+    CHECK(standin::QueuedMessages(GetCurrentThreadId()) == 0);
+    CHECK(g_theme.load() != nullptr);
+    CHECK(editor::UnloadDll());
+}
+
+TEST(stages_run_inline_without_a_message_hook) {
+    standin::FailApi("SetWindowsHookEx");
+    AttachDll();
+    standin::FailApi("SetWindowsHookEx", false);
+
+    CHECK(StagesRun() == FirstStages(ARRAYSIZE(g_initStages)));
+    CHECK(standin::QueuedMessages(GetCurrentThreadId()) == 0);
+    CHECK(g_theme.load() != nullptr);
+    CHECK(editor::UnloadDll());
+}
+
+TEST(a_stage_that_fails_stops_the_rest) {
+    WCHAR name[64];
+    swprintf_s(name, L"Local\\UnityEditorDarkMode.Instance.%lu", GetCurrentProcessId());
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(instance_record), name);
+    auto record = (instance_record*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(instance_record));
+    record->magic = 0x49444555; // "UEDI"
+    record->module = g_previous;
+    standin::RegisterModule(g_previous, { { "UnityEditorDarkMode_Unload", (FARPROC)StuckUnload } });
+
+    AttachDll();
+    standin::PumpMessages();
+
+    // the takeover is reported, nothing after it runs
+    CHECK(g_initStages[1].run == TakeOverInstance);
+    CHECK(StagesRun() == FirstStages(2));
+    CHECK(g_detaching);
+    CHECK(g_theme.load() == nullptr);
+    CHECK(g_themeWatcher == nullptr);
+    CHECK(standin::AppMode() == (int)PreferredAppMode::Default);
+
+    CHECK(editor::UnloadDll());
+    UnmapViewOfFile(record);
+    CloseHandle(mapping);
+    standin::UnregisterModule(g_previous);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: test_init_stages <test>\n");
+        return 2;
+    }
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,201 @@
+// The menu bar we draw: labels are read once per item and again after the
+// menu changed, items are only rendered when their look changes, and the
+// bar's geometry and off-screen surface are kept until the window is
+// resized, its DPI changes or its frame does.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+HWND g_unity;
+HMENU g_menu;
+HDC g_hdc;
+const std::vector<std::wstring> g_labels = { L"&File", L"&Edit", L"&Assets", L"&Window" };
+
+// one WM_UAHDRAWMENU and a WM_UAHDRAWMENUITEM per item, as for a paint of
+// the bar; item rectangles are in window coordinates, within the stand-in's bar
+void DrawMenuBar(UINT itemState = ODS_DEFAULT) {
+    UAHMENU menu = { g_menu, g_hdc, 0x00000a00 };
+    SendMessage(g_unity, WM_UAHDRAWMENU, 0, (LPARAM)&menu);
+    for (int i = 0; i < (int)g_labels.size(); i++) {
+        UAHDRAWMENUITEM item = {};
+        item.dis.CtlType = ODT_MENU;
+        item.dis.itemState = itemState;
+        item.dis.hDC = g_hdc;
+        item.dis.rcItem = { 8 + i * 60, 31, 8 + (i + 1) * 60, 50 };
+        item.um = menu;
+        item.umi.iPosition = i;
+        SendMessage(g_unity, WM_UAHDRAWMENUITEM, 0, (LPARAM)&item);
+    }
+}
+
+ULONGLONG Counter(StatCounter counter) {
+    dm_stats stats = { sizeof(stats) };
+    UnityEditorDarkMode_GetStats(&stats);
+    return stats.counters[(int)counter];
+}
+
+const std::wstring& CachedLabel(int position) {
+    return editor::WindowState(g_unity)->menuLabels.labels[position].second;
+}
+
+const menu_bar_surface& Surface() {
+    return editor::WindowState(g_unity)->menuBar;
+}
+
+void SendPosChanged(const RECT& rc, UINT flags) {
+    WINDOWPOS pos = { g_unity, nullptr, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, flags | SWP_NOZORDER };
+    SendMessage(g_unity, WM_WINDOWPOSCHANGED, 0, (LPARAM)&pos);
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll();
+    g_unity = standin::CreateWindow(L"UnityContainerWndClass", nullptr, WS_OVERLAPPEDWINDOW, L"Unity");
+    g_menu = standin::CreateMenu(g_labels);
+    standin::SetMenu(g_unity, g_menu);
+    standin::ShowWindow(g_unity);
+    g_hdc = GetWindowDC(g_unity);
+    CHECK(editor::WindowState(g_unity) != nullptr);
+}
+
+TEST(labels_are_read_once) {
+    DrawMenuBar();
+    CHECK(Counter(StatCounter::MenuLabelMisses) == g_labels.size());
+    CHECK(Counter(StatCounter::MenuLabelHits) == 0);
+
+    standin::ResetApiCalls();
+    DrawMenuBar(ODS_HOTLIGHT);
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuItemInfo") == 0);
+    CHECK(Counter(StatCounter::MenuLabelMisses) == g_labels.size());
+    CHECK(Counter(StatCounter::MenuLabelHits) == 2 * g_labels.size());
+    CHECK(CachedLabel(1) == L"&Edit");
+}
+
+TEST(draw_menu_bar_rereads_the_labels) {
+    // an application changing a label in place and calling DrawMenuBar,
+    // which reaches the window as a frame change
+    standin::SetMenuItemText(g_menu, 1, L"&Edit (Safe Mode)");
+    WINDOWPOS pos = { g_unity, nullptr, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_FRAMECHANGED };
+    SendMessage(g_unity, WM_WINDOWPOSCHANGED, 0, (LPARAM)&pos);
+
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuItemInfo") == g_labels.size());
+    CHECK(CachedLabel(1) == L"&Edit (Safe Mode)");
+}
+
+TEST(moves_keep_the_labels) {
+    WINDOWPOS pos = { g_unity, nullptr, 40, 40, 0, 0, SWP_NOSIZE | SWP_NOZORDER };
+    SendMessage(g_unity, WM_WINDOWPOSCHANGED, 0, (LPARAM)&pos);
+
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuItemInfo") == 0);
+    CHECK(standin::ApiCalls("GetMenuBarInfo") == 0);
+}
+
+TEST(paints_keep_the_geometry_and_the_surface) {
+    const HDC surface = Surface().hdc;
+    CHECK(surface != nullptr);
+
+    standin::ResetApiCalls();
+    const ULONGLONG misses = Counter(StatCounter::NcGeometryMisses);
+    DrawMenuBar();
+    SendMessage(g_unity, WM_NCPAINT, 1, 0);
+    SendMessage(g_unity, WM_NCACTIVATE, TRUE, 0);
+    CHECK(standin::ApiCalls("GetMenuBarInfo") == 0);
+    CHECK(standin::ApiCalls("GetWindowRect") == 0);
+    CHECK(standin::ApiCalls("CreateCompatibleBitmap") == 0);
+    CHECK(Counter(StatCounter::NcGeometryMisses) == misses);
+    CHECK(Surface().hdc == surface);
+}
+
+TEST(wm_size_rebuilds_the_geometry_and_the_surface) {
+    // the stand-in's bar is the window's width less 8 on either side
+    const RECT rc = { 100, 100, 1300, 800 };
+    standin::SetWindowRect(g_unity, rc);
+    SendMessage(g_unity, WM_SIZE, SIZE_RESTORED, MAKELPARAM(1200, 700));
+
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuBarInfo") == 1);
+    CHECK(standin::ApiCalls("CreateCompatibleBitmap") == 1);
+    CHECK(Surface().size.cx == 1200 - 16);
+
+    // the labels are still good
+    CHECK(standin::ApiCalls("GetMenuItemInfo") == 0);
+}
+
+TEST(resizing_position_changes_rebuild_them_too) {
+    const RECT rc = { 100, 100, 1100, 800 };
+    standin::SetWindowRect(g_unity, rc);
+    SendPosChanged(rc, SWP_NOMOVE);
+
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuBarInfo") == 1);
+    CHECK(standin::ApiCalls("CreateCompatibleBitmap") == 1);
+    CHECK(Surface().size.cx == 1000 - 16);
+}
+
+TEST(wm_dpichanged_rebuilds_them_at_the_new_dpi) {
+    RECT suggested = { 100, 100, 1100, 800 };
+    standin::SetWindowDpi(g_unity, 144);
+    SendMessage(g_unity, WM_DPICHANGED, MAKEWPARAM(144, 144), (LPARAM)&suggested);
+
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuBarInfo") == 1);
+    CHECK(standin::ApiCalls("CreateCompatibleBitmap") == 1);
+    CHECK(Surface().dpi == 144);
+    CHECK(Surface().size.cx == 1000 - 16);
+
+    standin::SetWindowDpi(g_unity, 96);
+    SendMessage(g_unity, WM_DPICHANGED, MAKEWPARAM(96, 96), (LPARAM)&suggested);
+    DrawMenuBar();
+    CHECK(Surface().dpi == 96);
+}
+
+TEST(frame_changes_rerender_every_item_on_the_same_surface) {
+    const HDC surface = Surface().hdc;
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("DrawThemeTextEx") == 0);
+
+    SendPosChanged({ 100, 100, 1100, 800 }, SWP_NOMOVE | SWP_NOSIZE | SWP_FRAMECHANGED);
+    CHECK(Surface().items.empty());
+
+    // same size and DPI, so the surface stays, cleared and drawn anew
+    standin::ResetApiCalls();
+    DrawMenuBar();
+    CHECK(standin::ApiCalls("GetMenuBarInfo") == 1);
+    CHECK(standin::ApiCalls("CreateCompatibleBitmap") == 0);
+    CHECK(standin::ApiCalls("DrawThemeTextEx") == g_labels.size());
+    CHECK(Surface().hdc == surface);
+}
+
+TEST(removed_items_are_cleared_from_the_bar) {
+    standin::RemoveMenuItem(g_menu, 3);
+    standin::ResetApiCalls();
+    WINDOWPOS pos = { g_unity, nullptr, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_FRAMECHANGED };
+    SendMessage(g_unity, WM_WINDOWPOSCHANGED, 0, (LPARAM)&pos);
+
+    // the whole surface is filled with the bar's background, nothing is left
+    // of the item that is gone once the bar is blitted again
+    CHECK(standin::ApiCalls("FillRect") == 1);
+    CHECK(editor::WindowState(g_unity)->menuBar.items.empty());
+}
+
+TEST(unload) {
+    ReleaseDC(g_unity, g_hdc);
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
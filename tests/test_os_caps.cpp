@@ -0,0 +1,123 @@
+// What the OS supports, by build and by the entry points the system modules
+// actually export: the private uxtheme ordinals, OpenThemeDataForDpi and the
+// DWM attributes are each used only where there, and the dll loads and
+// themes windows with any of them missing.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+os_caps Probe(DWORD build) {
+    standin::SetOsBuild(build);
+    return ProbeOsCaps();
+}
+
+}
+
+TEST(dwm_attributes_by_build) {
+    // Windows 10 1803 has neither
+    os_caps caps = Probe(17134);
+    CHECK(caps.build == 17134);
+    CHECK(caps.darkModeAttribute == 0);
+    CHECK(!caps.frameColors);
+
+    // 1809 to 1909 know the attribute by its pre-release number
+    caps = Probe(17763);
+    CHECK(caps.darkModeAttribute == DWMWA_USE_IMMERSIVE_DARK_MODE - 1);
+    caps = Probe(18363);
+    CHECK(caps.darkModeAttribute == DWMWA_USE_IMMERSIVE_DARK_MODE - 1);
+
+    caps = Probe(19041);
+    CHECK(caps.darkModeAttribute == DWMWA_USE_IMMERSIVE_DARK_MODE);
+    CHECK(!caps.frameColors);
+
+    caps = Probe(22000);
+    CHECK(caps.darkModeAttribute == DWMWA_USE_IMMERSIVE_DARK_MODE);
+    CHECK(caps.frameColors);
+}
+
+TEST(uxtheme_ordinals_by_build) {
+    // looked up from 1903 on only, the ordinals meant other things before
+    os_caps caps = Probe(17763);
+    CHECK(caps.SetPreferredAppMode == nullptr);
+    CHECK(caps.FlushMenuThemes == nullptr);
+
+    caps = Probe(18362);
+    CHECK(caps.SetPreferredAppMode != nullptr);
+    CHECK(caps.FlushMenuThemes != nullptr);
+}
+
+TEST(missing_uxtheme_ordinals) {
+    standin::SetSystemExport("uxtheme.dll", "#135", false);
+    os_caps caps = Probe(22631);
+    CHECK(caps.SetPreferredAppMode == nullptr);
+    CHECK(caps.FlushMenuThemes != nullptr);
+
+    standin::SetSystemExport("uxtheme.dll", "#136", false);
+    caps = Probe(22631);
+    CHECK(caps.FlushMenuThemes == nullptr);
+
+    // the rest doesn't depend on them
+    CHECK(caps.OpenThemeDataForDpi != nullptr);
+    CHECK(caps.darkModeAttribute == DWMWA_USE_IMMERSIVE_DARK_MODE);
+
+    standin::SetSystemExport("uxtheme.dll", "#135", true);
+    standin::SetSystemExport("uxtheme.dll", "#136", true);
+}
+
+TEST(missing_open_theme_data_for_dpi) {
+    standin::SetSystemExport("uxtheme.dll", "OpenThemeDataForDpi", false);
+    const os_caps caps = Probe(22631);
+    CHECK(caps.OpenThemeDataForDpi == nullptr);
+    CHECK(caps.SetPreferredAppMode != nullptr);
+    standin::SetSystemExport("uxtheme.dll", "OpenThemeDataForDpi", true);
+}
+
+TEST(missing_rtl_get_version) {
+    // taken for a build too old for anything
+    standin::SetSystemExport("ntdll.dll", "RtlGetVersion", false);
+    const os_caps caps = Probe(22631);
+    CHECK(caps.build == 0);
+    CHECK(caps.SetPreferredAppMode == nullptr);
+    CHECK(caps.darkModeAttribute == 0);
+    CHECK(!caps.frameColors);
+    standin::SetSystemExport("ntdll.dll", "RtlGetVersion", true);
+}
+
+// the caps the dll runs with are probed once, by its first init stage
+TEST(loads_without_the_ordinals_and_open_theme_data_for_dpi) {
+    standin::SetSystemExport("uxtheme.dll", "#135", false);
+    standin::SetSystemExport("uxtheme.dll", "#136", false);
+    standin::SetSystemExport("uxtheme.dll", "OpenThemeDataForDpi", false);
+    standin::SetOsBuild(18363);
+    editor::LoadDll();
+
+    HWND dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    standin::ShowWindow(dialog);
+    CHECK(editor::WindowState(dialog) != nullptr);
+    CHECK(standin::AppMode() == (int)PreferredAppMode::Default);
+
+    // the pre-release attribute, and no frame colors
+    DWORD value = 0;
+    CHECK(standin::GetDwmAttribute(dialog, DWMWA_USE_IMMERSIVE_DARK_MODE - 1, value) && value == TRUE);
+    CHECK(!standin::GetDwmAttribute(dialog, DWMWA_USE_IMMERSIVE_DARK_MODE, value));
+    CHECK(!standin::GetDwmAttribute(dialog, DWMWA_CAPTION_COLOR, value));
+
+    // menu theme data for the system DPI instead
+    standin::ResetApiCalls();
+    CHECK(GetMenuTheme(GetWindowDpiResources(dialog, editor::WindowState(dialog)), dialog) != nullptr);
+    CHECK(standin::ApiCalls("OpenThemeData") == 1);
+    CHECK(standin::ApiCalls("StandinOpenThemeDataForDpi") == 0);
+
+    // a theme change has no menu themes to flush
+    SendMessage(dialog, WM_THEMECHANGED, 0, 0);
+    CHECK(standin::MenuThemeFlushes() == 0);
+
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
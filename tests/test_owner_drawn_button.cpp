@@ -0,0 +1,91 @@
+// Owner-drawn push buttons: hovering one draws its hot look, which the system
+// never asks for on its own, and drawing at any DPI creates no GDI objects
+// beyond the button's cache strip and takes no locks.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+HWND g_dialog;
+HWND g_button;
+
+void DrawButton(UINT itemState = 0) {
+    HDC hdc = GetWindowDC(g_dialog);
+    DRAWITEMSTRUCT dis = {};
+    dis.CtlType = ODT_BUTTON;
+    dis.itemAction = ODA_DRAWENTIRE;
+    dis.itemState = itemState;
+    dis.hwndItem = g_button;
+    dis.hDC = hdc;
+    dis.rcItem = { 0, 0, 75, 23 };
+    SendMessage(g_dialog, WM_DRAWITEM, 0, (LPARAM)&dis);
+    ReleaseDC(g_dialog, hdc);
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll();
+    g_dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    g_button = standin::CreateWindow(L"Button", g_dialog, WS_CHILD | BS_PUSHBUTTON, L"OK");
+    standin::ShowWindow(g_dialog);
+    standin::ShowWindow(g_button);
+    CHECK((GetWindowLongPtr(g_button, GWL_STYLE) & BS_TYPEMASK) == BS_OWNERDRAW);
+}
+
+TEST(hovering_draws_the_hot_look) {
+    wnd_state* state = editor::WindowState(g_button);
+    CHECK(state != nullptr);
+    if (!state) return;
+
+    DrawButton();
+    CHECK(state->button.rendered[(int)ButtonVisual::Normal]);
+    CHECK(!state->button.rendered[(int)ButtonVisual::Hot]);
+
+    const int invalidations = standin::Invalidations(g_button);
+    SendMessage(g_button, WM_MOUSEMOVE, 0, (10 << 16) | 10);
+    SendMessage(g_button, WM_MOUSEMOVE, 0, (10 << 16) | 11);
+    CHECK(state->button.hot);
+    CHECK(standin::Invalidations(g_button) == invalidations + 1);
+    CHECK(standin::ApiCalls("TrackMouseEvent") == 1);
+
+    DrawButton();
+    CHECK(state->button.rendered[(int)ButtonVisual::Hot]);
+
+    standin::MouseLeave(g_button);
+    CHECK(!state->button.hot);
+    CHECK(standin::Invalidations(g_button) == invalidations + 2);
+}
+
+TEST(pressed_and_focused_win_over_hot) {
+    SendMessage(g_button, WM_MOUSEMOVE, 0, 0);
+    CHECK(GetButtonVisual(ODS_SELECTED | ODS_HOTLIGHT) == ButtonVisual::Pressed);
+    CHECK(GetButtonVisual(ODS_FOCUS | ODS_HOTLIGHT) == ButtonVisual::Focused);
+    standin::MouseLeave(g_button);
+}
+
+TEST(drawing_creates_no_pens_and_takes_no_locks) {
+    // the border pens of every width exist as soon as the theme does, and
+    // are looked up without a lock
+    for (UINT dpi : { 96u, 144u, 192u, 288u, 480u, 960u }) {
+        standin::SetWindowDpi(g_button, dpi);
+        SendMessage(g_button, WM_DPICHANGED_AFTERPARENT, 0, 0);
+        standin::ResetApiCalls();
+        DrawButton();
+        DrawButton(ODS_DISABLED);
+        CHECK(standin::ApiCalls("Rectangle") != 0);
+        CHECK(standin::ApiCalls("CreatePen") == 0);
+        CHECK(standin::ApiCalls("AcquireSRWLockShared") == 0);
+        CHECK(standin::ApiCalls("AcquireSRWLockExclusive") == 0);
+    }
+}
+
+TEST(unload) {
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,129 @@
+// Re-theming after a theme change: the UI thread's windows are handled from
+// its timer in slices of at most RETHEME_SLICE_MS, each tick picks up where
+// the last one stopped, and every root window is redrawn once, after the
+// last of its windows. QueryPerformanceCounter is stepped so that each
+// window takes a millisecond.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int DIALOGS = 3;
+constexpr int CONTROLS = 10;    // per dialog
+
+std::vector<HWND> g_dialogs;
+std::vector<HWND> g_controls;
+
+retheme_job& Job() {
+    return GetUiThread()->retheme;
+}
+
+// one tick of the job's timer, once it is due
+void Tick() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(USER_TIMER_MINIMUM + 1));
+    standin::PumpMessages();
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll();
+    for (int i = 0; i < DIALOGS; i++) {
+        HWND dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+        for (int j = 0; j < CONTROLS; j++) {
+            g_controls.push_back(standin::CreateWindow(L"Button", dialog, WS_CHILD | BS_PUSHBUTTON));
+            standin::ShowWindow(g_controls.back());
+        }
+        standin::ShowWindow(dialog);
+        g_dialogs.push_back(dialog);
+    }
+    CHECK(GetUiThread()->windows.size() == DIALOGS * (CONTROLS + 1));
+}
+
+TEST(nothing_happens_before_the_first_tick) {
+    PostRetheme();
+    standin::PumpMessages();
+
+    CHECK(Job().timer != 0);
+    CHECK(Job().queue.size() == DIALOGS * (CONTROLS + 1));
+    CHECK(Job().next == 0);
+    CHECK(Job().slices == 0);
+
+    // grouped by root
+    for (size_t i = 1; i < Job().queue.size(); i++) {
+        CHECK(Job().queue[i - 1].root <= Job().queue[i].root);
+    }
+}
+
+TEST(each_tick_handles_a_slice_and_resumes_after_it) {
+    standin::SetPerformanceCounterStep(1.0);
+    std::vector<int> invalidations;
+    for (HWND dialog : g_dialogs) invalidations.push_back(standin::Invalidations(dialog));
+
+    const size_t windows = Job().queue.size();
+    size_t done = 0;
+    ULONG ticks = 0;
+    while (Job().timer && ticks < windows) {
+        Tick();
+        ticks++;
+        if (!Job().timer) break;
+
+        // a slice's worth, never none, and from where the last one stopped
+        CHECK(Job().slices == ticks);
+        CHECK(Job().next > done);
+        CHECK(Job().next - done <= (size_t)RETHEME_SLICE_MS);
+        done = Job().next;
+
+        // roots are redrawn once all of their windows are done
+        for (size_t i = 0; i < g_dialogs.size(); i++) {
+            const size_t last = (i + 1) * (CONTROLS + 1);
+            CHECK(standin::Invalidations(g_dialogs[i]) == invalidations[i] + (done >= last ? 1 : 0));
+        }
+    }
+    standin::SetPerformanceCounterStep(0);
+
+    // the whole job took several ticks, and is gone once done
+    CHECK(ticks >= windows / (size_t)RETHEME_SLICE_MS);
+    CHECK(Job().timer == 0);
+    CHECK(Job().queue.empty());
+    for (size_t i = 0; i < g_dialogs.size(); i++) {
+        CHECK(standin::Invalidations(g_dialogs[i]) == invalidations[i] + 1);
+    }
+
+    bool reported = false;
+    for (const std::wstring& line : standin::DebugLog()) {
+        reported |= line.starts_with(L"UnityEditorDarkMode: re-themed 33 windows with 3 redraws in ");
+    }
+    CHECK(reported);
+}
+
+TEST(a_theme_change_while_a_job_runs_starts_it_over) {
+    standin::SetPerformanceCounterStep(1.0);
+    PostRetheme();
+    standin::PumpMessages();
+    Tick();
+    CHECK(Job().next != 0);
+    const UINT_PTR timer = Job().timer;
+
+    PostRetheme();
+    standin::PumpMessages();
+    CHECK(Job().next == 0);
+    CHECK(Job().slices == 0);
+    CHECK(Job().timer == timer);
+    standin::SetPerformanceCounterStep(0);
+
+    CHECK(standin::PumpUntil([] { return Job().timer == 0; }, 5000));
+}
+
+TEST(unload) {
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,110 @@
+// The theme shared between editors loading the same ini: any editor may
+// publish it, so a section left behind by an editor that is gone, or that
+// died while parsing, is taken over without waiting, while one that is
+// parsing right now is given the time to publish. The test plays the other
+// editor through its own view of the section.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+#include <memory>
+
+namespace {
+
+std::string g_dir;
+std::string g_ini;
+shared_theme* g_other;
+
+shared_theme* MapSection(const std::string& ini) {
+    WCHAR name[64];
+    GetSharedThemeName(CStringW(standin::WindowsPath(ini).c_str()), name);
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(shared_theme), name);
+    return mapping ? (shared_theme*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(shared_theme)) : nullptr;
+}
+
+COLORREF SharedBackground() {
+    auto cfg = std::make_unique<theme_cfg>();
+    ApplyThemeCache(*cfg, g_other->theme);
+    return cfg->menubar_bgcolor;
+}
+
+COLORREF LoadedBackground() {
+    theme_reader reader;
+    return LoadThemeConfig()->menubar_bgcolor;
+}
+
+// publishes the ini as it is now with another background, as the other
+// editor would
+void PublishFromOtherEditor(COLORREF background) {
+    WIN32_FILE_ATTRIBUTE_DATA source = {};
+    GetFileAttributesExW(standin::WindowsPath(g_ini).c_str(), GetFileExInfoStandard, &source);
+    auto cfg = std::make_unique<theme_cfg>();
+    SetDefaultThemeConfig(*cfg);
+    cfg->menubar_bgcolor = background;
+    const theme_cache cache = MakeThemeCache(*cfg, source);
+
+    const ULONG seq = g_other->seq.fetch_add(1) + 1;
+    memcpy(&g_other->theme, &cache, sizeof(cache));
+    g_other->magic = SHARED_THEME_MAGIC;
+    g_other->version = SHARED_THEME_VERSION;
+    g_other->size = sizeof(shared_theme);
+    g_other->seq.store(seq + 1);
+}
+
+}
+
+TEST(abandoned_sections_are_taken_over) {
+    g_dir = standin::MakeTempDir();
+    g_ini = g_dir + "/UnityEditorDarkMode.dll.ini";
+    g_other = MapSection(g_ini);
+    CHECK(g_other != nullptr);
+    if (!g_other) return;
+
+    // an editor that died while parsing, and never published
+    g_other->parseDeadline = GetTickCount64() - 1;
+
+    editor::LoadDll("menubar_bgcolor = 48,48,48\n", g_dir);
+    CHECK(standin::ApiCalls("Sleep") == 0);
+    CHECK(g_other->seq == 2);
+    CHECK(g_other->parseDeadline == 0);
+    CHECK(SharedBackground() == RGB(48, 48, 48));
+    CHECK(LoadedBackground() == RGB(48, 48, 48));
+}
+
+TEST(updates_from_other_editors_are_picked_up) {
+    PublishFromOtherEditor(RGB(10, 20, 30));
+    CHECK(standin::PumpUntil([] { return LoadedBackground() == RGB(10, 20, 30); }, 5000));
+
+    // copied, not published again
+    CHECK(g_other->seq == 4);
+}
+
+TEST(editors_parsing_the_ini_are_waited_for) {
+    // the watcher has taken note of the ini once it waits for changes
+    CHECK(standin::PumpUntil([] { return standin::ApiCalls("WaitForMultipleObjects") != 0; }, 5000));
+
+    // the other editor claims the new ini before our watcher gets to it,
+    // which then waits for it to publish instead of parsing
+    g_other->parseDeadline = GetTickCount64() + 10000;
+    const unsigned long long sleeps = standin::ApiCalls("Sleep");
+    standin::WriteTextFile(g_ini, "menubar_bgcolor = 60,60,60\n");
+    CHECK(standin::PumpUntil([sleeps] { return standin::ApiCalls("Sleep") > sleeps + 2; }, 5000));
+
+    PublishFromOtherEditor(RGB(70, 70, 70));
+    g_other->parseDeadline = 0;
+    CHECK(standin::PumpUntil([] { return LoadedBackground() == RGB(70, 70, 70); }, 5000));
+    CHECK(g_other->seq == 6);
+}
+
+TEST(unload) {
+    CHECK(editor::UnloadDll());
+    CHECK(g_sharedTheme.load() == nullptr);
+
+    // the section lives on for the other editor
+    CHECK(SharedBackground() == RGB(70, 70, 70));
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,69 @@
+// Taking over from an instance that is already running: the windows created
+// before the takeover are left to it, and one that won't unload keeps its
+// windows while the new one stays out of the way, instead of both
+// subclassing the same windows.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+// an older build that neither speaks our handoff version nor lets go
+const HMODULE g_previous = (HMODULE)0x190000000ull;
+int g_unloadCalls = 0;
+
+HANDLE g_mapping;
+instance_record* g_record;
+HWND g_dialog;
+HWND g_early;   // created between DllMain and the init stages
+
+BOOL WINAPI StuckUnload() {
+    g_unloadCalls++;
+    return FALSE;
+}
+
+}
+
+TEST(windows_created_before_the_takeover_are_left_to_it) {
+    WCHAR name[64];
+    swprintf_s(name, L"Local\\UnityEditorDarkMode.Instance.%lu", GetCurrentProcessId());
+    g_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(instance_record), name);
+    g_record = (instance_record*)MapViewOfFile(g_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(instance_record));
+    g_record->magic = 0x49444555; // "UEDI"
+    g_record->module = g_previous;
+    standin::RegisterModule(g_previous, { { "UnityEditorDarkMode_Unload", (FARPROC)StuckUnload } });
+
+    g_dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    standin::SetDllPath(standin::MakeTempDir() + "/UnityEditorDarkMode.dll");
+    standin::SetDllMain(DllMain);
+    DllMain(standin::DllModule(), DLL_PROCESS_ATTACH, nullptr);
+
+    // our CBTProc is in place, the init stages haven't run yet
+    CHECK(standin::HookCount(GetCurrentThreadId(), WH_CBT) == 1);
+    g_early = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    CHECK(editor::WindowState(g_early) == nullptr);
+    CHECK(!g_attachNew);
+}
+
+TEST(an_instance_that_wont_unload_is_left_alone) {
+    standin::PumpMessages();
+    CHECK(g_unloadCalls == TAKEOVER_UNLOAD_ATTEMPTS);
+    CHECK(g_detaching);
+    CHECK(!g_attachNew);
+    CHECK(editor::WindowState(g_dialog) == nullptr);
+    CHECK(editor::WindowState(g_early) == nullptr);
+    CHECK(standin::AppMode() == (int)PreferredAppMode::Default);
+
+    HWND button = standin::CreateWindow(L"Button", g_dialog, WS_CHILD | BS_PUSHBUTTON);
+    CHECK(editor::WindowState(button) == nullptr);
+
+    CHECK(editor::UnloadDll());
+    UnmapViewOfFile(g_record);
+    CloseHandle(g_mapping);
+    standin::UnregisterModule(g_previous);
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,123 @@
+// Theme snapshots: a new one is published when the ini changes, and the one
+// it replaces stays alive for a while, the brushes the WM_CTLCOLOR* handlers
+// returned from it are still used by the controls. Windows are re-themed
+// with it, frame colors it no longer sets included.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+std::string g_ini;
+HWND g_dialog;
+HDC g_hdc;
+HBRUSH g_loaded;
+
+HBRUSH CtlColorBrush() {
+    return (HBRUSH)SendMessage(g_dialog, WM_CTLCOLOREDIT, (WPARAM)g_hdc, 0);
+}
+
+// rewrites the ini and waits for the watcher to publish it
+bool ChangeTheme(std::string_view text) {
+    const theme_cfg* before = g_theme.load();
+    standin::WriteTextFile(g_ini, text);
+    return standin::PumpUntil([before] { return g_theme.load() != before; }, 5000);
+}
+
+}
+
+TEST(load) {
+    standin::SetOsBuild(22000);
+    g_ini = editor::LoadDll("menubar_bgcolor = 48,48,48\ncaption_color = 32,32,32\n") + "/UnityEditorDarkMode.dll.ini";
+    g_dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    standin::ShowWindow(g_dialog);
+    g_hdc = GetWindowDC(g_dialog);
+    CHECK(editor::WindowState(g_dialog) != nullptr);
+    g_loaded = CtlColorBrush();
+    CHECK(g_loaded != nullptr);
+
+    DWORD color = 0;
+    CHECK(standin::GetDwmAttribute(g_dialog, DWMWA_CAPTION_COLOR, color) && color == RGB(32, 32, 32));
+    CHECK(standin::GetDwmAttribute(g_dialog, DWMWA_TEXT_COLOR, color) && color == DWMWA_COLOR_DEFAULT);
+
+    // the watcher has taken note of the ini once it waits for changes
+    CHECK(standin::PumpUntil([] { return standin::ApiCalls("WaitForMultipleObjects") != 0; }, 5000));
+}
+
+TEST(replaced_brushes_outlive_the_handler) {
+    CHECK(ChangeTheme("menubar_bgcolor = 30,30,30\n"));
+    CHECK(CtlColorBrush() != g_loaded);
+
+    // the edit control may still paint with the brush it was given
+    CHECK(standin::IsLiveGdiObject(g_loaded));
+}
+
+TEST(unset_frame_colors_go_back_to_the_system_ones) {
+    // the change above dropped caption_color, the re-theme job resets it
+    DWORD color = 0;
+    CHECK(standin::PumpUntil([&color] {
+        return standin::GetDwmAttribute(g_dialog, DWMWA_CAPTION_COLOR, color) && color == DWMWA_COLOR_DEFAULT;
+    }, 5000));
+    CHECK(standin::GetDwmAttribute(g_dialog, DWMWA_BORDER_COLOR, color) && color == DWMWA_COLOR_DEFAULT);
+}
+
+TEST(replaced_brushes_go_after_the_grace_period) {
+    HBRUSH replaced = CtlColorBrush();
+    standin::AdvanceTicks(THEME_RETIRE_MS);
+    CHECK(ChangeTheme("menubar_bgcolor = 20,20,20\n"));
+
+    // the first snapshot is due, the one just replaced is not
+    CHECK(!standin::IsLiveGdiObject(g_loaded));
+    CHECK(standin::IsLiveGdiObject(replaced));
+    CHECK(g_retiredThemes.size() == 1);
+}
+
+TEST(unload_frees_every_snapshot) {
+    ReleaseDC(g_dialog, g_hdc);
+    CHECK(editor::UnloadDll());
+    CHECK(g_retiredThemes.empty());
+    CHECK(g_theme.load() == nullptr);
+}
+
+TEST(a_stuck_reader_holds_releasing_back_only_so_long) {
+    PublishThemeConfig(BuildThemeConfig(CStringW()));
+    const HBRUSH retired = g_theme.load()->menubar_bgbrush;
+    PublishThemeConfig(BuildThemeConfig(CStringW()));
+    const HBRUSH current = g_theme.load()->menubar_bgbrush;
+
+    // a thread killed while handling a message never gives its snapshot back
+    g_themeReaders++;
+    const ULONGLONG start = GetTickCount64();
+    ReleaseThemeConfig(false);
+    CHECK(GetTickCount64() - start < THEME_READERS_TIMEOUT_MS + 1000);
+    g_themeReaders--;
+
+    // leaked, not freed under it
+    CHECK(g_theme.load() == nullptr);
+    CHECK(g_retiredThemes.empty());
+    CHECK(standin::IsLiveGdiObject(retired));
+    CHECK(standin::IsLiveGdiObject(current));
+}
+
+TEST(nothing_is_freed_at_process_exit) {
+    PublishThemeConfig(BuildThemeConfig(CStringW()));
+    const HBRUSH retired = g_theme.load()->menubar_bgbrush;
+    PublishThemeConfig(BuildThemeConfig(CStringW()));
+    const HBRUSH current = g_theme.load()->menubar_bgbrush;
+
+    // the other threads were killed wherever they were, readers included
+    g_themeReaders++;
+    const ULONGLONG start = GetTickCount64();
+    ReleaseThemeConfig(true);
+    CHECK(GetTickCount64() - start < THEME_READERS_TIMEOUT_MS);
+    g_themeReaders--;
+
+    CHECK(g_theme.load() == nullptr);
+    CHECK(standin::IsLiveGdiObject(retired));
+    CHECK(standin::IsLiveGdiObject(current));
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
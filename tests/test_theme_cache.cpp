@@ -0,0 +1,143 @@
+// The binary theme cache next to the ini: only a cache written by this build
+// for the ini as it is now is used, anything else (another version or
+// layout, a damaged or truncated file, an ini changed since) is parsed again
+// and the cache rewritten.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "standin.h"
+
+#include <memory>
+
+namespace {
+
+std::string g_ini;
+CStringW g_inifn;
+CStringW g_cachefn;
+
+WIN32_FILE_ATTRIBUTE_DATA Source() {
+    WIN32_FILE_ATTRIBUTE_DATA source = {};
+    GetFileAttributesExW(g_inifn.GetString(), GetFileExInfoStandard, &source);
+    return source;
+}
+
+theme_cache MakeCache(COLORREF background) {
+    auto cfg = std::make_unique<theme_cfg>();
+    SetDefaultThemeConfig(*cfg);
+    cfg->menubar_bgcolor = background;
+    return MakeThemeCache(*cfg, Source());
+}
+
+std::string CacheFilePath() {
+    const size_t name = g_ini.find_last_of('/') + 1;
+    return g_ini.substr(0, name) + "." + g_ini.substr(name) + ".cache";
+}
+
+// the theme as the first editor of the session builds it, with nothing
+// published by another one: from the cache file or the ini
+COLORREF BuiltBackground() {
+    theme_cfg* cfg = BuildThemeConfig(g_inifn);
+    const COLORREF background = cfg->menubar_bgcolor;
+    FreeThemeConfig(cfg);
+    if (shared_theme* shared = g_sharedTheme.load()) shared->seq = 0;
+    return background;
+}
+
+}
+
+TEST(setup) {
+    g_ini = standin::MakeTempDir() + "/UnityEditorDarkMode.dll.ini";
+    standin::WriteTextFile(g_ini, "menubar_bgcolor = 10,20,30\n");
+    g_inifn = standin::WindowsPath(g_ini).c_str();
+    g_cachefn = GetThemeCachePath(g_inifn);
+    CHECK(standin::WindowsPath(CacheFilePath()) == g_cachefn.GetString());
+}
+
+TEST(a_cache_reads_back_as_written) {
+    const theme_cache written = MakeCache(RGB(1, 2, 3));
+    CHECK(IsThemeCacheIntact(written));
+    CHECK(IsThemeCacheValid(written, Source()));
+
+    WriteThemeCache(g_cachefn, written);
+    theme_cache read;
+    CHECK(ReadThemeCache(g_cachefn, read));
+    CHECK(memcmp(&read, &written, sizeof(read)) == 0);
+
+    // no temporary file is left behind
+    WCHAR tmpfn[MAX_PATH + 32];
+    swprintf_s(tmpfn, L"%s.%lu.tmp", g_cachefn.GetString(), GetCurrentProcessId());
+    WIN32_FILE_ATTRIBUTE_DATA tmp;
+    CHECK(!GetFileAttributesExW(tmpfn, GetFileExInfoStandard, &tmp));
+}
+
+TEST(another_version_or_layout_is_rejected) {
+    theme_cache cache = MakeCache(RGB(1, 2, 3));
+    cache.version = THEME_CACHE_VERSION - 1;
+    cache.checksum = ThemeCacheChecksum(cache);
+    CHECK(!IsThemeCacheIntact(cache));
+
+    cache = MakeCache(RGB(1, 2, 3));
+    cache.size = sizeof(theme_cache) - sizeof(DWORD);
+    cache.checksum = ThemeCacheChecksum(cache);
+    CHECK(!IsThemeCacheIntact(cache));
+
+    cache = MakeCache(RGB(1, 2, 3));
+    cache.magic = 0;
+    CHECK(!IsThemeCacheIntact(cache));
+}
+
+TEST(a_damaged_cache_is_rejected) {
+    theme_cache cache = MakeCache(RGB(1, 2, 3));
+    cache.colors[0] ^= 1;
+    CHECK(!IsThemeCacheIntact(cache));
+
+    cache = MakeCache(RGB(1, 2, 3));
+    cache.checksum ^= 1;
+    CHECK(!IsThemeCacheIntact(cache));
+}
+
+TEST(a_cache_of_another_ini_is_stale) {
+    const theme_cache cache = MakeCache(RGB(1, 2, 3));
+
+    WIN32_FILE_ATTRIBUTE_DATA source = Source();
+    source.nFileSizeLow++;
+    CHECK(IsThemeCacheIntact(cache));
+    CHECK(!IsThemeCacheValid(cache, source));
+
+    source = Source();
+    source.ftLastWriteTime.dwLowDateTime++;
+    CHECK(!IsThemeCacheValid(cache, source));
+}
+
+TEST(a_truncated_file_isnt_read) {
+    const theme_cache cache = MakeCache(RGB(1, 2, 3));
+    standin::WriteTextFile(CacheFilePath(), std::string_view((const char*)&cache, sizeof(cache) - 1));
+
+    theme_cache read;
+    CHECK(!ReadThemeCache(g_cachefn, read));
+    CHECK(!ReadThemeCache(CStringW(L"C:\\missing\\.UnityEditorDarkMode.dll.ini.cache"), read));
+}
+
+TEST(a_valid_cache_is_used_instead_of_the_ini) {
+    WriteThemeCache(g_cachefn, MakeCache(RGB(1, 2, 3)));
+    CHECK(BuiltBackground() == RGB(1, 2, 3));
+}
+
+TEST(anything_else_is_parsed_again_and_rewritten) {
+    // truncated
+    const theme_cache cache = MakeCache(RGB(1, 2, 3));
+    standin::WriteTextFile(CacheFilePath(), std::string_view((const char*)&cache, sizeof(cache) / 2));
+    CHECK(BuiltBackground() == RGB(10, 20, 30));
+    theme_cache read;
+    CHECK(ReadThemeCache(g_cachefn, read) && IsThemeCacheValid(read, Source()));
+
+    // stale: the ini changed since
+    standin::WriteTextFile(g_ini, "menubar_bgcolor = 40,50,60\n");
+    CHECK(!IsThemeCacheValid(read, Source()));
+    CHECK(BuiltBackground() == RGB(40, 50, 60));
+    CHECK(ReadThemeCache(g_cachefn, read) && IsThemeCacheValid(read, Source()));
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,191 @@
+// The ini parser: colors, references between keys, rules and budgets, and
+// the line and column every malformed line is reported with. Keys that fail
+// to parse keep their previous value.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+
+#include <memory>
+
+namespace {
+
+// the ini applied on top of the defaults, as BuildThemeConfig does
+struct parsed {
+    std::unique_ptr<theme_cfg> cfg;
+    theme_parse_result result;
+};
+
+parsed Parse(std::string_view text) {
+    parsed p = { std::make_unique<theme_cfg>() };
+    SetDefaultThemeConfig(*p.cfg);
+    p.result = ParseThemeConfig(text, *p.cfg);
+    return p;
+}
+
+bool HasError(const theme_parse_result& result, int line, int column, std::string_view message) {
+    for (int i = 0; i < std::min(result.errorCount, (int)ARRAYSIZE(result.errors)); i++) {
+        const theme_parse_error& e = result.errors[i];
+        if (e.line == line && e.column == column && message == e.message) return true;
+    }
+    return false;
+}
+
+// actions for a class and button type, -1 when the class has no row
+int RuleActions(const std::unique_ptr<theme_cfg>& cfg, const wchar_t* className, int type = BS_PUSHBUTTON) {
+    for (int i = 0; i < cfg->rules.classCount; i++) {
+        if (wcscmp(cfg->rules.classes[i], className) == 0) return cfg->rules.actions[i][type];
+    }
+    return -1;
+}
+
+}
+
+TEST(empty_file_keeps_the_defaults) {
+    const auto [cfg, result] = Parse("");
+    CHECK(result.errorCount == 0);
+    CHECK(cfg->menubar_bgcolor == RGB(48, 48, 48));
+    CHECK(cfg->caption_color == CLR_INVALID);
+    CHECK(cfg->watchdog.gdi_budget == 8000);
+    CHECK(RuleActions(cfg, L"#32770") == (RULE_SUBCLASS | RULE_DARKMODE));
+}
+
+TEST(colors) {
+    const auto [cfg, result] = Parse(
+        "\xEF\xBB\xBF; comment\r\n"
+        "# another\r\n"
+        "menubar_textcolor = 1,2,3\r\n"
+        "  menubar_bgcolor\t=\t10 , 20 ,30  \n"
+        "menubaritem_bgcolor = #0a141e\n"
+        "caption_color = 255,255,255");
+    CHECK(result.errorCount == 0);
+    CHECK(cfg->menubar_textcolor == RGB(1, 2, 3));
+    CHECK(cfg->menubar_bgcolor == RGB(10, 20, 30));
+    CHECK(cfg->menubaritem_bgcolor == RGB(10, 20, 30));
+    CHECK(cfg->caption_color == RGB(255, 255, 255));
+}
+
+TEST(references_resolve_after_the_whole_file) {
+    const auto [cfg, result] = Parse(
+        "menubaritem_bgcolor_hot = menubaritem_bgcolor\n"
+        "menubaritem_bgcolor = menubar_bgcolor\n"
+        "menubar_bgcolor = 1,1,1\n"
+        "border_color = menubar_bgcolor\n"
+        "border_color = 2,2,2\n");
+    CHECK(result.errorCount == 0);
+    CHECK(cfg->menubaritem_bgcolor_hot == RGB(1, 1, 1));
+    CHECK(cfg->menubaritem_bgcolor == RGB(1, 1, 1));
+
+    // a later color replaces an earlier reference
+    CHECK(cfg->border_color == RGB(2, 2, 2));
+}
+
+TEST(circular_references_are_errors) {
+    const auto [cfg, result] = Parse(
+        "menubar_bgcolor = menubaritem_bgcolor\n"
+        "menubaritem_bgcolor = menubar_bgcolor\n");
+    CHECK(result.errorCount == 2);
+    CHECK(HasError(result, 1, 19, "circular color reference"));
+    CHECK(HasError(result, 2, 23, "circular color reference"));
+    CHECK(cfg->menubar_bgcolor == RGB(48, 48, 48));
+}
+
+TEST(errors_have_line_and_column) {
+    const auto [cfg, result] = Parse(
+        "menubar_bgcolor = 1,2\n"           // 1
+        "menubar_bgcolor = 1,2,256\n"       // 2
+        "menubar_bgcolor = #12345\n"        // 3
+        "menubar_bgcolor = 1,2,3x\n"        // 4
+        "menubar_colour = 1,2,3\n"          // 5
+        "  menubar_bgcolor =\n"             // 6
+        "menubar_bgcolor\n"                 // 7
+        "menubar_bgcolor = nothing\n");     // 8
+    CHECK(result.errorCount == 8);
+    CHECK(HasError(result, 1, 22, "expected ','"));
+    CHECK(HasError(result, 2, 23, "color component out of range 0-255"));
+    CHECK(HasError(result, 3, 25, "expected #rrggbb"));
+    CHECK(HasError(result, 4, 24, "unexpected characters after color"));
+    CHECK(HasError(result, 5, 1, "unknown key"));
+    CHECK(HasError(result, 6, 20, "missing value"));
+    CHECK(HasError(result, 7, 1, "expected 'key = value'"));
+    CHECK(HasError(result, 8, 19, "unknown color name"));
+
+    // nothing that failed to parse changed the color
+    CHECK(cfg->menubar_bgcolor == RGB(48, 48, 48));
+}
+
+TEST(only_the_first_errors_are_kept) {
+    std::string text;
+    for (int i = 0; i < 20; i++) text += "nonsense\n";
+    const auto [cfg, result] = Parse(text);
+    CHECK(result.errorCount == 20);
+    CHECK(HasError(result, 8, 1, "expected 'key = value'"));
+}
+
+TEST(rules) {
+    const auto [cfg, result] = Parse(
+        "[ rules ]\n"
+        "MyToolWindowClass = subclass, darkmode\n"
+        "button:pushbutton = subclass , darkmode\n"
+        "\"#32770\" = none\n"
+        "\"Odd:Name\":groupbox = wstr\n");
+    CHECK(result.errorCount == 0);
+    CHECK(RuleActions(cfg, L"MyToolWindowClass") == (RULE_SUBCLASS | RULE_DARKMODE));
+    CHECK(RuleActions(cfg, L"MyToolWindowClass", BS_GROUPBOX) == (RULE_SUBCLASS | RULE_DARKMODE));
+
+    // class names are matched without case, the built-in row is replaced
+    CHECK(RuleActions(cfg, L"Button") == (RULE_SUBCLASS | RULE_DARKMODE));
+    CHECK(RuleActions(cfg, L"Button", BS_CHECKBOX) == (RULE_SUBCLASS | RULE_DARKMODE | RULE_WSTR | RULE_LAZY));
+    CHECK(RuleActions(cfg, L"#32770") == 0);
+    CHECK(RuleActions(cfg, L"Odd:Name", BS_GROUPBOX) == RULE_WSTR);
+    CHECK(RuleActions(cfg, L"Odd:Name") == 0);
+}
+
+TEST(rule_errors) {
+    std::string text = "[rules]\n"
+        "Button:bigbutton = subclass\n"     // 2
+        "Button = subclass, dark\n"         // 3
+        "\"#32770 = subclass\n"             // 4
+        " = subclass\n"                     // 5
+        "Button =\n";                       // 6
+    text += std::string(RULE_CLASS_NAME_LENGTH, 'x') + " = subclass\n"; // 7
+    const auto [cfg, result] = Parse(text);
+    CHECK(result.errorCount == 6);
+    CHECK(HasError(result, 2, 8, "unknown button type"));
+    CHECK(HasError(result, 3, 20, "unknown action"));
+    CHECK(HasError(result, 4, 1, "expected '\"'"));
+    CHECK(HasError(result, 5, 2, "missing class name"));
+    CHECK(HasError(result, 6, 9, "missing value"));
+    CHECK(HasError(result, 7, 1, "class name too long"));
+    CHECK(RuleActions(cfg, L"Button", BS_CHECKBOX) == (RULE_SUBCLASS | RULE_DARKMODE | RULE_WSTR | RULE_LAZY));
+}
+
+TEST(rule_table_is_bounded) {
+    std::string text = "[rules]\n";
+    for (int i = 0; i < MAX_RULE_CLASSES; i++) text += "Class" + std::to_string(i) + " = subclass\n";
+    const auto [cfg, result] = Parse(text);
+    CHECK(cfg->rules.classCount == MAX_RULE_CLASSES);
+    CHECK(result.errorCount > 0);
+    CHECK(result.errors[0].message == std::string_view("too many rule classes"));
+}
+
+TEST(watchdog_and_other_sections) {
+    const auto [cfg, result] = Parse(
+        "[watchdog]\n"
+        "gdi_budget = 5000\n"
+        "user_budget = lots\n"
+        "[colors of another tool]\n"
+        "anything = goes\n"
+        "[]\n"
+        "menubar_bgcolor = 1,1,1\n"
+        "[rules\n");
+    CHECK(result.errorCount == 2);
+    CHECK(HasError(result, 3, 15, "expected a number"));
+    CHECK(HasError(result, 8, 7, "expected ']'"));
+    CHECK(cfg->watchdog.gdi_budget == 5000);
+    CHECK(cfg->watchdog.user_budget == 8000);
+    CHECK(cfg->menubar_bgcolor == RGB(1, 1, 1));
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,256 @@
+// The UI thread registry: only threads with a top-level window get a slot,
+// hooks, our WM_NULLs and a stats block, one for every slot; slots and stats
+// blocks come back when threads exit, and threads that come and go while
+// others hook them leave nothing behind.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+int UsedUiThreadSlots() {
+    return (int)std::count_if(std::begin(g_uiThreads), std::end(g_uiThreads),
+        [](const ui_thread& thread) { return thread.threadId.load() != 0; });
+}
+
+int UsedStatsBlocks() {
+    return (int)std::count_if(std::begin(g_threadStatsOwners), std::end(g_threadStatsOwners),
+        [](const std::atomic<DWORD>& owner) { return owner.load() != 0; });
+}
+
+bool IsCandidate(DWORD threadId) {
+    return std::any_of(std::begin(g_threadCandidates), std::end(g_threadCandidates),
+        [threadId](const std::atomic<DWORD>& candidate) { return candidate.load() == threadId; });
+}
+
+ULONGLONG CbtCalls() {
+    dm_stats stats = { sizeof(stats) };
+    UnityEditorDarkMode_GetStats(&stats);
+    ULONGLONG calls = 0;
+    for (const msg_stats& slot : stats.cbt) calls += slot.count;
+    return calls;
+}
+
+// a thread that does what the test asks of it, on itself, until told to exit
+class worker {
+public:
+    worker() : requests(std::make_shared<std::atomic<int>>(START)), t([r = requests] { Run(*r); }) {
+        while (requests->load() != IDLE) Sleep(0);
+    }
+    ~worker() { Exit(); }
+
+    DWORD id() const { return t.id(); }
+    void CreateWindow() { Ask(CREATE_WINDOW); }
+    void Pump() { Ask(PUMP); }
+    void Exit() {
+        requests->store(EXIT);
+        t.join();
+    }
+
+private:
+    enum { IDLE, START, CREATE_WINDOW, PUMP, EXIT };
+
+    static void Run(std::atomic<int>& request) {
+        for (;;) {
+            switch (request.load()) {
+                case CREATE_WINDOW:
+                    standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+                    break;
+                case START:
+                    break;
+                case PUMP:
+                    standin::PumpMessages();
+                    break;
+                case EXIT:
+                    return;
+                default:
+                    Sleep(0);
+                    continue;
+            }
+            request.store(IDLE);
+        }
+    }
+
+    void Ask(int what) {
+        requests->store(what);
+        while (requests->load() != IDLE) Sleep(0);
+    }
+
+    std::shared_ptr<std::atomic<int>> requests;
+    standin::thread t;
+};
+
+}
+
+TEST(load) {
+    editor::LoadDll();
+    CHECK(UsedUiThreadSlots() == 1);
+}
+
+TEST(threads_without_windows_are_left_alone) {
+    worker w;
+    CHECK(IsCandidate(w.id()));
+
+    ScanThreadCandidates();
+    CHECK(FindUiThread(w.id()) == nullptr);
+    CHECK(standin::HookCount(w.id(), WH_CBT) == 0);
+    CHECK(standin::HookCount(w.id(), WH_GETMESSAGE) == 0);
+    CHECK(standin::QueuedMessages(w.id()) == 0);
+
+    w.Exit();
+    CHECK(!IsCandidate(w.id()));
+}
+
+TEST(threads_that_open_a_window_are_hooked) {
+    worker w;
+    w.CreateWindow();
+    ScanThreadCandidates();
+
+    ui_thread* thread = FindUiThread(w.id());
+    CHECK(thread != nullptr);
+    CHECK(!IsCandidate(w.id()));
+    CHECK(standin::HookCount(w.id(), WH_CBT) == 1);
+    CHECK(standin::HookCount(w.id(), WH_GETMESSAGE) == 1);
+
+    // its windows are picked up from INIT_MESSAGE_TAG, new ones through
+    // CBTProc, whose time goes into a stats block of the thread's own
+    w.Pump();
+    CHECK(thread && thread->initialized);
+    const int blocks = UsedStatsBlocks();
+    w.CreateWindow();
+    CHECK(UsedStatsBlocks() == blocks + 1);
+    CHECK(thread && g_threadStatsOwners[thread - g_uiThreads].load() == w.id());
+    const ULONGLONG cbtCalls = CbtCalls();
+    CHECK(cbtCalls != 0);
+
+    w.Exit();
+    CHECK(FindUiThread(w.id()) == nullptr);
+    CHECK(UsedUiThreadSlots() == 1);
+    CHECK(UsedStatsBlocks() == blocks);
+    CHECK(CbtCalls() == cbtCalls);
+}
+
+TEST(threads_without_a_slot_record_nothing) {
+    const int blocks = UsedStatsBlocks();
+    const ULONGLONG built = [] {
+        dm_stats stats = { sizeof(stats) };
+        UnityEditorDarkMode_GetStats(&stats);
+        return stats.counters[(int)StatCounter::DpiResourceSetsBuilt];
+    }();
+
+    thread_stats* stats = nullptr;
+    standin::thread t([&stats] {
+        stats = GetThreadStats();
+        CountStat(StatCounter::DpiResourceSetsBuilt);
+    });
+    t.join();
+    CHECK(stats == nullptr);
+    CHECK(UsedStatsBlocks() == blocks);
+
+    dm_stats after = { sizeof(after) };
+    UnityEditorDarkMode_GetStats(&after);
+    CHECK(after.counters[(int)StatCounter::DpiResourceSetsBuilt] == built);
+}
+
+TEST(every_slot_has_a_stats_block) {
+    const int blocks = UsedStatsBlocks();
+    std::vector<std::unique_ptr<worker>> workers;
+    while (UsedUiThreadSlots() < MAX_UI_THREADS) {
+        workers.push_back(std::make_unique<worker>());
+        workers.back()->CreateWindow();
+        ScanThreadCandidates();
+        workers.back()->Pump();
+        workers.back()->CreateWindow();
+    }
+
+    // the threads' CBTProc calls went into the blocks of their slots
+    for (const auto& w : workers) {
+        const ui_thread* thread = FindUiThread(w->id());
+        CHECK(thread != nullptr);
+        CHECK(thread && g_threadStatsOwners[thread - g_uiThreads].load() == w->id());
+    }
+    CHECK(UsedStatsBlocks() == blocks + (int)workers.size());
+
+    workers.clear();
+    CHECK(UsedUiThreadSlots() == 1);
+    CHECK(UsedStatsBlocks() == blocks);
+}
+
+TEST(hooking_a_thread_that_exited_leaves_no_slot) {
+    DWORD threadId;
+    {
+        worker w;
+        threadId = w.id();
+    }
+    CHECK(HookUiThread(threadId) == nullptr);
+    CHECK(UsedUiThreadSlots() == 1);
+}
+
+TEST(threads_coming_and_going_while_others_hook_them) {
+    const int blocks = UsedStatsBlocks();
+    const ULONGLONG unhooks = standin::ApiCalls("UnhookWindowsHookEx");
+    std::atomic<bool> done = false;
+    std::vector<DWORD> ids;
+    std::mutex idsLock;
+
+    // hooks whatever thread it hears of, over and over; the pause lets the
+    // threads it keeps the registry from get a turn on a single core
+    standin::thread hooker([&] {
+        while (!done.load()) {
+            ScanThreadCandidates();
+            {
+                std::lock_guard lock(idsLock);
+                for (DWORD id : ids) HookUiThread(id);
+            }
+            Sleep(1);
+        }
+    });
+
+    for (int round = 0; round < 50; round++) {
+        std::vector<std::unique_ptr<standin::thread>> threads;
+        for (int i = 0; i < 8; i++) {
+            threads.push_back(std::make_unique<standin::thread>([i] {
+                if (i % 4 == 3) return;
+                standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+                if (i % 2) standin::PumpMessages();
+                standin::CreateWindow(L"Button", nullptr, WS_OVERLAPPEDWINDOW);
+                standin::PumpMessages();
+            }));
+            std::lock_guard lock(idsLock);
+            ids.push_back(threads.back()->id());
+        }
+        threads.clear();
+    }
+    done.store(true);
+    hooker.join();
+
+    // what the hooker got to just before the threads exited is reclaimed here
+    ScanThreadCandidates();
+    CHECK(UsedUiThreadSlots() == 1);
+    CHECK(FindUiThread(GetCurrentThreadId()) != nullptr);
+    // some were hooked in time and gave their slots back themselves
+    CHECK(standin::ApiCalls("UnhookWindowsHookEx") > unhooks);
+    CHECK(std::none_of(std::begin(g_threadCandidates), std::end(g_threadCandidates),
+        [&](const std::atomic<DWORD>& candidate) {
+            return std::find(ids.begin(), ids.end(), candidate.load()) != ids.end();
+        }));
+    CHECK(UsedStatsBlocks() == blocks);
+    for (ui_thread& thread : g_uiThreads) {
+        if (thread.threadId.load()) continue;
+        CHECK(thread.cbtHook == nullptr);
+        CHECK(thread.msgHook == nullptr);
+        CHECK(thread.windows.empty());
+    }
+}
+
+TEST(unload) {
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,131 @@
+// UnityEditorDarkMode_Unload: refused from within our own window procedure
+// or while the theme watcher won't stop, not done before every UI thread has
+// left our hooks, and the windows and the process get their system look
+// back.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+HWND g_main;
+HWND g_other;       // on the thread below
+std::atomic<bool> g_otherHooked = false;
+std::atomic<bool> g_inModalLoop = false;
+std::atomic<bool> g_endModalLoop = false;
+std::atomic<bool> g_exit = false;
+
+// a second UI thread that sits in a modal loop under one of our windows'
+// messages, the way a move or size loop does
+void OtherUiThread() {
+    g_other = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    standin::SetWindowProc(g_other, [](HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+        if (uMsg == WM_ENTERSIZEMOVE) {
+            g_inModalLoop = true;
+            while (!g_endModalLoop) {
+                standin::PumpMessages();
+                Sleep(1);
+            }
+        }
+        return standin::DefaultWindowProc(hWnd, uMsg, wParam, lParam);
+    });
+    while (!g_otherHooked) Sleep(1);
+    standin::PumpMessages();
+    SendMessage(g_other, WM_ENTERSIZEMOVE, 0, 0);
+    while (!g_exit) {
+        standin::PumpMessages();
+        Sleep(1);
+    }
+}
+
+bool DwmAttribute(HWND hWnd, DWORD attribute, DWORD expected) {
+    DWORD value = 0;
+    return standin::GetDwmAttribute(hWnd, attribute, value) && value == expected;
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll("caption_color = 16,32,48\n");
+    g_main = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    standin::ShowWindow(g_main);
+    CHECK(editor::WindowState(g_main) != nullptr);
+    CHECK(DwmAttribute(g_main, DWMWA_USE_IMMERSIVE_DARK_MODE, TRUE));
+    CHECK(DwmAttribute(g_main, DWMWA_CAPTION_COLOR, RGB(0x10, 0x20, 0x30)));
+    CHECK(standin::AppMode() == (int)PreferredAppMode::ForceDark);
+}
+
+TEST(a_theme_watcher_that_doesnt_stop_holds_the_unload_off) {
+    CHECK(StopThemeWatcher());
+
+    // one stuck parsing the ini, say
+    std::atomic<bool> stuck = true;
+    g_themeWatcher = CreateThread(nullptr, 0, [](LPVOID lpParam) -> DWORD {
+        while (((std::atomic<bool>*)lpParam)->load()) Sleep(1);
+        return 0;
+    }, &stuck, 0, nullptr);
+
+    dm_handoff state = { sizeof(dm_handoff), HANDOFF_VERSION };
+    CHECK(!UnityEditorDarkMode_Handoff(&state));
+    CHECK(!editor::UnloadDll());
+    CHECK(!g_detaching);
+    CHECK(!g_handedOff);
+    CHECK(g_themeWatcher != nullptr);
+    CHECK(WaitForSingleObject(g_themeWatcherStop, 0) == WAIT_TIMEOUT);
+    CHECK(editor::WindowState(g_main) != nullptr);
+
+    stuck = false;
+    CHECK(StopThemeWatcher());
+    CHECK(g_themeWatcher == nullptr);
+}
+
+TEST(unloading_from_within_our_window_procedure_is_refused) {
+    BOOL unloaded = TRUE;
+    standin::SetWindowProc(g_main, [&unloaded](HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+        // e.g. a menu item's script
+        if (uMsg == WM_COMMAND) unloaded = UnityEditorDarkMode_Unload();
+        return standin::DefaultWindowProc(hWnd, uMsg, wParam, lParam);
+    });
+    SendMessage(g_main, WM_COMMAND, 0, 0);
+    standin::SetWindowProc(g_main, standin::DefaultWindowProc);
+
+    CHECK(!unloaded);
+    CHECK(!g_detaching);
+    CHECK(editor::WindowState(g_main) != nullptr);
+}
+
+TEST(a_thread_in_a_modal_loop_holds_the_unload_off) {
+    standin::thread other(OtherUiThread);
+    while (!g_other) Sleep(1);
+    CHECK(HookIfUiThread(other.id()));
+    g_otherHooked = true;
+    while (!g_inModalLoop) Sleep(1);
+
+    // its UNLOAD_MESSAGE_TAG arrives under our window procedure
+    CHECK(!editor::UnloadDll());
+    CHECK(FindUiThread(other.id()) != nullptr);
+    CHECK(standin::SubclassCount(g_other) == 1);
+
+    // once out of the loop it can leave with the next try
+    g_endModalLoop = true;
+    CHECK(editor::UnloadDll());
+    CHECK(standin::SubclassCount(g_other) == 0);
+    CHECK(g_unloadingThreads == 0);
+
+    g_exit = true;
+    other.join();
+}
+
+TEST(windows_and_process_get_their_system_look_back) {
+    CHECK(editor::WindowState(g_main) == nullptr);
+    CHECK(DwmAttribute(g_main, DWMWA_USE_IMMERSIVE_DARK_MODE, FALSE));
+    CHECK(DwmAttribute(g_main, DWMWA_CAPTION_COLOR, DWMWA_COLOR_DEFAULT));
+    CHECK(DwmAttribute(g_main, DWMWA_TEXT_COLOR, DWMWA_COLOR_DEFAULT));
+    CHECK(DwmAttribute(g_main, DWMWA_BORDER_COLOR, DWMWA_COLOR_DEFAULT));
+    CHECK(standin::AppMode() == (int)PreferredAppMode::Default);
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
@@ -0,0 +1,169 @@
+// The GDI/USER object watchdog: once the process's objects cross a budget,
+// rendering falls back to plain fills, the off-screen caches are dropped and
+// buttons created meanwhile aren't made owner-drawn; it recovers only once
+// both counts are well below their budgets again. The rest of the editor's
+// objects are played by standin::SetGuiResourceBase.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+constexpr DWORD BUDGET = 1000;
+
+HWND g_unity;
+HMENU g_menu;
+HWND g_dialog;
+HWND g_button;
+HDC g_hdc;
+
+void DrawMenuBar() {
+    UAHMENU menu = { g_menu, g_hdc, 0x00000a00 };
+    SendMessage(g_unity, WM_UAHDRAWMENU, 0, (LPARAM)&menu);
+}
+
+void DrawButton(HWND button) {
+    HDC hdc = GetWindowDC(g_dialog);
+    DRAWITEMSTRUCT dis = {};
+    dis.CtlType = ODT_BUTTON;
+    dis.itemAction = ODA_DRAWENTIRE;
+    dis.hwndItem = button;
+    dis.hDC = hdc;
+    dis.rcItem = { 0, 0, 75, 23 };
+    SendMessage(g_dialog, WM_DRAWITEM, 0, (LPARAM)&dis);
+    ReleaseDC(g_dialog, hdc);
+}
+
+// the editor's own objects set so that the process has gdi in all
+void SetProcessGdiObjects(DWORD gdi) {
+    standin::SetGuiResourceBase(gdi - (DWORD)standin::LiveGdiObjects(), 10);
+}
+
+// the next message to one of our windows after the sampling interval
+void Sample() {
+    standin::AdvanceTicks(WATCHDOG_INTERVAL_MS);
+    SendMessage(g_dialog, WM_CTLCOLORDLG, (WPARAM)g_hdc, (LPARAM)g_dialog);
+}
+
+dm_watchdog Watchdog() {
+    dm_watchdog watchdog = { sizeof(watchdog) };
+    CHECK(UnityEditorDarkMode_GetWatchdog(&watchdog));
+    return watchdog;
+}
+
+bool IsOwnerDrawn(HWND button) {
+    return (GetWindowLongPtr(button, GWL_STYLE) & BS_TYPEMASK) == BS_OWNERDRAW;
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll("[watchdog]\ngdi_budget = 1000\nuser_budget = 1000\n");
+    g_unity = standin::CreateWindow(L"UnityContainerWndClass", nullptr, WS_OVERLAPPEDWINDOW, L"Unity");
+    g_menu = standin::CreateMenu({ L"&File", L"&Edit" });
+    standin::SetMenu(g_unity, g_menu);
+    standin::ShowWindow(g_unity);
+    g_hdc = GetWindowDC(g_unity);
+    g_dialog = standin::CreateWindow(L"#32770", nullptr, WS_OVERLAPPEDWINDOW);
+    g_button = standin::CreateWindow(L"Button", g_dialog, WS_CHILD | BS_PUSHBUTTON, L"OK");
+    standin::ShowWindow(g_dialog);
+    CHECK(IsOwnerDrawn(g_button));
+
+    DrawMenuBar();
+    DrawButton(g_button);
+    CHECK(editor::WindowState(g_unity)->menuBar.hdc != nullptr);
+    CHECK(editor::WindowState(g_button)->button.hdc != nullptr);
+}
+
+TEST(under_budget) {
+    SetProcessGdiObjects(BUDGET);
+    Sample();
+
+    const dm_watchdog watchdog = Watchdog();
+    CHECK(watchdog.version == WATCHDOG_VERSION);
+    CHECK(watchdog.gdiBudget == BUDGET);
+    CHECK(watchdog.userBudget == BUDGET);
+    CHECK(watchdog.gdiObjects == BUDGET);
+    CHECK(watchdog.samples >= 1);
+    CHECK(!watchdog.degraded);
+    CHECK(watchdog.degradations == 0);
+}
+
+TEST(samples_at_most_every_interval) {
+    const DWORD samples = Watchdog().samples;
+    SendMessage(g_dialog, WM_CTLCOLORDLG, (WPARAM)g_hdc, (LPARAM)g_dialog);
+    SendMessage(g_dialog, WM_CTLCOLORDLG, (WPARAM)g_hdc, (LPARAM)g_dialog);
+    CHECK(Watchdog().samples == samples);
+    Sample();
+    CHECK(Watchdog().samples == samples + 1);
+}
+
+TEST(crossing_the_budget_degrades_rendering) {
+    SetProcessGdiObjects(BUDGET + 1);
+    Sample();
+
+    dm_watchdog watchdog = Watchdog();
+    CHECK(watchdog.degraded);
+    CHECK(watchdog.degradations == 1);
+    CHECK(watchdog.gdiPeak == BUDGET + 1);
+
+    // the caches go with the first message on their thread
+    CHECK(editor::WindowState(g_unity)->menuBar.hdc == nullptr);
+    CHECK(editor::WindowState(g_button)->button.hdc == nullptr);
+
+    // and aren't built again meanwhile
+    const unsigned long long bitmaps = standin::ApiCalls("CreateCompatibleBitmap");
+    DrawMenuBar();
+    DrawButton(g_button);
+    CHECK(editor::WindowState(g_unity)->menuBar.hdc == nullptr);
+    CHECK(editor::WindowState(g_button)->button.hdc == nullptr);
+    CHECK(standin::ApiCalls("CreateCompatibleBitmap") == bitmaps);
+
+    // new buttons keep the system look, for good
+    HWND button = standin::CreateWindow(L"Button", g_dialog, WS_CHILD | BS_PUSHBUTTON, L"Cancel");
+    CHECK(editor::WindowState(button) != nullptr);
+    CHECK(!IsOwnerDrawn(button));
+    CHECK(IsOwnerDrawn(g_button));
+}
+
+TEST(just_under_the_budget_isnt_enough_to_recover) {
+    SetProcessGdiObjects(BUDGET * WATCHDOG_RECOVERY_PERCENT / 100 + 1);
+    Sample();
+    CHECK(Watchdog().degraded);
+}
+
+TEST(recovers_well_under_the_budget) {
+    SetProcessGdiObjects(BUDGET * WATCHDOG_RECOVERY_PERCENT / 100);
+    Sample();
+    const dm_watchdog watchdog = Watchdog();
+    CHECK(!watchdog.degraded);
+    CHECK(watchdog.degradations == 1);
+
+    DrawMenuBar();
+    DrawButton(g_button);
+    CHECK(editor::WindowState(g_unity)->menuBar.hdc != nullptr);
+    CHECK(editor::WindowState(g_button)->button.hdc != nullptr);
+
+    HWND button = standin::CreateWindow(L"Button", g_dialog, WS_CHILD | BS_PUSHBUTTON, L"Apply");
+    CHECK(IsOwnerDrawn(button));
+}
+
+TEST(the_user_budget_counts_as_well) {
+    standin::SetGuiResourceBase(0, BUDGET + 1);
+    Sample();
+    CHECK(Watchdog().degraded);
+    CHECK(Watchdog().degradations == 2);
+    standin::SetGuiResourceBase(0, 0);
+    Sample();
+    CHECK(!Watchdog().degraded);
+}
+
+TEST(unload) {
+    ReleaseDC(g_unity, g_hdc);
+    CHECK(editor::UnloadDll());
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}
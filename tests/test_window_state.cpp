@@ -0,0 +1,131 @@
+// Per-window state: the kind and dispatch table are decided once when a
+// window is subclassed, messages are dispatched without looking at the class
+// again, and the state goes away with the window or the dll.
+#include "../UnityEditorDarkMode.cpp"
+
+#include "check.h"
+#include "editor.h"
+
+namespace {
+
+std::vector<HWND> g_windows;
+
+HWND Create(const wchar_t* className, HWND parent, DWORD style) {
+    HWND hWnd = standin::CreateWindow(className, parent, style);
+    standin::ShowWindow(hWnd);
+    g_windows.push_back(hWnd);
+    return hWnd;
+}
+
+}
+
+TEST(load) {
+    editor::LoadDll();
+    CHECK(GetUiThread() != nullptr);
+    CHECK(standin::HookCount(GetCurrentThreadId(), WH_CBT) == 1);
+}
+
+TEST(kind_is_decided_at_subclass_time) {
+    const struct {
+        const wchar_t* className;
+        WndKind kind;
+        bool child;
+    } windows[] = {
+        { L"UnityContainerWndClass", WndKind::Unity, false },
+        { L"#32770", WndKind::Dialog, false },
+        { L"Button", WndKind::Button, true },
+        { L"tooltips_class32", WndKind::Tooltip, false },
+        { L"ComboBox", WndKind::ComboBox, true },
+        { L"SysListView32", WndKind::ListView, true },
+        { L"SysTreeView32", WndKind::TreeView, true },
+    };
+
+    HWND parent = Create(L"UnityContainerWndClass", nullptr, WS_OVERLAPPEDWINDOW);
+    for (const auto& w : windows) {
+        HWND hWnd = Create(w.className, w.child ? parent : nullptr, w.child ? WS_CHILD : WS_OVERLAPPEDWINDOW);
+        wnd_state* state = editor::WindowState(hWnd);
+        CHECK(state != nullptr);
+        if (!state) continue;
+        CHECK(state->kind == w.kind);
+        CHECK(state->hwnd == hWnd);
+        CHECK(state->thread == GetUiThread());
+        CHECK(!state->pending);
+        CHECK(state->dispatch == GetDispatchTable(w.kind));
+    }
+
+    // classes without a rule are left alone
+    CHECK(editor::WindowState(Create(L"Static", parent, WS_CHILD)) == nullptr);
+}
+
+TEST(lazy_windows_wait_for_their_first_show) {
+    HWND hWnd = standin::CreateWindow(L"SysListView32", nullptr, WS_POPUP);
+    wnd_state* state = editor::WindowState(hWnd);
+    CHECK(state && state->pending && state->dispatch == GetPendingDispatchTable());
+
+    standin::ShowWindow(hWnd);
+    CHECK(state && !state->pending && state->dispatch == GetDispatchTable(WndKind::ListView));
+    g_windows.push_back(hWnd);
+}
+
+TEST(dispatch_looks_up_no_class) {
+    standin::ResetApiCalls();
+    for (HWND hWnd : g_windows) {
+        for (UINT msg : { WM_PAINT, WM_NCPAINT, WM_MOUSEMOVE, WM_SETCURSOR, WM_STYLECHANGING, WM_CTLCOLORLISTBOX }) {
+            SendMessage(hWnd, msg, 0, 0);
+        }
+    }
+    CHECK(standin::ApiCalls("GetClassName") == 0);
+    CHECK(standin::ApiCalls("GetClassLongPtr") == 0);
+}
+
+TEST(class_names_are_looked_up_once_per_atom) {
+    HWND parent = g_windows[0];
+    Create(L"SysTreeView32", parent, WS_CHILD);
+    standin::ResetApiCalls();
+    for (int i = 0; i < 8; i++) Create(L"SysTreeView32", parent, WS_CHILD);
+    Create(L"Static", parent, WS_CHILD);
+    CHECK(standin::ApiCalls("GetClassName") == 0);
+}
+
+TEST(one_class_name_can_have_several_atoms) {
+    // Button of the other comctl32 version, and one registered by an
+    // activation context with its version prefix
+    const ATOM v5 = standin::RegisterClass(L"Button", (HINSTANCE)0x1000);
+    const ATOM sxs = standin::RegisterClass(L"6.0.22621.1!Button", (HINSTANCE)0x2000);
+    HWND parent = g_windows[0];
+    for (ATOM atom : { v5, sxs, v5 }) {
+        HWND hWnd = standin::CreateWindowOfClass(atom, parent, WS_CHILD | BS_CHECKBOX);
+        standin::ShowWindow(hWnd);
+        g_windows.push_back(hWnd);
+        wnd_state* state = editor::WindowState(hWnd);
+        CHECK(state && state->kind == WndKind::Button);
+        CHECK(state && (state->ruleActions & RULE_WSTR));
+    }
+}
+
+TEST(state_goes_with_the_window) {
+    ui_thread* thread = GetUiThread();
+    const size_t before = thread->windows.size();
+
+    HWND hWnd = g_windows[1];
+    standin::DestroyWindow(hWnd);
+    g_windows.erase(g_windows.begin() + 1);
+    CHECK(thread->windows.size() == before - 1);
+
+    // the registry stays consistent after the swap with the last entry
+    for (size_t i = 0; i < thread->windows.size(); i++) {
+        CHECK(thread->windows[i]->registryIndex == i);
+        CHECK(editor::WindowState(thread->windows[i]->hwnd) == thread->windows[i]);
+    }
+}
+
+TEST(unload_detaches_every_window) {
+    CHECK(editor::UnloadDll());
+    for (HWND hWnd : g_windows) CHECK(standin::SubclassCount(hWnd) == 0);
+    CHECK(standin::HookCount(GetCurrentThreadId(), WH_CBT) == 0);
+    CHECK(standin::HookCount(GetCurrentThreadId(), WH_GETMESSAGE) == 0);
+}
+
+int main(int argc, char** argv) {
+    return check::RunAll(argc, argv);
+}